@@ -0,0 +1,103 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 访存密集的任务：每个线程第一次执行时分配并写一遍自己的缓冲区(first touch，内存落在当时所在的节点上)，
+// 之后每个任务把整块缓冲区读一遍。对比不绑核/每线程一个核/每线程一个NUMA节点的吞吐
+namespace
+{
+const size_t BUFFER_WORDS = (16 << 20) / sizeof(uint64_t);// 16MB，比LLC大
+
+std::atomic<uint64_t> sink(0);
+
+uint64_t streamOnce()
+{
+    thread_local std::vector<uint64_t> buffer;
+    if(buffer.empty())
+    {
+        buffer.resize(BUFFER_WORDS);
+        for(size_t i=0;i<buffer.size();i++)
+        {
+            buffer[i] = i;
+        }
+    }
+    uint64_t sum = 0;
+    for(size_t i=0;i<buffer.size();i+=8)// 每个cache line读一次
+    {
+        sum += buffer[i];
+    }
+    return sum;
+}
+
+const char* modeName(AffinityMode mode)
+{
+    switch(mode)
+    {
+    case AffinityMode::AFFINITY_NONE: return "none";
+    case AffinityMode::AFFINITY_CPUSET: return "cpuset";
+    case AffinityMode::AFFINITY_CORE: return "core";
+    case AffinityMode::AFFINITY_NODE: return "node";
+    }
+    return "?";
+}
+
+void runOnce(AffinityMode mode, int threads, int tasks)
+{
+    double ms = 0;
+    {
+        ThreadPool pool;
+        pool.setAffinity(mode);
+        pool.start(threads);
+
+        // 先每个线程热身一次，把缓冲区分配好，不算进时间
+        std::vector<Future<uint64_t>> warm;
+        for(int i=0;i<threads * 4;i++)
+        {
+            warm.push_back(pool.submit(streamOnce));
+        }
+        for(auto& f : warm)
+        {
+            sink += f.get();
+        }
+
+        std::vector<Future<uint64_t>> results;
+        results.reserve(tasks);
+        auto begin = bench::Clock::now();
+        for(int i=0;i<tasks;i++)
+        {
+            results.push_back(pool.submit(streamOnce));
+        }
+        for(auto& f : results)
+        {
+            sink += f.get();
+        }
+        ms = bench::elapsedMs(begin);
+    }
+    double gb = (double)tasks * BUFFER_WORDS * sizeof(uint64_t) / 8 / (1 << 30);// 实际读到的cache line
+    std::printf("%-6s threads=%-3d %8.1f ms | %8.1f tasks/s | %6.2f GB/s (lines touched)\n",
+                modeName(mode), threads, ms, tasks * 1000.0 / ms, gb * 1000.0 / ms);
+}
+
+void affinity()
+{
+    Topology topo = Topology::detect();
+    int cpus = topo.cpus().size();
+    std::printf("numa nodes=%zu cpus=%d\n", topo.nodes().size(), cpus);
+    std::vector<int> sweep = {cpus};
+    if(cpus / 2 >= 1)
+        sweep.insert(sweep.begin(), cpus / 2);
+    for(int threads : sweep)
+    {
+        runOnce(AffinityMode::AFFINITY_NONE, threads, 400);
+        runOnce(AffinityMode::AFFINITY_CORE, threads, 400);
+        runOnce(AffinityMode::AFFINITY_NODE, threads, 400);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("affinity", affinity);
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 每个任务的堆分配次数：替换全局operator new计数，只在测量期间计数
+// post：可调用对象按值放进队列，小的放在任务内部缓冲区里；submit：多一个共享的结果对象；submitTask：继承Task+Result+Any
+namespace
+{
+std::atomic_bool counting(false);
+std::atomic<uint64_t> allocations(0);
+} // namespace
+
+// 替换的new/delete都不内联：内联以后GCC在调用方看到operator new配上std::free，会报-Wmismatched-new-delete
+[[gnu::noinline]] void* operator new(size_t size)
+{
+    if(counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+[[gnu::noinline]] void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+class CountTask : public Task
+{
+public:
+    CountTask(std::atomic_int& done)
+        : done_(done)
+    {}
+    Any run() override
+    {
+        done_++;
+        return 0;
+    }
+private:
+    std::atomic_int& done_;
+};
+
+template<typename Submit>
+void measure(const char* name, QueueMode mode, int tasks, Submit submit)
+{
+    std::atomic_int done(0);
+    double ms = 0;
+    uint64_t count = 0;
+    {
+        ThreadPool pool;
+        pool.setQueueMode(mode);
+        pool.setTaskQueMaxThreshHold(65536);
+        pool.start(4);
+        // 先跑一轮把队列的缓冲区撑到稳定大小
+        for(int i=0;i<tasks;i++)
+        {
+            submit(pool, done);
+        }
+        while(done < tasks)
+        {
+            std::this_thread::yield();
+        }
+        done = 0;
+
+        allocations = 0;
+        counting = true;
+        auto begin = bench::Clock::now();
+        for(int i=0;i<tasks;i++)
+        {
+            submit(pool, done);
+        }
+        while(done < tasks)
+        {
+            std::this_thread::yield();
+        }
+        ms = bench::elapsedMs(begin);
+        counting = false;
+        count = allocations;
+    }
+    std::printf("%-22s %-5s %6.2f allocs/task | %7.1f ns/task\n", name,
+                mode == QueueMode::MODE_RING ? "ring" : "mutex",
+                (double)count / tasks, ms * 1e6 / tasks);
+}
+
+void alloc()
+{
+    std::printf("task inline buffer=%zu bytes, queued task=%zu bytes\n", TASK_INLINE_SIZE, sizeof(TaskItem));
+    const int tasks = 100000;
+    for(QueueMode mode : {QueueMode::MODE_MUTEX, QueueMode::MODE_RING})
+    {
+        measure("post (small lambda)", mode, tasks, [](ThreadPool& pool, std::atomic_int& done)
+        {
+            pool.post([&done]() { done++; });
+        });
+        measure("post (128B capture)", mode, tasks, [](ThreadPool& pool, std::atomic_int& done)
+        {
+            char pad[128] = {};
+            pool.post([&done, pad]() { done += 1 + pad[0]; });
+        });
+        measure("submit (Future)", mode, tasks, [](ThreadPool& pool, std::atomic_int& done)
+        {
+            pool.submit([&done]() { done++; });
+        });
+        measure("submitTask (Task)", mode, tasks, [](ThreadPool& pool, std::atomic_int& done)
+        {
+            pool.submitTask(std::make_shared<CountTask>(done));
+        });
+    }
+}
+} // namespace
+
+BENCH_REGISTER("alloc", alloc);
@@ -0,0 +1,160 @@
+#ifndef THREADPOOL_BENCH_H
+#define THREADPOOL_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+// 基准测试的公共工具：计时 + 按名字注册，main里按命令行参数挑着跑
+namespace bench
+{
+using Clock = std::chrono::steady_clock;
+
+using BenchFunc = std::function<void()>;
+
+// 名字 => 基准函数
+inline std::map<std::string, BenchFunc>& registry()
+{
+    static std::map<std::string, BenchFunc> benches;
+    return benches;
+}
+
+struct Registrar
+{
+    Registrar(const char* name, BenchFunc func)
+    {
+        registry().emplace(name, std::move(func));
+    }
+};
+
+// 从begin到现在经过的毫秒数
+inline double elapsedMs(Clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+// 求百分位数(p取0~100)，会对samples排序
+inline double percentile(std::vector<double>& samples, double p)
+{
+    if(samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = (size_t)(p / 100 * (samples.size() - 1));
+    return samples[index];
+}
+
+// 结果输出格式，main里按 --csv / --json 设置；Row::emit按它输出
+enum class Format
+{
+    TEXT, // 给人看的 key=value
+    CSV, // 每组列第一次出现时先打一行表头
+    JSON, // 每行一个JSON对象(JSON Lines)
+};
+
+inline Format& format()
+{
+    static Format fmt = Format::TEXT;
+    return fmt;
+}
+
+// 扫描的线程数，main里按 --threads=1,2,4 设置，默认1,2,4...一直到2倍核数
+inline std::vector<int>& threadSweep()
+{
+    static std::vector<int> sweep;
+    if(sweep.empty())
+    {
+        int limit = std::max(4, 2 * (int)std::thread::hardware_concurrency());
+        for(int n=1;n<=limit;n*=2)
+        {
+            sweep.push_back(n);
+        }
+    }
+    return sweep;
+}
+
+// 一行结果：用例名 + 参数 + 指标，按顺序输出
+class Row
+{
+public:
+    explicit Row(std::string bench)
+    {
+        add("bench", bench);
+    }
+    Row& add(const std::string& key, const std::string& value)
+    {
+        fields_.emplace_back(key, value);
+        quoted_.push_back(true);
+        return *this;
+    }
+    Row& add(const std::string& key, const char* value)
+    {
+        return add(key, std::string(value));
+    }
+    Row& add(const std::string& key, double value)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", value);
+        fields_.emplace_back(key, buf);
+        quoted_.push_back(false);
+        return *this;
+    }
+    Row& add(const std::string& key, int value)
+    {
+        return add(key, (double)value);
+    }
+
+    void emit() const
+    {
+        std::string line;
+        switch(format())
+        {
+        case Format::TEXT:
+            for(size_t i=0;i<fields_.size();i++)
+            {
+                line += (i == 0 ? "" : " ") + fields_[i].first + "=" + fields_[i].second;
+            }
+            break;
+        case Format::CSV:
+        {
+            std::string header;
+            for(size_t i=0;i<fields_.size();i++)
+            {
+                header += (i == 0 ? "" : ",") + fields_[i].first;
+                line += (i == 0 ? "" : ",") + fields_[i].second;
+            }
+            static std::string lastHeader;
+            if(header != lastHeader)
+            {
+                std::printf("%s\n", header.c_str());
+                lastHeader = header;
+            }
+            break;
+        }
+        case Format::JSON:
+            line = "{";
+            for(size_t i=0;i<fields_.size();i++)
+            {
+                line += (i == 0 ? "\"" : ",\"") + fields_[i].first + "\":";
+                line += quoted_[i] ? "\"" + fields_[i].second + "\"" : fields_[i].second;
+            }
+            line += "}";
+            break;
+        }
+        std::printf("%s\n", line.c_str());
+        std::fflush(stdout);
+    }
+private:
+    std::vector<std::pair<std::string, std::string>> fields_;
+    std::vector<bool> quoted_;
+};
+} // namespace bench
+
+#define BENCH_REGISTER(name, func) static bench::Registrar bench_registrar_##func(name, func)
+
+#endif //THREADPOOL_BENCH_H
@@ -0,0 +1,68 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// cached模式突发负载：一阵一阵地提交一批短任务，中间空闲一段时间
+// 看提交方的延迟(p50/p99/max)和线程的创建/回收次数(线程抖动)
+namespace
+{
+void runOnce(int bursts, int burstSize, int taskUs, int gapMs)
+{
+    std::vector<double> submitUs;
+    submitUs.reserve(bursts * burstSize);
+    std::atomic_int done(0);
+    int peakThreads = 0;
+    PoolStats st;
+    auto begin = bench::Clock::now();
+    {
+        ThreadPool pool;
+        pool.setMode(PoolMode::MODE_CACHED);
+        pool.setThreadSizeThreshHold(64);
+        pool.start(2);
+
+        for(int b=0;b<bursts;b++)
+        {
+            for(int i=0;i<burstSize;i++)
+            {
+                auto t0 = bench::Clock::now();
+                pool.submit([taskUs, &done]()
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(taskUs));
+                    done++;
+                });
+                submitUs.push_back(std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count());
+                peakThreads = std::max(peakThreads, pool.getThreadSize());
+            }
+            while(done < (b + 1) * burstSize)
+            {
+                std::this_thread::yield();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(gapMs));
+        }
+        st = pool.stats();
+    }
+    double ms = bench::elapsedMs(begin);
+
+    double p50 = bench::percentile(submitUs, 50);
+    double p99 = bench::percentile(submitUs, 99);
+    double maxUs = submitUs.back();// percentile排过序了
+    std::printf("bursts=%d x %d tasks(%dus) gap=%dms | submit p50=%7.1f us p99=%8.1f us max=%8.1f us | "
+                "threads spawned=%llu retired=%llu peak=%d | %8.1f ms\n",
+                bursts, burstSize, taskUs, gapMs,
+                p50, p99, maxUs,
+                (unsigned long long)st.threadsSpawned, (unsigned long long)st.threadsRetired, peakThreads, ms);
+}
+
+void cachedBurst()
+{
+    runOnce(20, 200, 200, 20);
+    runOnce(20, 50, 1000, 50);
+    runOnce(5, 2000, 50, 100);
+}
+} // namespace
+
+BENCH_REGISTER("cached_burst", cachedBurst);
@@ -0,0 +1,111 @@
+#include <memory>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 任务完成通知的开销
+// size        每个排队中的任务为了通知结果要带的字节数：Result/Future的共享对象、批量的计数器
+// complete    在当前线程直接完成一批任务，没人等：只有设置完成标志的开销
+// pool        线程池执行一批空任务，提交方逐个get / 一次waitAll 等全部完成
+namespace
+{
+class EmptyTask : public Task
+{
+public:
+    Any run() override { return 0; }
+};
+
+auto emptyFunc = []() { return 0; };
+using EmptyFutureTask = FutureTask<int, decltype(emptyFunc)>;
+
+void sizes()
+{
+    bench::Row("completion").add("case", "size").add("type", "Task")
+        .add("bytes", (int)sizeof(EmptyTask)).emit();
+    bench::Row("completion").add("case", "size").add("type", "FutureTask<int>")
+        .add("bytes", (int)sizeof(EmptyFutureTask)).emit();
+    bench::Row("completion").add("case", "size").add("type", "Completion")
+        .add("bytes", (int)sizeof(Completion)).emit();
+    bench::Row("completion").add("case", "size").add("type", "Latch")
+        .add("bytes", (int)sizeof(Latch)).emit();
+}
+
+void complete(int tasks)
+{
+    std::vector<std::shared_ptr<EmptyFutureTask>> states;
+    states.reserve(tasks);
+    for(int i=0;i<tasks;i++)
+    {
+        states.push_back(std::make_shared<EmptyFutureTask>(emptyFunc));
+    }
+    auto begin = bench::Clock::now();
+    for(auto& state : states)
+    {
+        state->exec();
+    }
+    double ms = bench::elapsedMs(begin);
+    bench::Row("completion").add("case", "complete").add("type", "FutureTask<int>").add("threads", 0)
+        .add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000)).emit();
+}
+
+void pool(int threads, int tasks)
+{
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_STEALING);
+    pool.start(threads);
+
+    std::vector<Future<int>> futures;
+    futures.reserve(tasks);
+    auto begin = bench::Clock::now();
+    for(int i=0;i<tasks;i++)
+    {
+        futures.push_back(pool.submit(emptyFunc));
+    }
+    for(auto& future : futures)
+    {
+        future.get();
+    }
+    double ms = bench::elapsedMs(begin);
+    bench::Row("completion").add("case", "pool").add("type", "get").add("threads", threads)
+        .add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000)).emit();
+
+    futures.clear();
+    begin = bench::Clock::now();
+    for(int i=0;i<tasks;i++)
+    {
+        futures.push_back(pool.submit(emptyFunc));
+    }
+    waitAll(futures);
+    ms = bench::elapsedMs(begin);
+    bench::Row("completion").add("case", "pool").add("type", "waitAll").add("threads", threads)
+        .add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000)).emit();
+
+    std::vector<Result> results;
+    results.reserve(tasks);
+    begin = bench::Clock::now();
+    for(int i=0;i<tasks;i++)
+    {
+        results.push_back(pool.submitTask(std::make_shared<EmptyTask>()));
+    }
+    for(auto& result : results)
+    {
+        result.get();
+    }
+    ms = bench::elapsedMs(begin);
+    bench::Row("completion").add("case", "pool").add("type", "Result::get").add("threads", threads)
+        .add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000)).emit();
+}
+
+void completion()
+{
+    sizes();
+    complete(1000000);
+    for(int threads : bench::threadSweep())
+    {
+        pool(threads, 200000);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("completion", completion);
@@ -0,0 +1,100 @@
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 对比 MODE_FIXED(单个全局队列+一把锁) 和 MODE_STEALING(每线程本地队列+窃取) 的调度开销
+namespace
+{
+// 几乎不干活的任务，测的就是排队和取任务本身的代价
+class CountTask : public Task
+{
+public:
+    CountTask(std::atomic_int& done)
+        : done_(done)
+    {}
+    Any run()
+    {
+        done_++;
+        return Any();
+    }
+private:
+    std::atomic_int& done_;
+};
+
+// 在池内线程里再拆出children个子任务，模拟分治：工作窃取模式下子任务进本地队列
+class SpawnTask : public Task
+{
+public:
+    SpawnTask(ThreadPool& pool, int children, std::atomic_int& done)
+        : pool_(pool)
+        , children_(children)
+        , done_(done)
+    {}
+    Any run()
+    {
+        for(int i=0;i<children_;i++)
+        {
+            pool_.submitTask(std::make_shared<CountTask>(done_));
+        }
+        done_++;
+        return Any();
+    }
+private:
+    ThreadPool& pool_;
+    int children_;
+    std::atomic_int& done_;
+};
+
+const char* modeName(PoolMode mode)
+{
+    return mode == PoolMode::MODE_STEALING ? "stealing" : "fixed";
+}
+
+// roots个根任务，每个拆出children个子任务；children为0时就是外部线程直接提交的扁平任务
+void runOnce(PoolMode mode, int threads, int roots, int children)
+{
+    std::atomic_int done(0);
+    const int total = roots * (children + 1);
+    double ms = 0;
+    {
+        ThreadPool pool;
+        pool.setMode(mode);
+        pool.start(threads);
+
+        auto begin = bench::Clock::now();
+        for(int i=0;i<roots;i++)
+        {
+            if(children > 0)
+                pool.submitTask(std::make_shared<SpawnTask>(pool, children, done));
+            else
+                pool.submitTask(std::make_shared<CountTask>(done));
+        }
+        while(done < total)
+        {
+            std::this_thread::yield();
+        }
+        ms = bench::elapsedMs(begin);
+    }
+    std::printf("%-8s threads=%-3d tasks=%-7d %9.2f ms %12.0f tasks/s\n",
+                modeName(mode), threads, total, ms, total / ms * 1000);
+}
+
+void contention()
+{
+    const int threadCounts[] = {1, 4, 16, 64};
+    for(int threads : threadCounts)
+    {
+        for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+        {
+            runOnce(mode, threads, 20000, 0);   // 扁平：全部走全局队列
+            runOnce(mode, threads, 200, 100);   // 嵌套：子任务在池内提交
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("contention", contention);
@@ -0,0 +1,101 @@
+// 协程流水线 vs 阻塞get()：N条流水线同时跑，每条依次执行几个阶段任务
+// 协程版：固定4个线程，等阶段结果时协程挂起，不占线程
+// 阻塞版：每条流水线是一个任务，在线程里get()阻塞等每个阶段，cached模式靠加线程才能跑下去
+#ifdef THREADPOOL_COROUTINES
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "threadpool.h"
+#include "coro.h"
+#include "bench/bench.h"
+
+namespace
+{
+const int STAGES = 4;
+
+int stage(int x)
+{
+    auto end = bench::Clock::now() + std::chrono::microseconds(20);
+    while(bench::Clock::now() < end);
+    return x + 1;
+}
+
+Async<int> pipeline(ThreadPool& pool, int x)
+{
+    co_await pool.schedule();
+    for(int i=0;i<STAGES;i++)
+    {
+        x = co_await pool.submit(stage, x);
+    }
+    co_return x;
+}
+
+void report(const char* how, int pipelines, double ms, const PoolStats& st, long sum)
+{
+    std::printf("%-9s pipelines=%-5d %9.1f ms | threads spawned=%-5llu | checksum=%ld\n",
+                how, pipelines, ms, (unsigned long long)st.threadsSpawned, sum);
+}
+
+void runCoroutine(int pipelines)
+{
+    ThreadPool pool;
+    pool.start(4);
+    auto begin = bench::Clock::now();
+    std::vector<Async<int>> results;
+    results.reserve(pipelines);
+    for(int i=0;i<pipelines;i++)
+    {
+        results.push_back(pipeline(pool, i));
+    }
+    long sum = 0;
+    for(auto& r : results)
+    {
+        sum += r.get();
+    }
+    report("coroutine", pipelines, bench::elapsedMs(begin), pool.stats(), sum);
+}
+
+void runBlocking(int pipelines)
+{
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_CACHED);
+    pool.setThreadSizeThreshHold(pipelines + 4);
+    pool.start(4);
+    auto begin = bench::Clock::now();
+    std::vector<Future<int>> results;
+    results.reserve(pipelines);
+    for(int i=0;i<pipelines;i++)
+    {
+        results.push_back(pool.submit([&pool, i]()
+        {
+            int x = i;
+            for(int s=0;s<STAGES;s++)
+            {
+                x = pool.submit(stage, x).get();
+            }
+            return x;
+        }));
+    }
+    long sum = 0;
+    for(auto& r : results)
+    {
+        sum += r.get();
+    }
+    report("blocking", pipelines, bench::elapsedMs(begin), pool.stats(), sum);
+}
+
+void coroutine()
+{
+    for(int pipelines : {100, 1000, 4000})
+    {
+        runCoroutine(pipelines);
+        runBlocking(pipelines);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("coroutine", coroutine);
+
+#endif // THREADPOOL_COROUTINES
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "executor.h"
+#include "bench/bench.h"
+
+// 三个租户(权重4:2:1)同时各提交一批相同的任务：
+// group  一个线程池 + ExecutorGroup，按权重分执行时间
+// pools  每个租户一个ThreadPool，各自都开threads个线程，一共3倍的线程抢CPU
+namespace
+{
+const int TENANTS = 3;
+const int WEIGHTS[TENANTS] = {4, 2, 1};
+
+void spinNs(uint64_t ns)
+{
+    uint64_t end = steadyNowNs() + ns;
+    while(steadyNowNs() < end);
+}
+
+// 每个租户一个提交线程，记录每个任务从提交到开始执行的时间和租户最后一个任务完成的时间
+struct TenantRun
+{
+    std::vector<double> waitUs;
+    std::atomic_int done{0};
+    std::atomic<uint64_t> finishNs{0};
+};
+
+template<typename Submit>
+void runTenants(const char* impl, int threads, int tasks, uint64_t taskNs, Submit submit)
+{
+    std::vector<std::unique_ptr<TenantRun>> runs;
+    for(int t=0;t<TENANTS;t++)
+    {
+        runs.emplace_back(std::make_unique<TenantRun>());
+        runs.back()->waitUs.resize(tasks);
+    }
+    uint64_t begin = steadyNowNs();
+    std::vector<std::thread> submitters;
+    for(int t=0;t<TENANTS;t++)
+    {
+        submitters.emplace_back([&, t]()
+        {
+            TenantRun* run = runs[t].get();
+            for(int i=0;i<tasks;i++)
+            {
+                uint64_t submitNs = steadyNowNs();
+                submit(t, [run, i, submitNs, tasks, taskNs]()
+                {
+                    run->waitUs[i] = (steadyNowNs() - submitNs) / 1000.0;
+                    spinNs(taskNs);
+                    if(++run->done == tasks)
+                        run->finishNs = steadyNowNs();
+                });
+            }
+        });
+    }
+    for(std::thread& t : submitters)
+    {
+        t.join();
+    }
+    uint64_t end = begin;
+    for(auto& run : runs)
+    {
+        while(run->done < tasks)
+        {
+            std::this_thread::yield();
+        }
+        end = std::max(end, run->finishNs.load());
+    }
+    for(int t=0;t<TENANTS;t++)
+    {
+        bench::Row("executor").add("impl", impl).add("threads", threads).add("tenant", t).add("weight", WEIGHTS[t])
+            .add("finish_ms", (runs[t]->finishNs - begin) / 1e6)
+            .add("wait_p50_us", bench::percentile(runs[t]->waitUs, 50))
+            .add("wait_p99_us", bench::percentile(runs[t]->waitUs, 99))
+            .emit();
+    }
+    double ms = (end - begin) / 1e6;
+    bench::Row("executor").add("impl", impl).add("threads", threads).add("tenant", "all").add("weight", 0)
+        .add("finish_ms", ms).add("tasks_per_sec", TENANTS * tasks / (ms / 1000))
+        .emit();
+}
+
+void executor()
+{
+    const int tasks = 2000;
+    const uint64_t taskNs = 20000;
+    for(int threads : bench::threadSweep())
+    {
+        {
+            ThreadPool pool;
+            pool.setTaskQueMaxThreshHold(TENANTS * tasks);
+            pool.start(threads);
+            ExecutorGroup group(pool);
+            for(int t=0;t<TENANTS;t++)
+            {
+                group.addTenant("tenant" + std::to_string(t), WEIGHTS[t], tasks);
+            }
+            runTenants("group", threads, tasks, taskNs, [&](int tenant, auto func)
+            {
+                group.post(tenant, std::move(func));
+            });
+        }
+        {
+            std::vector<std::unique_ptr<ThreadPool>> pools;
+            for(int t=0;t<TENANTS;t++)
+            {
+                pools.emplace_back(std::make_unique<ThreadPool>());
+                pools.back()->setTaskQueMaxThreshHold(tasks);
+                pools.back()->start(threads);
+            }
+            runTenants("pools", threads, tasks, taskNs, [&](int tenant, auto func)
+            {
+                pools[tenant]->post(std::move(func));
+            });
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("executor", executor);
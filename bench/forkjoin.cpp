@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 递归拆分的任务(fork-join)：任务里提交子任务再get等它的结果
+// 所有线程都在get里等的时候，等待方帮着执行排队的子任务，固定线程数(MODE_FIXED 1、2个线程)也能跑完
+// fib   每层提交fib(n-1)，自己算fib(n-2)，n小于cutoff时直接递归
+// qsort 分区后提交左半边，自己排右半边，区间小于cutoff时std::sort
+namespace
+{
+const int FIB_N = 30;
+const int FIB_CUTOFF = 18;
+const size_t SORT_SIZE = 1 << 21;
+const size_t SORT_CUTOFF = 1 << 14;
+
+long fibSeq(int n)
+{
+    return n < 2 ? n : fibSeq(n - 1) + fibSeq(n - 2);
+}
+
+long fibPar(ThreadPool& pool, int n)
+{
+    if(n < FIB_CUTOFF)
+        return fibSeq(n);
+    Future<long> left = pool.submit([&pool, n]() { return fibPar(pool, n - 1); });
+    long right = fibPar(pool, n - 2);
+    return left.get() + right;
+}
+
+void sortPar(ThreadPool& pool, int* first, int* last)
+{
+    if((size_t)(last - first) < SORT_CUTOFF)
+    {
+        std::sort(first, last);
+        return;
+    }
+    int pivot = first[(last - first) / 2];
+    int* mid1 = std::partition(first, last, [pivot](int v) { return v < pivot; });
+    int* mid2 = std::partition(mid1, last, [pivot](int v) { return v == pivot; });
+    Future<void> left = pool.submit([&pool, first, mid1]() { sortPar(pool, first, mid1); });
+    sortPar(pool, mid2, last);
+    left.get();
+}
+
+void emitRow(const char* name, const char* mode, int threads, double ms, double seqMs, bool ok, uint64_t helps)
+{
+    bench::Row("forkjoin").add("case", name).add("mode", mode).add("threads", threads)
+        .add("ms", ms).add("speedup", seqMs / ms).add("ok", ok ? 1 : 0).add("helped_tasks", (double)helps)
+        .emit();
+}
+
+void forkjoin()
+{
+    auto begin = bench::Clock::now();
+    long expect = fibSeq(FIB_N);
+    double fibSeqMs = bench::elapsedMs(begin);
+
+    std::vector<int> input(SORT_SIZE);
+    std::mt19937 rng(42);
+    for(int& v : input)
+    {
+        v = (int)rng();
+    }
+    std::vector<int> data = input;
+    begin = bench::Clock::now();
+    std::sort(data.begin(), data.end());
+    double sortSeqMs = bench::elapsedMs(begin);
+
+    emitRow("fib", "seq", 1, fibSeqMs, fibSeqMs, true, 0);
+    emitRow("qsort", "seq", 1, sortSeqMs, sortSeqMs, true, 0);
+
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+
+            // 最外层从提交方线程进来，之后的get都在池内线程上
+            begin = bench::Clock::now();
+            long fib = pool.submit([&pool]() { return fibPar(pool, FIB_N); }).get();
+            double fibMs = bench::elapsedMs(begin);
+            uint64_t fibHelps = 0;
+            for(const WorkerStats& worker : pool.stats().workers)
+            {
+                fibHelps += worker.helps;
+            }
+
+            data = input;
+            begin = bench::Clock::now();
+            pool.submit([&pool, &data]() { sortPar(pool, data.data(), data.data() + data.size()); }).get();
+            double sortMs = bench::elapsedMs(begin);
+
+            uint64_t sortHelps = 0;
+            for(const WorkerStats& worker : pool.stats().workers)
+            {
+                sortHelps += worker.helps;
+            }
+            const char* name = mode == PoolMode::MODE_STEALING ? "stealing" : "fixed";
+            emitRow("fib", name, threads, fibMs, fibSeqMs, fib == expect, fibHelps);
+            emitRow("qsort", name, threads, sortMs, sortSeqMs, std::is_sorted(data.begin(), data.end()), sortHelps - fibHelps);
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("forkjoin", forkjoin);
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 线程空闲策略 IDLE_PARK / IDLE_SPIN：任务隔一段时间来一个(线程已经闲下来了)，从提交到开始执行的延迟分布，
+// 以及全部空闲以后100ms里整个进程用掉的CPU时间(自旋不能在真正空闲时一直占着CPU)
+namespace
+{
+double cpuMs()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3
+         + usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+}
+
+void runOnce(IdlePolicy policy, PoolMode mode, int threads, int gapUs, int tasks)
+{
+    std::vector<double> waitNs(tasks);
+    std::atomic_int done(0);
+    double idleCpu = 0;
+    {
+        ThreadPool pool;
+        pool.setMode(mode);
+        pool.setIdlePolicy(policy);
+        pool.start(threads);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        for(int i=0;i<tasks;i++)
+        {
+            uint64_t submitNs = steadyNowNs();
+            pool.post([submitNs, i, &waitNs, &done]()
+            {
+                waitNs[i] = steadyNowNs() - submitNs;
+                done++;
+            });
+            if(gapUs > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+        }
+        while(done < tasks)
+        {
+            std::this_thread::yield();
+        }
+
+        double before = cpuMs();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        idleCpu = cpuMs() - before;
+    }
+    bench::Row("idle").add("policy", policy == IdlePolicy::IDLE_SPIN ? "spin" : "park")
+        .add("mode", mode == PoolMode::MODE_STEALING ? "stealing" : "fixed")
+        .add("threads", threads).add("gap_us", gapUs)
+        .add("p50_ns", bench::percentile(waitNs, 50)).add("p90_ns", bench::percentile(waitNs, 90))
+        .add("p99_ns", bench::percentile(waitNs, 99)).add("p999_ns", bench::percentile(waitNs, 99.9))
+        .add("max_ns", bench::percentile(waitNs, 100)).add("idle_cpu_ms_per_100ms", idleCpu)
+        .emit();
+}
+
+void idle()
+{
+    for(int threads : bench::threadSweep())
+    {
+        for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+        {
+            for(int gapUs : {0, 20, 200})
+            {
+                for(IdlePolicy policy : {IdlePolicy::IDLE_PARK, IdlePolicy::IDLE_SPIN})
+                {
+                    runOnce(policy, mode, threads, gapUs, gapUs == 0 ? 20000 : 2000);
+                }
+            }
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("idle", idle);
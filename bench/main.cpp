@@ -0,0 +1,59 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench/bench.h"
+
+// 用法：threadpool_bench [--csv|--json] [--threads=1,2,4] [名字...]
+// 不带名字跑全部，带名字只跑名字里包含该字符串的；--csv/--json只影响用bench::Row输出的用例(suite)
+int main(int argc, char* argv[])
+{
+    std::vector<const char*> names;
+    for(int i=1;i<argc;i++)
+    {
+        if(std::strcmp(argv[i], "--csv") == 0)
+        {
+            bench::format() = bench::Format::CSV;
+        }
+        else if(std::strcmp(argv[i], "--json") == 0)
+        {
+            bench::format() = bench::Format::JSON;
+        }
+        else if(std::strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            std::vector<int>& sweep = bench::threadSweep();
+            sweep.clear();
+            for(const char* p = argv[i] + 10;*p;)
+            {
+                char* end = nullptr;
+                long n = std::strtol(p, &end, 10);
+                if(end == p)
+                    break;
+                if(n > 0)
+                    sweep.push_back((int)n);
+                p = *end == ',' ? end + 1 : end;
+            }
+        }
+        else
+        {
+            names.push_back(argv[i]);
+        }
+    }
+
+    for(auto& item : bench::registry())
+    {
+        bool selected = names.empty();
+        for(size_t i=0;i<names.size() && !selected;i++)
+        {
+            selected = std::strstr(item.first.c_str(), names[i]) != nullptr;
+        }
+        if(!selected)
+            continue;
+        // 机器可读的输出里不混别的行，用例名打到stderr
+        std::fprintf(bench::format() == bench::Format::TEXT ? stdout : stderr, "== %s\n", item.first.c_str());
+        item.second();
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 持续过载：提交速度远超过线程的处理能力，队列一直是满的
+// 看各个溢出策略下提交方每次调用的延迟(p50/p99/max)，以及成功/拒绝/挤掉/提交方执行的任务数
+namespace
+{
+// 忙等，sleep在过载时会把CPU让给提交方，测不出排队
+void spinUs(int us)
+{
+    auto end = bench::Clock::now() + std::chrono::microseconds(us);
+    while(bench::Clock::now() < end);
+}
+
+void runOnce(const char* name, OverflowPolicy policy, int timeoutMs, size_t maxBytes, QueueMode mode)
+{
+    const int tasks = 20000;
+    const int taskUs = 20;
+    std::vector<double> submitUs;
+    submitUs.reserve(tasks);
+    std::atomic_int done(0);
+    PoolStats st;
+    auto begin = bench::Clock::now();
+    {
+        ThreadPool pool;
+        pool.setQueueMode(mode);
+        pool.setTaskQueMaxThreshHold(64);
+        pool.setOverflowPolicy(policy);
+        pool.setSubmitTimeout(timeoutMs);
+        pool.setTaskQueMaxBytes(maxBytes);
+        pool.start(2);
+
+        for(int i=0;i<tasks;i++)
+        {
+            char pad[96] = {};// 放不进内部缓冲区，按内存限制时每个任务占64+112字节
+            auto t0 = bench::Clock::now();
+            pool.post([taskUs, &done, pad]()
+            {
+                spinUs(taskUs + pad[0]);
+                done++;
+            });
+            submitUs.push_back(std::chrono::duration<double, std::micro>(bench::Clock::now() - t0).count());
+        }
+        st = pool.stats();
+    }
+    double ms = bench::elapsedMs(begin);
+
+    double p50 = bench::percentile(submitUs, 50);
+    double p99 = bench::percentile(submitUs, 99);
+    double maxUs = submitUs.back();// percentile排过序了
+    std::printf("%-22s %-5s | submit p50=%7.1f us p99=%8.1f us max=%9.1f us | "
+                "ok=%5llu rejected=%5llu dropped=%5llu caller-runs=%5llu | %7.1f ms\n",
+                name, mode == QueueMode::MODE_RING ? "ring" : "mutex", p50, p99, maxUs,
+                (unsigned long long)st.submitted, (unsigned long long)st.rejected,
+                (unsigned long long)st.dropped, (unsigned long long)st.callerRuns, ms);
+}
+
+void overload()
+{
+    for(QueueMode mode : {QueueMode::MODE_MUTEX, QueueMode::MODE_RING})
+    {
+        runOnce("block (1s)", OverflowPolicy::OVERFLOW_BLOCK, 1000, 0, mode);
+        runOnce("block (1ms)", OverflowPolicy::OVERFLOW_BLOCK, 1, 0, mode);
+        runOnce("fail", OverflowPolicy::OVERFLOW_FAIL, 0, 0, mode);
+        runOnce("caller-runs", OverflowPolicy::OVERFLOW_CALLER_RUNS, 0, 0, mode);
+        runOnce("drop-oldest", OverflowPolicy::OVERFLOW_DROP_OLDEST, 0, 0, mode);
+        runOnce("fail (4KB bound)", OverflowPolicy::OVERFLOW_FAIL, 0, 4096, mode);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("overload", overload);
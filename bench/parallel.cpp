@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "threadpool.h"
+#include "parallel.h"
+#include "bench/bench.h"
+
+// test.cpp里手工切区间提交MyTask再合并 vs parallelReduce/parallelTransformReduce
+// 均匀负载：求和；不均匀负载：第i个元素的计算量和i成正比，手工等分的最后一段最慢
+namespace
+{
+using uLong = unsigned long long;
+
+// 不均匀负载：i越大算得越久
+uLong skewedWork(uLong i)
+{
+    uLong x = i;
+    for(uLong k=0;k<i/64;k++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    return x & 0xff;
+}
+
+// 和test.cpp的MyTask一样，一个任务负责一段
+class RangeTask : public Task
+{
+public:
+    RangeTask(const std::vector<uLong>& data, size_t begin, size_t end, bool skewed)
+        : data_(data)
+        , begin_(begin)
+        , end_(end)
+        , skewed_(skewed)
+    {}
+    Any run()
+    {
+        uLong sum = 0;
+        for(size_t i=begin_;i<end_;i++)
+            sum += skewed_ ? skewedWork(data_[i]) : data_[i];
+        return sum;
+    }
+private:
+    const std::vector<uLong>& data_;
+    size_t begin_;
+    size_t end_;
+    bool skewed_;
+};
+
+uLong handChunked(ThreadPool& pool, const std::vector<uLong>& data, int chunks, bool skewed)
+{
+    std::vector<Result> results;
+    size_t step = data.size() / chunks;
+    for(int i=0;i<chunks;i++)
+    {
+        size_t end = i == chunks - 1 ? data.size() : (i + 1) * step;
+        results.push_back(pool.submitTask(std::make_shared<RangeTask>(data, i * step, end, skewed)));
+    }
+    uLong sum = 0;
+    for(auto& res : results)
+        sum += res.get().cast_<uLong>();
+    return sum;
+}
+
+void runOnce(const char* name, const std::vector<uLong>& data, int threads, bool skewed)
+{
+    ThreadPool pool;
+    pool.start(threads);
+
+    auto begin = bench::Clock::now();
+    uLong handSum = handChunked(pool, data, threads, skewed);
+    double handMs = bench::elapsedMs(begin);
+
+    begin = bench::Clock::now();
+    uLong parSum = skewed
+        ? parallelTransformReduce(pool, data.begin(), data.end(), 0ULL, std::plus<>(), skewedWork)
+        : parallelReduce(pool, data.begin(), data.end(), 0ULL);
+    double parMs = bench::elapsedMs(begin);
+
+    std::printf("%-8s threads=%-3d hand-chunked %9.2f ms | parallel %9.2f ms | %s\n",
+                name, threads, handMs, parMs, handSum == parSum ? "sums match" : "SUMS DIFFER");
+}
+
+void parallelAlgorithms()
+{
+    std::vector<uLong> data(1 << 22);
+    std::iota(data.begin(), data.end(), 1ULL);
+    std::vector<uLong> skewed(1 << 15);
+    std::iota(skewed.begin(), skewed.end(), 0ULL);
+    for(int threads : {1, 2, 4, 8})
+    {
+        runOnce("uniform", data, threads, false);
+        runOnce("skewed", skewed, threads, true);
+    }
+
+    ThreadPool pool;
+    pool.start(4);
+    std::vector<uLong> prefix(data.size());
+    auto begin = bench::Clock::now();
+    parallelInclusiveScan(pool, data.begin(), data.end(), prefix.begin());
+    double ms = bench::elapsedMs(begin);
+    std::printf("scan     threads=4   %zu elements %9.2f ms | %s\n", data.size(), ms,
+                prefix.back() == data.size() * (data.size() + 1) / 2 ? "ok" : "WRONG");
+}
+} // namespace
+
+BENCH_REGISTER("parallel", parallelAlgorithms);
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 后台用大量低优先级任务把线程池压满，同时按固定间隔提交高优先级的探测任务，
+// 看高优先级任务从提交到开始执行的排队耗时(p50/p99)，以及低优先级任务是否还能持续完成(老化)
+// 对照组：所有任务都用默认优先级，探测任务只能排在后台任务后面
+namespace
+{
+double usSince(bench::Clock::time_point begin, bench::Clock::time_point end)
+{
+    return std::chrono::duration<double, std::micro>(end - begin).count();
+}
+
+void spin(int us)
+{
+    auto end = bench::Clock::now() + std::chrono::microseconds(us);
+    while(bench::Clock::now() < end);
+}
+
+void runOnce(bool usePriority, int threads, int background, int probes)
+{
+    TaskPriority high = usePriority ? TaskPriority::PRIORITY_HIGH : TaskPriority::PRIORITY_NORMAL;
+    TaskPriority low = usePriority ? TaskPriority::PRIORITY_LOW : TaskPriority::PRIORITY_NORMAL;
+    std::vector<double> highUs(probes);
+    std::vector<double> lowUs(background);
+    std::atomic_int lowDone(0);
+    std::atomic_int highDone(0);
+    int lowDoneAtProbeEnd = 0;
+    {
+        ThreadPool pool;
+        pool.start(threads);
+
+        // 后台任务一次性放进去，队列一直积压着
+        for(int i=0;i<background;i++)
+        {
+            auto begin = bench::Clock::now();
+            pool.submit(low, [begin, i, &lowUs, &lowDone]()
+            {
+                lowUs[i] = usSince(begin, bench::Clock::now());
+                spin(100);
+                lowDone++;
+            });
+        }
+
+        for(int i=0;i<probes;i++)
+        {
+            auto begin = bench::Clock::now();
+            pool.submit(high, [begin, i, &highUs, &highDone]()
+            {
+                highUs[i] = usSince(begin, bench::Clock::now());
+                spin(20);
+                highDone++;
+            });
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        while(highDone < probes)
+        {
+            std::this_thread::yield();
+        }
+        lowDoneAtProbeEnd = lowDone;
+    }
+    std::printf("%-8s threads=%-2d high wait p50=%9.1f us p99=%10.1f us | low wait p50=%9.1f us p99=%10.1f us"
+                " | low done while probing=%d/%d\n",
+                usePriority ? "priority" : "fifo", threads,
+                bench::percentile(highUs, 50), bench::percentile(highUs, 99),
+                bench::percentile(lowUs, 50), bench::percentile(lowUs, 99),
+                lowDoneAtProbeEnd, background);
+}
+
+// 反过来用高优先级任务压满，少量低优先级任务靠老化也能在高优先级任务做完之前完成
+void runAging(int threads, int background, int lows)
+{
+    std::vector<double> lowUs(lows);
+    std::atomic_int highDone(0);
+    std::atomic_int lowDone(0);
+    int highDoneAtLowEnd = 0;
+    {
+        ThreadPool pool;
+        pool.setTaskPriorityAging(20);
+        pool.start(threads);
+        for(int i=0;i<background;i++)
+        {
+            pool.submit(TaskPriority::PRIORITY_HIGH, [&highDone]()
+            {
+                spin(100);
+                highDone++;
+            });
+        }
+        for(int i=0;i<lows;i++)
+        {
+            auto begin = bench::Clock::now();
+            pool.submit(TaskPriority::PRIORITY_LOW, [begin, i, &lowUs, &lowDone]()
+            {
+                lowUs[i] = usSince(begin, bench::Clock::now());
+                lowDone++;
+            });
+        }
+        while(lowDone < lows)
+        {
+            std::this_thread::yield();
+        }
+        highDoneAtLowEnd = highDone;
+    }
+    std::printf("aging    threads=%-2d low wait p50=%9.1f us p99=%10.1f us | high done when lows finished=%d/%d\n",
+                threads, bench::percentile(lowUs, 50), bench::percentile(lowUs, 99),
+                highDoneAtLowEnd, background);
+}
+
+void priority()
+{
+    for(int threads : {2, 4})
+    {
+        runOnce(false, threads, 20000, 300);
+        runOnce(true, threads, 20000, 300);
+        runAging(threads, 20000, 200);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("priority", priority);
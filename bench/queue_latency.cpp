@@ -0,0 +1,59 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 对比全局队列的两种实现 MODE_MUTEX / MODE_RING：提交耗时、从提交到开始执行的排队耗时(p50/p99)
+namespace
+{
+double nsSince(bench::Clock::time_point begin, bench::Clock::time_point end)
+{
+    return std::chrono::duration<double, std::nano>(end - begin).count();
+}
+
+void runOnce(QueueMode mode, int threads, int tasks)
+{
+    std::vector<double> submitNs(tasks);
+    std::vector<double> waitNs(tasks);
+    std::atomic_int done(0);
+    {
+        ThreadPool pool;
+        pool.setQueueMode(mode);
+        pool.setTaskQueMaxThreshHold(4096);
+        pool.start(threads);
+
+        for(int i=0;i<tasks;i++)
+        {
+            auto begin = bench::Clock::now();
+            pool.submit([begin, i, &waitNs, &done]()
+            {
+                waitNs[i] = nsSince(begin, bench::Clock::now());
+                done++;
+            });
+            submitNs[i] = nsSince(begin, bench::Clock::now());
+        }
+        while(done < tasks)
+        {
+            std::this_thread::yield();
+        }
+    }
+    std::printf("%-6s threads=%-3d submit p50=%8.0f ns p99=%9.0f ns | dequeue p50=%9.0f ns p99=%10.0f ns\n",
+                mode == QueueMode::MODE_RING ? "ring" : "mutex", threads,
+                bench::percentile(submitNs, 50), bench::percentile(submitNs, 99),
+                bench::percentile(waitNs, 50), bench::percentile(waitNs, 99));
+}
+
+void queueLatency()
+{
+    for(int threads : {1, 4, 16})
+    {
+        runOnce(QueueMode::MODE_MUTEX, threads, 50000);
+        runOnce(QueueMode::MODE_RING, threads, 50000);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("queue_latency", queueLatency);
@@ -0,0 +1,78 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 线程池的停止和重启：start+shutdown一轮要多久，以及三种停止方式在还有大量排队任务时的耗时
+namespace
+{
+const char* modeName(PoolMode mode)
+{
+    switch(mode)
+    {
+    case PoolMode::MODE_FIXED: return "fixed";
+    case PoolMode::MODE_CACHED: return "cached";
+    default: return "stealing";
+    }
+}
+
+// 同一个线程池反复start/shutdown
+void restart(PoolMode mode, int threads, int rounds)
+{
+    ThreadPool pool;
+    pool.setMode(mode);
+    auto begin = bench::Clock::now();
+    for(int i=0;i<rounds;i++)
+    {
+        pool.start(threads);
+        pool.post([]() {});
+        pool.shutdown();
+    }
+    std::printf("restart  %-8s threads=%2d | %8.1f us/round\n", modeName(mode), threads,
+                bench::elapsedMs(begin) * 1000 / rounds);
+}
+
+// 排队queued个任务(每个taskUs)之后停止
+void teardown(const char* name, int queued, int taskUs, std::function<std::vector<TaskItem>(ThreadPool&)> stop)
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(queued);
+    pool.start(4);
+    for(int i=0;i<queued;i++)
+    {
+        pool.post([taskUs]() { std::this_thread::sleep_for(std::chrono::microseconds(taskUs)); });
+    }
+    auto begin = bench::Clock::now();
+    std::vector<TaskItem> left = stop(pool);
+    double ms = bench::elapsedMs(begin);
+    for(TaskItem& task : left)
+    {
+        ThreadPool::discardTask(std::move(task));
+    }
+    std::printf("shutdown %-16s queued=%d x %dus | %8.2f ms, left unrun=%zu\n", name, queued, taskUs, ms, left.size());
+}
+
+void shutdownBench()
+{
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_CACHED, PoolMode::MODE_STEALING})
+    {
+        restart(mode, 4, 200);
+        restart(mode, 16, 50);
+    }
+    const int queued = 2000;
+    const int taskUs = 200;
+    teardown("drain", queued, taskUs, [](ThreadPool& pool) { return pool.shutdown(); });
+    teardown("discard", queued, taskUs, [](ThreadPool& pool)
+    {
+        return pool.shutdown(ShutdownMode::SHUTDOWN_DISCARD);
+    });
+    teardown("deadline(20ms)", queued, taskUs, [](ThreadPool& pool)
+    {
+        return pool.shutdown(std::chrono::steady_clock::now() + std::chrono::milliseconds(20));
+    });
+}
+} // namespace
+
+BENCH_REGISTER("shutdown", shutdownBench);
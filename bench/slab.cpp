@@ -0,0 +1,109 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 大量很小的任务：任务对象、结果、共享状态从每线程slab分配 vs 普通new/delete
+// 提交方分配、线程池线程执行完释放(或反过来)，正好都是跨线程释放；顺带看常驻内存涨了多少
+namespace
+{
+class TinyTask : public Task
+{
+public:
+    TinyTask(std::atomic_int& done)
+        : done_(done)
+    {}
+    Any run() override
+    {
+        done_++;
+        return 0;
+    }
+private:
+    std::atomic_int& done_;
+};
+
+// 当前常驻内存(KB)，读/proc/self/status的VmRSS
+long residentKb()
+{
+    std::ifstream in("/proc/self/status");
+    std::string line;
+    while(std::getline(in, line))
+    {
+        if(line.compare(0, 6, "VmRSS:") == 0)
+            return std::stol(line.substr(6));
+    }
+    return 0;
+}
+
+template<typename Submit>
+void measure(const char* name, bool useSlab, int tasks, Submit submit)
+{
+    const int submitters = 2;
+    std::atomic_int done(0);
+    long rssBefore = residentKb();
+    SlabResource::Stats before = SlabResource::stats();
+    double ms = 0;
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(65536);
+        pool.setMemoryResource(useSlab ? SlabResource::instance() : std::pmr::new_delete_resource());
+        pool.start(4);
+        auto begin = bench::Clock::now();
+        std::vector<std::thread> threads;
+        for(int t=0;t<submitters;t++)
+        {
+            threads.emplace_back([&]()
+            {
+                for(int i=0;i<tasks / submitters;i++)
+                {
+                    submit(pool, done);
+                }
+            });
+        }
+        for(std::thread& t : threads)
+        {
+            t.join();
+        }
+        while(done < tasks / submitters * submitters)
+        {
+            std::this_thread::yield();
+        }
+        ms = bench::elapsedMs(begin);
+    }
+    SlabResource::Stats after = SlabResource::stats();
+    std::printf("%-20s %-10s %7.1f ns/task | rss +%6ld KB | slabs +%4llu | remote frees +%llu\n", name,
+                useSlab ? "slab" : "new/delete", ms * 1e6 / tasks, residentKb() - rssBefore,
+                (unsigned long long)(after.slabs - before.slabs),
+                (unsigned long long)(after.remoteFrees - before.remoteFrees));
+}
+
+void slab()
+{
+    const int tasks = 400000;
+    for(int round=0;round<2;round++)
+    {
+        std::printf("round %d\n", round);
+        for(bool useSlab : {false, true})
+        {
+            measure("submit (Future)", useSlab, tasks, [](ThreadPool& pool, std::atomic_int& done)
+            {
+                pool.submit([&done]() { done++; });
+            });
+            measure("makeTask (Task)", useSlab, tasks, [useSlab](ThreadPool& pool, std::atomic_int& done)
+            {
+                if(useSlab)
+                    pool.submitTask(pool.makeTask<TinyTask>(done));
+                else
+                    pool.submitTask(std::make_shared<TinyTask>(done));
+            });
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("slab", slab);
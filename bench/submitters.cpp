@@ -0,0 +1,85 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 很多外部线程同时提交：一把锁的全局队列、无锁环形队列、按提交线程拆分片的注入队列，提交线程从1到64
+namespace
+{
+const char* queueName(QueueMode mode)
+{
+    switch(mode)
+    {
+    case QueueMode::MODE_RING: return "ring";
+    case QueueMode::MODE_SHARDED: return "sharded";
+    default: return "mutex";
+    }
+}
+
+void runOnce(QueueMode mode, int workers, int submitters, int tasks)
+{
+    std::atomic_int done(0);
+    int each = tasks / submitters;
+    std::vector<double> submitNs(submitters);
+    double ms = 0;
+    {
+        ThreadPool pool;
+        pool.setQueueMode(mode);
+        pool.setTaskQueMaxThreshHold(1 << 16);
+        pool.start(workers);
+
+        std::atomic_bool go(false);
+        std::vector<std::thread> threads;
+        for(int t=0;t<submitters;t++)
+        {
+            threads.emplace_back([&, t]()
+            {
+                while(!go)
+                {
+                    std::this_thread::yield();
+                }
+                auto begin = bench::Clock::now();
+                for(int i=0;i<each;i++)
+                {
+                    pool.post([&done]() { done++; });
+                }
+                submitNs[t] = bench::elapsedMs(begin) * 1e6 / each;// 这个提交线程平均每次post的耗时
+            });
+        }
+        auto begin = bench::Clock::now();
+        go = true;
+        for(std::thread& t : threads)
+        {
+            t.join();
+        }
+        while(done < each * submitters)
+        {
+            std::this_thread::yield();
+        }
+        ms = bench::elapsedMs(begin);
+    }
+    bench::Row("submitters").add("queue", queueName(mode)).add("threads", workers).add("submitters", submitters)
+        .add("tasks", each * submitters).add("ms", ms).add("tasks_per_sec", each * submitters / (ms / 1000))
+        .add("post_ns_median", bench::percentile(submitNs, 50)).add("post_ns_max", bench::percentile(submitNs, 100))
+        .emit();
+}
+
+void submitters()
+{
+    const int tasks = 128000;
+    for(int workers : bench::threadSweep())
+    {
+        for(QueueMode mode : {QueueMode::MODE_MUTEX, QueueMode::MODE_RING, QueueMode::MODE_SHARDED})
+        {
+            for(int submitters=1;submitters<=64;submitters*=2)
+            {
+                runOnce(mode, workers, submitters, tasks);
+            }
+        }
+    }
+}
+} // namespace
+
+BENCH_REGISTER("submitters", submitters);
@@ -0,0 +1,314 @@
+#include <atomic>
+#include <future>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 固定负载的基准套件，按线程数扫描，结果用bench::Row输出(--csv/--json机器可读)
+// impl列：fixed/stealing/cached是线程池的模式，async是每个任务一个std::async(launch::async)的对照组
+// 用例：empty 空任务吞吐  fanout 扇出再汇合  producers 多个线程同时提交  skewed 耗时长短不一
+//       burst cached模式突发  roundtrip 提交一个任务马上get的往返延迟
+namespace
+{
+const char* modeName(PoolMode mode)
+{
+    switch(mode)
+    {
+    case PoolMode::MODE_FIXED: return "fixed";
+    case PoolMode::MODE_CACHED: return "cached";
+    default: return "stealing";
+    }
+}
+
+// 忙等，模拟纯计算的任务
+void spinNs(uint64_t ns)
+{
+    uint64_t end = steadyNowNs() + ns;
+    while(steadyNowNs() < end);
+}
+
+double usSince(bench::Clock::time_point begin)
+{
+    return std::chrono::duration<double, std::micro>(bench::Clock::now() - begin).count();
+}
+
+void waitDone(const std::atomic_int& done, int total)
+{
+    while(done < total)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void emitThroughput(const char* name, const char* impl, int threads, int tasks, double ms)
+{
+    bench::Row(name).add("impl", impl).add("threads", threads).add("tasks", tasks)
+        .add("ms", ms).add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000))
+        .emit();
+}
+
+// 空任务：测的全是提交、排队、取任务的开销
+void empty()
+{
+    const int tasks = 100000;
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            std::atomic_int done(0);
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            auto begin = bench::Clock::now();
+            for(int i=0;i<tasks;i++)
+            {
+                pool.post([&done]() { done++; });
+            }
+            waitDone(done, tasks);
+            emitThroughput("empty", modeName(mode), threads, tasks, bench::elapsedMs(begin));
+        }
+    }
+    const int asyncTasks = 2000;// 每个任务一个线程，数量少一些
+    auto begin = bench::Clock::now();
+    std::vector<std::future<void>> futures;
+    futures.reserve(asyncTasks);
+    for(int i=0;i<asyncTasks;i++)
+    {
+        futures.push_back(std::async(std::launch::async, []() {}));
+    }
+    for(auto& future : futures)
+    {
+        future.get();
+    }
+    emitThroughput("empty", "async", 0, asyncTasks, bench::elapsedMs(begin));
+}
+
+// 每轮扇出width个小任务(2us)，再逐个get汇合，记录每轮耗时
+void fanout()
+{
+    const int rounds = 50;
+    const int width = 200;
+    auto emit = [&](const char* impl, int threads, std::vector<double>& roundUs)
+    {
+        bench::Row("fanout").add("impl", impl).add("threads", threads).add("width", width)
+            .add("round_p50_us", bench::percentile(roundUs, 50)).add("round_p99_us", bench::percentile(roundUs, 99))
+            .emit();
+    };
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            std::vector<double> roundUs;
+            std::vector<Future<int>> futures(width);
+            for(int r=0;r<rounds;r++)
+            {
+                auto begin = bench::Clock::now();
+                for(int i=0;i<width;i++)
+                {
+                    futures[i] = pool.submit([i]() { spinNs(2000); return i; });
+                }
+                long sum = 0;
+                for(auto& future : futures)
+                {
+                    sum += future.get();
+                }
+                roundUs.push_back(usSince(begin) + (sum < 0 ? 1 : 0));
+            }
+            emit(modeName(mode), threads, roundUs);
+        }
+    }
+    std::vector<double> roundUs;
+    std::vector<std::future<int>> futures(width);
+    for(int r=0;r<rounds / 5;r++)
+    {
+        auto begin = bench::Clock::now();
+        for(int i=0;i<width;i++)
+        {
+            futures[i] = std::async(std::launch::async, [i]() { spinNs(2000); return i; });
+        }
+        for(auto& future : futures)
+        {
+            future.get();
+        }
+        roundUs.push_back(usSince(begin));
+    }
+    emit("async", 0, roundUs);
+}
+
+// 提交方和线程池线程一样多，同时往里提交空任务
+void producers()
+{
+    const int tasks = 100000;
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            std::atomic_int done(0);
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            int each = tasks / threads;
+            auto begin = bench::Clock::now();
+            std::vector<std::thread> submitters;
+            for(int t=0;t<threads;t++)
+            {
+                submitters.emplace_back([&]()
+                {
+                    for(int i=0;i<each;i++)
+                    {
+                        pool.post([&done]() { done++; });
+                    }
+                });
+            }
+            for(std::thread& t : submitters)
+            {
+                t.join();
+            }
+            waitDone(done, each * threads);
+            emitThroughput("producers", modeName(mode), threads, each * threads, bench::elapsedMs(begin));
+        }
+    }
+}
+
+// 90%的任务1us，9%的20us，1%的500us，固定随机种子；efficiency = 任务总耗时 / (总时间 * 线程数)
+void skewed()
+{
+    const int tasks = 20000;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, 99);
+    std::vector<uint64_t> durations(tasks);
+    uint64_t totalNs = 0;
+    for(uint64_t& ns : durations)
+    {
+        int x = dist(rng);
+        ns = x < 90 ? 1000 : (x < 99 ? 20000 : 500000);
+        totalNs += ns;
+    }
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            std::atomic_int done(0);
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            auto begin = bench::Clock::now();
+            for(uint64_t ns : durations)
+            {
+                pool.post([ns, &done]() { spinNs(ns); done++; });
+            }
+            waitDone(done, tasks);
+            double ms = bench::elapsedMs(begin);
+            int cpus = std::min(threads, (int)std::max(1u, std::thread::hardware_concurrency()));
+            bench::Row("skewed").add("impl", modeName(mode)).add("threads", threads).add("tasks", tasks)
+                .add("ms", ms).add("work_ms", totalNs / 1e6).add("efficiency", totalNs / 1e6 / (ms * cpus))
+                .emit();
+        }
+    }
+}
+
+// cached模式：一阵一阵地提交，中间空闲；threads是初始线程数
+void burst()
+{
+    const int bursts = 20;
+    const int burstSize = 200;
+    for(int threads : bench::threadSweep())
+    {
+        std::atomic_int done(0);
+        std::vector<double> submitUs;
+        PoolStats st;
+        auto begin = bench::Clock::now();
+        {
+            ThreadPool pool;
+            pool.setMode(PoolMode::MODE_CACHED);
+            pool.setThreadSizeThreshHold(64);
+            pool.start(threads);
+            for(int b=0;b<bursts;b++)
+            {
+                for(int i=0;i<burstSize;i++)
+                {
+                    auto t0 = bench::Clock::now();
+                    pool.post([&done]() { spinNs(20000); done++; });
+                    submitUs.push_back(usSince(t0));
+                }
+                waitDone(done, (b + 1) * burstSize);
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            st = pool.stats();
+        }
+        bench::Row("burst").add("impl", "cached").add("threads", threads).add("tasks", bursts * burstSize)
+            .add("ms", bench::elapsedMs(begin)).add("submit_p50_us", bench::percentile(submitUs, 50))
+            .add("submit_p99_us", bench::percentile(submitUs, 99)).add("threads_spawned", (double)st.threadsSpawned)
+            .emit();
+    }
+}
+
+class ValueTask : public Task
+{
+public:
+    Any run() override
+    {
+        return 1;
+    }
+};
+
+// 提交一个任务马上取结果：Result::get(继承Task)和Future::get(submit)
+void roundtrip()
+{
+    const int iterations = 5000;
+    auto emit = [](const char* impl, const char* api, int threads, std::vector<double>& us)
+    {
+        bench::Row("roundtrip").add("impl", impl).add("api", api).add("threads", threads)
+            .add("p50_us", bench::percentile(us, 50)).add("p99_us", bench::percentile(us, 99))
+            .emit();
+    };
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : bench::threadSweep())
+        {
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            std::vector<double> resultUs;
+            std::vector<double> futureUs;
+            for(int i=0;i<iterations;i++)
+            {
+                auto begin = bench::Clock::now();
+                pool.submitTask(std::make_shared<ValueTask>()).get().cast_<int>();
+                resultUs.push_back(usSince(begin));
+                begin = bench::Clock::now();
+                pool.submit([]() { return 1; }).get();
+                futureUs.push_back(usSince(begin));
+            }
+            emit(modeName(mode), "Result", threads, resultUs);
+            emit(modeName(mode), "Future", threads, futureUs);
+        }
+    }
+    std::vector<double> asyncUs;
+    for(int i=0;i<iterations / 5;i++)
+    {
+        auto begin = bench::Clock::now();
+        std::async(std::launch::async, []() { return 1; }).get();
+        asyncUs.push_back(usSince(begin));
+    }
+    emit("async", "std::future", 0, asyncUs);
+}
+
+void suite()
+{
+    empty();
+    fanout();
+    producers();
+    skewed();
+    burst();
+    roundtrip();
+}
+} // namespace
+
+BENCH_REGISTER("suite", suite);
@@ -0,0 +1,124 @@
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "threadpool.h"
+#include "taskgraph.h"
+#include "bench/bench.h"
+
+// 宽图：1个源 -> N个并行节点 -> 1个汇；深图：N个节点串成一条链；
+// 分层图：L层，每层W个节点，每个节点依赖上一层相邻的两个节点
+// 对比：任务图(建一次跑多次) / Future::then串起来 / 提交方一层一层submit再get阻塞等待
+namespace
+{
+std::atomic<uint64_t> sink(0);
+
+void work()
+{
+    uint64_t x = sink.load(std::memory_order_relaxed);
+    for(int i=0;i<200;i++)
+    {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    sink.fetch_add(x & 1, std::memory_order_relaxed);
+}
+
+void report(const char* shape, const char* how, int nodes, int runs, double ms)
+{
+    std::printf("%-8s %-9s nodes=%-5d %8.1f us/run | %7.2f us/node\n",
+                shape, how, nodes, ms * 1000 / runs, ms * 1000 / runs / nodes);
+}
+
+// 按层建图，layers[i]是第i层的宽度，每个节点依赖上一层下标为j和j+1(取模)的节点
+void buildLayered(TaskGraph& graph, const std::vector<int>& layers)
+{
+    std::vector<int> prev;
+    for(int width : layers)
+    {
+        std::vector<int> cur;
+        for(int j=0;j<width;j++)
+        {
+            int node = graph.addNode(work);
+            if(!prev.empty())
+            {
+                graph.addEdge(prev[j % prev.size()], node);
+                if(prev.size() > 1)
+                    graph.addEdge(prev[(j + 1) % prev.size()], node);
+            }
+            cur.push_back(node);
+        }
+        prev = cur;
+    }
+}
+
+// 一层一层提交，提交方get阻塞等整层完成再提交下一层
+double runBlocking(ThreadPool& pool, const std::vector<int>& layers, int runs)
+{
+    auto begin = bench::Clock::now();
+    for(int r=0;r<runs;r++)
+    {
+        for(int width : layers)
+        {
+            std::vector<Future<void>> results;
+            for(int j=0;j<width;j++)
+            {
+                results.push_back(pool.submit(work));
+            }
+            for(auto& f : results)
+            {
+                f.get();
+            }
+        }
+    }
+    return bench::elapsedMs(begin);
+}
+
+double runGraph(ThreadPool& pool, const std::vector<int>& layers, int runs)
+{
+    TaskGraph graph;
+    buildLayered(graph, layers);
+    auto begin = bench::Clock::now();
+    for(int r=0;r<runs;r++)
+    {
+        graph.run(pool).get();
+    }
+    return bench::elapsedMs(begin);
+}
+
+double runChain(ThreadPool& pool, int length, int runs)
+{
+    auto begin = bench::Clock::now();
+    for(int r=0;r<runs;r++)
+    {
+        Future<void> f = pool.submit(work);
+        for(int i=1;i<length;i++)
+        {
+            f = f.then(pool, work);
+        }
+        f.get();
+    }
+    return bench::elapsedMs(begin);
+}
+
+void shape(const char* name, const std::vector<int>& layers, int runs, ThreadPool& pool, bool chain)
+{
+    int nodes = 0;
+    for(int width : layers)
+        nodes += width;
+    report(name, "graph", nodes, runs, runGraph(pool, layers, runs));
+    if(chain)
+        report(name, "then", nodes, runs, runChain(pool, nodes, runs));
+    report(name, "blocking", nodes, runs, runBlocking(pool, layers, runs));
+}
+
+void taskGraph()
+{
+    ThreadPool pool;
+    pool.start(4);
+    shape("wide", {1, 1000, 1}, 50, pool, false);
+    shape("deep", std::vector<int>(1000, 1), 50, pool, true);
+    shape("layered", std::vector<int>(32, 32), 50, pool, false);
+}
+} // namespace
+
+BENCH_REGISTER("taskgraph", taskGraph);
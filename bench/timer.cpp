@@ -0,0 +1,104 @@
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 定时任务：插入/取消的耗时(大量远期定时器)、同时到期的一批定时器从到期到执行完的吞吐、实际执行时间比计划晚多少(抖动)
+namespace
+{
+void insertCancel(int timers)
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> delayMs(1000, 60000);
+    std::vector<TimerFuture<void>> futures;
+    futures.reserve(timers);
+    auto begin = bench::Clock::now();
+    for(int i=0;i<timers;i++)
+    {
+        futures.push_back(pool.submitAfter(std::chrono::milliseconds(delayMs(rng)), []() {}));
+    }
+    double insertMs = bench::elapsedMs(begin);
+    begin = bench::Clock::now();
+    for(auto& future : futures)
+    {
+        future.cancel();
+    }
+    double cancelMs = bench::elapsedMs(begin);
+    bench::Row("timer").add("case", "insert_cancel").add("timers", timers)
+        .add("insert_ns", insertMs * 1e6 / timers).add("cancel_ns", cancelMs * 1e6 / timers)
+        .emit();
+}
+
+void fire(int timers, int resolutionUs)
+{
+    ThreadPool pool;
+    pool.setTimerResolution(resolutionUs);
+    pool.setTaskQueMaxThreshHold(timers);
+    pool.start(2);
+    std::atomic_int done(0);
+    std::vector<double> lateUs(timers);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> delayUs(1000, 50000);
+    uint64_t lastDue = 0;
+    for(int i=0;i<timers;i++)
+    {
+        uint64_t due = steadyNowNs() + (uint64_t)delayUs(rng) * 1000;
+        lastDue = std::max(lastDue, due);
+        pool.submitAt(Deadline(std::chrono::nanoseconds(due)), [due, i, &lateUs, &done]()
+        {
+            lateUs[i] = (steadyNowNs() - due) / 1000.0;
+            done++;
+        });
+    }
+    while(done < timers)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double drainMs = (steadyNowNs() - lastDue) / 1e6;// 最后一个到期以后多久全部执行完
+    bench::Row("timer").add("case", "fire").add("timers", timers).add("resolution_us", resolutionUs)
+        .add("drain_after_last_ms", drainMs)
+        .add("late_p50_us", bench::percentile(lateUs, 50)).add("late_p99_us", bench::percentile(lateUs, 99))
+        .add("late_max_us", bench::percentile(lateUs, 100))
+        .emit();
+}
+
+// 所有定时器同一时刻到期：从到期到全部执行完的吞吐
+void burst(int timers)
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(timers);
+    pool.start(2);
+    std::atomic_int done(0);
+    uint64_t due = steadyNowNs() + 200 * 1000000ull;
+    for(int i=0;i<timers;i++)
+    {
+        pool.submitAt(Deadline(std::chrono::nanoseconds(due)), [&done]() { done++; });
+    }
+    while(done < timers)
+    {
+        std::this_thread::yield();
+    }
+    double ms = (steadyNowNs() - due) / 1e6;
+    bench::Row("timer").add("case", "burst").add("timers", timers).add("ms", ms)
+        .add("fired_per_sec", timers / (ms / 1000))
+        .emit();
+}
+
+void timer()
+{
+    insertCancel(100000);
+    burst(100000);
+    for(int resolutionUs : {1000, 100})
+    {
+        fire(2000, resolutionUs);
+        fire(100000, resolutionUs);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("timer", timer);
@@ -0,0 +1,85 @@
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "threadpool.h"
+#include "bench/bench.h"
+
+// 每个任务要用一块1MB的临时缓冲区
+// per_task    任务里自己分配(std::vector，清零)，执行完释放
+// per_worker  setWorkerContext给每个线程一块，任务用ThreadPool::workerContext取，线程退出时才释放
+// 任务本身只写缓冲区的前TOUCH_BYTES字节再读一遍，差距就是反复分配、清零、缺页的开销
+namespace
+{
+const size_t SCRATCH_BYTES = 1 << 20;
+const size_t TOUCH_BYTES = 16 << 10;
+
+struct Scratch
+{
+    std::vector<char> buffer_ = std::vector<char>(SCRATCH_BYTES);
+};
+
+long useScratch(char* buffer, int seed)
+{
+    std::memset(buffer, seed, TOUCH_BYTES);
+    long sum = 0;
+    for(size_t i=0;i<TOUCH_BYTES;i+=64)
+    {
+        sum += buffer[i];
+    }
+    return sum;
+}
+
+void run(const char* name, bool perWorker, int threads, int tasks)
+{
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_STEALING);
+    if(perWorker)
+    {
+        pool.setWorkerContext<Scratch>();
+    }
+    pool.start(threads);
+
+    std::vector<Future<long>> futures;
+    futures.reserve(tasks);
+    auto begin = bench::Clock::now();
+    for(int i=0;i<tasks;i++)
+    {
+        if(perWorker)
+        {
+            futures.push_back(pool.submit([i]()
+            {
+                return useScratch(ThreadPool::workerContext<Scratch>()->buffer_.data(), i);
+            }));
+        }
+        else
+        {
+            futures.push_back(pool.submit([i]()
+            {
+                std::vector<char> buffer(SCRATCH_BYTES);
+                return useScratch(buffer.data(), i);
+            }));
+        }
+    }
+    long sum = 0;
+    for(auto& future : futures)
+    {
+        sum += future.get();
+    }
+    double ms = bench::elapsedMs(begin);
+    bench::Row("workerlocal").add("case", name).add("threads", threads)
+        .add("ns_per_task", ms * 1e6 / tasks).add("tasks_per_sec", tasks / (ms / 1000))
+        .add("checksum", (double)sum).emit();
+}
+
+void workerlocal()
+{
+    for(int threads : bench::threadSweep())
+    {
+        run("per_task", false, threads, 20000);
+        run("per_worker", true, threads, 20000);
+    }
+}
+} // namespace
+
+BENCH_REGISTER("workerlocal", workerlocal);
@@ -0,0 +1,157 @@
+#ifndef CALLABLE_H
+#define CALLABLE_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 任务队列里每个任务内部缓冲区的大小，可以用 -DTHREADPOOL_TASK_INLINE_SIZE=xx 调整
+// 默认48字节：加上函数表指针和入队时间，队列里一个任务正好占一个缓存行(64字节)
+#ifndef THREADPOOL_TASK_INLINE_SIZE
+#define THREADPOOL_TASK_INLINE_SIZE 48
+#endif
+const size_t TASK_INLINE_SIZE = THREADPOOL_TASK_INLINE_SIZE;
+
+template<typename Signature, size_t Size = TASK_INLINE_SIZE>
+class InlineFunction;
+
+// 只能移动的类型擦除可调用对象，作用同std::function：
+// 不超过Size字节、可以无异常移动的可调用对象直接放在内部缓冲区里，不碰堆；大的才new一个放在堆上
+template<typename R, typename... Args, size_t Size>
+class InlineFunction<R(Args...), Size>
+{
+public:
+    InlineFunction() noexcept
+        : ops_(nullptr)
+    {}
+
+    template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineFunction>::value>>
+    InlineFunction(F&& func)
+        : ops_(nullptr)
+    {
+        using T = std::decay_t<F>;
+        if constexpr(fitsInline<T>())
+        {
+            new (buffer_) T(std::forward<F>(func));
+            ops_ = &InlineOps<T>::ops;
+        }
+        else
+        {
+            *reinterpret_cast<T**>(buffer_) = new T(std::forward<F>(func));
+            ops_ = &HeapOps<T>::ops;
+        }
+    }
+
+    InlineFunction(InlineFunction&& other) noexcept
+        : ops_(other.ops_)
+    {
+        if(ops_ != nullptr)
+        {
+            ops_->move(buffer_, other.buffer_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineFunction& operator=(InlineFunction&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            ops_ = other.ops_;
+            if(ops_ != nullptr)
+            {
+                ops_->move(buffer_, other.buffer_);
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction&)=delete;
+    InlineFunction& operator=(const InlineFunction&)=delete;
+
+    ~InlineFunction()
+    {
+        reset();
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    R operator()(Args... args)
+    {
+        return ops_->invoke(buffer_, std::forward<Args>(args)...);
+    }
+
+    // 可调用对象是不是放在内部缓冲区里(没有堆分配)
+    bool isInline() const { return ops_ != nullptr && ops_->inline_; }
+    // 放在堆上的可调用对象的大小，放在内部缓冲区里的为0
+    size_t heapBytes() const { return ops_ == nullptr ? 0 : ops_->heapBytes_; }
+
+    template<typename F>
+    static constexpr bool fitsInline()
+    {
+        return sizeof(F) <= Size && alignof(F) <= alignof(void*) && std::is_nothrow_move_constructible<F>::value;
+    }
+private:
+    // 每种可调用对象一张函数表，对象里只存一个指针
+    struct Ops
+    {
+        R (*invoke)(void* buffer, Args&&... args);
+        void (*move)(void* dst, void* src); // 移动到dst并析构src
+        void (*destroy)(void* buffer);
+        bool inline_;
+        size_t heapBytes_;
+    };
+
+    template<typename T>
+    struct InlineOps
+    {
+        static R invoke(void* buffer, Args&&... args)
+        {
+            return (*static_cast<T*>(buffer))(std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src)
+        {
+            new (dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        }
+        static void destroy(void* buffer)
+        {
+            static_cast<T*>(buffer)->~T();
+        }
+        static constexpr Ops ops = {&invoke, &move, &destroy, true, 0};
+    };
+
+    template<typename T>
+    struct HeapOps
+    {
+        static R invoke(void* buffer, Args&&... args)
+        {
+            return (**static_cast<T**>(buffer))(std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src)
+        {
+            *static_cast<T**>(dst) = *static_cast<T**>(src);
+        }
+        static void destroy(void* buffer)
+        {
+            delete *static_cast<T**>(buffer);
+        }
+        static constexpr Ops ops = {&invoke, &move, &destroy, false, sizeof(T)};
+    };
+
+    void reset()
+    {
+        if(ops_ != nullptr)
+        {
+            ops_->destroy(buffer_);
+            ops_ = nullptr;
+        }
+    }
+
+    const Ops* ops_;
+    alignas(void*) unsigned char buffer_[Size < sizeof(void*) ? sizeof(void*) : Size];
+};
+
+#endif //CALLABLE_H
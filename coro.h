@@ -0,0 +1,130 @@
+#ifndef CORO_H
+#define CORO_H
+
+// C++20协程支持，需要打开THREADPOOL_COROUTINES(cmake -DTHREADPOOL_COROUTINES=ON，会切到C++20)
+#ifdef THREADPOOL_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+
+#include "threadpool.h"
+
+/*
+example:
+Async<int> pipeline(ThreadPool& pool, int x)
+{
+    co_await pool.schedule();                          // 切到线程池的线程上
+    int a = co_await pool.submit([x]{ return x * 2; }); // 等结果时协程挂起，不占线程
+    int b = co_await pool.submit([a]{ return a + 1; });
+    co_return b;
+}
+int v = pipeline(pool, 1).get();   // 协程外阻塞取结果，协程里用 co_await pipeline(pool, 1)
+*/
+
+// 协程的结果，和submit返回的Future用同一套完成/等待机制，协程正常结束或抛异常时完成
+template<typename T>
+class AsyncState : public FutureState<T>
+{
+public:
+    template<typename U>
+    void setValue(U&& value)
+    {
+        auto func = [&]() -> T { return std::forward<U>(value); };
+        // 协程结束时可能是在别的协程的恢复过程中，后面还会执行用户代码，后续任务不能交给当前线程接着执行
+        this->invoke(func, false);
+    }
+    void setException(std::exception_ptr error)
+    {
+        this->setError(error);
+        this->complete(false);
+    }
+};
+
+template<>
+class AsyncState<void> : public FutureState<void>
+{
+public:
+    void setValue()
+    {
+        auto func = []() {};
+        this->invoke(func, false);
+    }
+    void setException(std::exception_ptr error)
+    {
+        this->setError(error);
+        this->complete(false);
+    }
+};
+
+template<typename T> class Async;
+
+namespace detail
+{
+// 协程帧和结果分开：协程一结束帧就自己销毁了，结果由AsyncState保存，Async随便拷贝和丢弃
+template<typename T>
+struct AsyncPromiseBase
+{
+    std::shared_ptr<AsyncState<T>> state_ = std::make_shared<AsyncState<T>>();
+
+    std::suspend_never initial_suspend() noexcept { return {}; }// 创建后马上开始执行
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception() { state_->setException(std::current_exception()); }
+};
+
+template<typename T>
+struct AsyncPromise : AsyncPromiseBase<T>
+{
+    Async<T> get_return_object();
+    template<typename U>
+    void return_value(U&& value) { this->state_->setValue(std::forward<U>(value)); }
+};
+
+template<>
+struct AsyncPromise<void> : AsyncPromiseBase<void>
+{
+    Async<void> get_return_object();
+    void return_void() { state_->setValue(); }
+};
+} // namespace detail
+
+// 协程的返回类型：协程创建后立即执行，co_await Async 在别的协程里等它的结果，get()在协程外阻塞等待
+template<typename T>
+class Async
+{
+public:
+    using promise_type = detail::AsyncPromise<T>;
+
+    Async(std::shared_ptr<AsyncState<T>> state)
+        : future_(std::move(state))
+    {}
+
+    bool ready() const { return future_.ready(); }
+    void wait() const { future_.wait(); }
+    T get() { return future_.get(); }
+    // 转成Future，可以接着then
+    Future<T> future() const { return future_; }
+
+    auto operator co_await() const { return future_.operator co_await(); }
+private:
+    Future<T> future_;
+};
+
+namespace detail
+{
+template<typename T>
+Async<T> AsyncPromise<T>::get_return_object()
+{
+    return Async<T>(this->state_);
+}
+
+inline Async<void> AsyncPromise<void>::get_return_object()
+{
+    return Async<void>(state_);
+}
+} // namespace detail
+
+#endif // THREADPOOL_COROUTINES
+
+#endif //CORO_H
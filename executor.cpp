@@ -0,0 +1,242 @@
+#include "executor.h"
+
+#include <algorithm>
+
+const int EXECUTOR_DRAIN_BATCH = 32;// 取任务的小任务每次最多执行多少个任务就把线程还给线程池
+
+// 放进线程池队列的取任务的小任务；没执行就被析构(线程池放不下、shutdown丢掉)时把名额还给ExecutorGroup
+class ExecutorGroup::Drainer
+{
+public:
+    explicit Drainer(ExecutorGroup* group)
+        : group_(group)
+    {}
+    Drainer(Drainer&& other) noexcept
+        : group_(other.group_)
+    {
+        other.group_ = nullptr;
+    }
+    Drainer& operator=(Drainer&&)=delete;
+    ~Drainer()
+    {
+        if(group_ != nullptr)
+            group_->drainerLost();
+    }
+    void operator()()
+    {
+        ExecutorGroup* group = group_;
+        group_ = nullptr;
+        group->drain();
+    }
+private:
+    ExecutorGroup* group_;
+};
+
+/////////////  ExecutorGroup方法的实现
+ExecutorGroup::ExecutorGroup(ThreadPool& pool, int concurrency, int quantumUs)
+    : pool_(pool)
+    , concurrency_(std::max(concurrency, 0))
+    , quantumNs_((int64_t)std::max(quantumUs, 1) * 1000)
+    , queued_(0)
+    , drainers_(0)
+{
+}
+
+ExecutorGroup::~ExecutorGroup()
+{
+    wait();
+}
+
+int ExecutorGroup::addTenant(std::string name, int weight, size_t capacity)
+{
+    auto tenant = std::make_unique<Tenant>();
+    tenant->name_ = std::move(name);
+    tenant->weight_ = std::max(weight, 1);
+    tenant->capacity_ = std::max(capacity, (size_t)1);
+    std::lock_guard<std::mutex> lock(mtx_);
+    tenants_.emplace_back(std::move(tenant));
+    return (int)tenants_.size() - 1;
+}
+
+size_t ExecutorGroup::tenantCount() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return tenants_.size();
+}
+
+bool ExecutorGroup::enqueue(int tenant, TaskItem task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Tenant& t = *tenants_.at(tenant);
+        if(t.que_.size() >= t.capacity_)
+        {
+            t.rejected_++;
+            return false;
+        }
+        task.enqueueNs_ = steadyNowNs();
+        t.que_.pushBack(std::move(task));
+        t.submitted_++;
+        queued_++;
+        if(!t.active_)
+        {
+            t.active_ = true;
+            active_.pushBack(tenant);
+        }
+        // 取任务的小任务够多了，它们会接着取这个任务
+        int limit = concurrency_ > 0 ? concurrency_ : std::max(pool_.getThreadSize(), 1);
+        if(drainers_ >= limit)
+            return true;
+        drainers_++;
+    }
+    startDrainer();// 线程池满了可能要等，放在锁外面
+    return true;
+}
+
+void ExecutorGroup::startDrainer()
+{
+    pool_.post(Drainer(this));// 放不进去时Drainer析构，名额在drainerLost里还回去
+}
+
+void ExecutorGroup::drainerLost()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    drainers_--;
+    idleCond_.notify_all();// 排队的任务可能没人取了，wait要自己来执行
+}
+
+void ExecutorGroup::drain()
+{
+    for(;;)
+    {
+        for(int i=0;i<EXECUTOR_DRAIN_BATCH;i++)
+        {
+            TaskItem task;
+            Tenant* tenant = nullptr;
+            int64_t charged = 0;
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if(!pick(task, tenant, charged))
+                {
+                    drainers_--;
+                    idleCond_.notify_all();
+                    return;
+                }
+            }
+
+            uint64_t begin = steadyNowNs();
+            task.func_();
+            int64_t ns = (int64_t)(steadyNowNs() - begin);
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            tenant->deficit_ -= ns - charged;// 取任务时按估计值扣过了，这里补差
+            tenant->costNs_ += (ns - tenant->costNs_) / 8;
+            tenant->busyNs_ += ns;
+            tenant->completed_++;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(queued_ == 0)
+            {
+                drainers_--;
+                idleCond_.notify_all();
+                return;
+            }
+        }
+        // 跑满一批了，重新排到线程池队列后面，让线程池里别的任务也有机会执行
+        // 用tryPost：post在OVERFLOW_CALLER_RUNS下会在这里递归执行drain，OVERFLOW_BLOCK下会占着线程等空位
+        if(pool_.tryPost(Drainer(this)))
+            return;
+        // 线程池队列满了，接着在这个线程上取；放不进去的Drainer析构时还回去的名额重新占上
+        std::lock_guard<std::mutex> lock(mtx_);
+        drainers_++;
+    }
+}
+
+bool ExecutorGroup::pick(TaskItem& task, Tenant*& tenant, int64_t& charged)
+{
+    while(!active_.empty())
+    {
+        Tenant& t = *tenants_[active_.front()];
+        if(!t.turn_)// 刚轮到它，给这一轮的额度
+        {
+            t.deficit_ += t.weight_ * quantumNs_;
+            t.turn_ = true;
+        }
+        if(t.deficit_ <= 0)
+        {
+            // 额度用完了(或者还在还上几轮欠的)，排到最后，下次轮到时再给额度
+            t.turn_ = false;
+            active_.pushBack(active_.popFront());
+            continue;
+        }
+
+        task = t.que_.popFront();
+        queued_--;
+        t.waitHist_.record(steadyNowNs() - task.enqueueNs_);
+        // 先按估计的执行时间扣，多个线程同时取同一个租户的任务时也不会超出额度太多
+        charged = t.costNs_;
+        t.deficit_ -= charged;
+        if(t.que_.empty())
+        {
+            // 没有排队的任务了，退出轮转；欠的额度留着，一个一个零散提交的长任务也会被限住
+            active_.popFront();
+            t.active_ = false;
+            t.turn_ = false;
+            t.deficit_ = std::min<int64_t>(t.deficit_, 0);
+        }
+        tenant = &t;
+        return true;
+    }
+    return false;
+}
+
+void ExecutorGroup::wait()
+{
+    std::unique_lock<std::mutex> lock(mtx_);
+    while(queued_ > 0 || drainers_ > 0)
+    {
+        if(drainers_ == 0)
+        {
+            // 有任务但是没有取任务的小任务在线程池里了，在当前线程执行
+            drainers_++;
+            lock.unlock();
+            drain();
+            lock.lock();
+            continue;
+        }
+        idleCond_.wait(lock);
+    }
+}
+
+TenantStats ExecutorGroup::snapshot(const Tenant& tenant) const
+{
+    TenantStats st;
+    st.name = tenant.name_;
+    st.weight = tenant.weight_;
+    st.submitted = tenant.submitted_;
+    st.rejected = tenant.rejected_;
+    st.completed = tenant.completed_;
+    st.queueDepth = tenant.que_.size();
+    st.busyNs = tenant.busyNs_;
+    st.waitHist = tenant.waitHist_;
+    return st;
+}
+
+TenantStats ExecutorGroup::stats(int tenant) const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return snapshot(*tenants_.at(tenant));
+}
+
+std::vector<TenantStats> ExecutorGroup::stats() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<TenantStats> all;
+    for(auto& tenant : tenants_)
+    {
+        all.push_back(snapshot(*tenant));
+    }
+    return all;
+}
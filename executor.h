@@ -0,0 +1,126 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+
+/*
+example:
+ThreadPool pool;
+pool.start(8);
+ExecutorGroup group(pool);
+int rpc = group.addTenant("rpc", 4);        // 忙的时候rpc分到的执行时间是log的4倍
+int log = group.addTenant("log", 1, 256);   // log最多排256个任务
+group.post(log, []{ ... });
+Future<int> res = group.submit(rpc, [](int a){ return a * 2; }, 21);
+*/
+
+// 单个租户的统计快照
+struct TenantStats
+{
+    std::string name;
+    int weight = 0;
+    uint64_t submitted = 0;
+    uint64_t rejected = 0; // 超过这个租户的容量，没放进去
+    uint64_t completed = 0;
+    size_t queueDepth = 0;
+    uint64_t busyNs = 0; // 这个租户的任务执行的总时间
+    Histogram waitHist; // 从提交到开始执行的时间
+};
+
+// 多个租户共用一个线程池的线程：每个租户有自己的队列、权重、容量和统计，互不挤占队列
+// 租户之间按赤字轮转(DRR)调度：轮到一个租户时给它 权重*quantum 纳秒的额度，按任务实际执行时间扣，扣完换下一个
+// 线程池队列里最多只有concurrency个取任务的小任务，线程执行它时才决定跑哪个租户的任务，
+// 每次最多跑EXECUTOR_DRAIN_BATCH个就把线程还给线程池，别的提交方的任务不会被一直挡着
+class ExecutorGroup
+{
+public:
+    // concurrency：最多同时占用线程池几个线程，0表示和线程池当前线程数一样；quantumUs：每轮的基本额度
+    explicit ExecutorGroup(ThreadPool& pool, int concurrency = 0, int quantumUs = 100);
+    // 等所有租户排队的任务执行完，线程池要比它活得久
+    ~ExecutorGroup();
+    ExecutorGroup(const ExecutorGroup&)=delete;
+    ExecutorGroup& operator=(const ExecutorGroup&)=delete;
+
+    // 加一个租户，返回租户编号；weight越大分到的执行时间越多，capacity是这个租户排队任务的上限
+    int addTenant(std::string name, int weight = 1, size_t capacity = 1024);
+    size_t tenantCount() const;
+
+    // 提交一个不需要返回值的可调用对象，租户队列满了返回false；func不能抛异常
+    template<typename Func>
+    bool post(int tenant, Func&& func)
+    {
+        return enqueue(tenant, TaskItem(TaskFunc(std::forward<Func>(func))));
+    }
+    // 同ThreadPool::submit，租户队列满了Future::get抛出std::runtime_error
+    template<typename Func, typename... Args>
+    auto submit(int tenant, Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        using R = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+        auto call = [func = std::forward<Func>(func),
+                     params = std::make_tuple(std::forward<Args>(args)...)]() mutable -> R
+        {
+            return std::apply(func, std::move(params));
+        };
+        auto task = pool_.makeTask<FutureTask<R, decltype(call)>>(std::move(call));
+        if(!enqueue(tenant, TaskItem(TaskFunc([task]() { task->exec(); }))))
+        {
+            task->reject(std::make_exception_ptr(std::runtime_error("tenant queue is full, submit task fail.")));
+        }
+        return Future<R>(task);
+    }
+
+    // 等所有租户排队的任务执行完；线程池放不下取任务的小任务(或者shutdown丢掉了)时，剩下的在当前线程执行
+    // 不能在租户的任务里调用
+    void wait();
+
+    TenantStats stats(int tenant) const;
+    std::vector<TenantStats> stats() const;
+private:
+    struct Tenant
+    {
+        std::string name_;
+        int weight_;
+        size_t capacity_;
+        CircularDeque<TaskItem> que_;
+        bool active_ = false; // 在轮转列表里(有排队的任务)
+        bool turn_ = false; // 这一轮的额度已经给过了
+        int64_t deficit_ = 0; // 剩下的额度，可能是负的(执行时间超过了额度)
+        int64_t costNs_ = 1000; // 单个任务执行时间的平滑值，取任务时先按它扣额度，执行完再按实际时间补差
+        uint64_t submitted_ = 0;
+        uint64_t rejected_ = 0;
+        uint64_t completed_ = 0;
+        uint64_t busyNs_ = 0;
+        Histogram waitHist_;
+    };
+    class Drainer;
+
+    bool enqueue(int tenant, TaskItem task);
+    // 往线程池放一个取任务的小任务，放不进去就把名额还回去
+    void startDrainer();
+    // 在线程池线程上执行：按DRR取任务执行，最多EXECUTOR_DRAIN_BATCH个
+    void drain();
+    // 取任务的小任务没执行就被丢掉了
+    void drainerLost();
+    // 按DRR选下一个任务，调用方持有mtx_
+    bool pick(TaskItem& task, Tenant*& tenant, int64_t& charged);
+    TenantStats snapshot(const Tenant& tenant) const;
+
+    ThreadPool& pool_;
+    int concurrency_;
+    int64_t quantumNs_;
+    mutable std::mutex mtx_; // 保护下面所有成员和租户
+    std::condition_variable idleCond_; // 排队任务和取任务的小任务都没有了
+    std::vector<std::unique_ptr<Tenant>> tenants_;
+    CircularDeque<int> active_; // 有排队任务的租户，按轮转顺序
+    size_t queued_; // 所有租户排队的任务数
+    int drainers_; // 已经放进线程池或者正在执行的取任务的小任务数
+};
+
+#endif //EXECUTOR_H
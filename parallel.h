@@ -0,0 +1,273 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <optional>
+#include <iterator>
+#include <functional>
+#include <utility>
+#include <algorithm>
+
+#include "threadpool.h"
+
+/*
+ 建立在ThreadPool之上的并行算法，省掉test.cpp里手工切区间、提交MyTask、再逐个get合并的样板代码
+ 区间按需对半拆分，拆出来的右半边放进这次调用自己的待处理队列，池里的帮手线程和调用线程一起来领，
+ 谁做得快谁多领，任务耗时不均也能平衡；调用线程不会干等，领不到区间时才睡眠
+
+example:
+ ThreadPool pool;
+ pool.start(4);
+ std::vector<uLong> v(...);
+ uLong sum = parallelReduce(pool, v.begin(), v.end(), 0ULL);
+ parallelFor(pool, 0, 1000, [&](int i){ ... });
+*/
+
+namespace detail
+{
+// 一次并行调用的共享状态，body(begin, end)处理[begin, end)这一段偏移
+template<typename Body>
+class ParallelState : public std::enable_shared_from_this<ParallelState<Body>>
+{
+public:
+    ParallelState(ThreadPool& pool, Body& body, size_t total, size_t grain, int maxHelpers)
+        : pool_(pool)
+        , body_(body)
+        , total_(total)
+        , grain_(grain)
+        , maxHelpers_(maxHelpers)
+        , helpers_(0)
+        , done_(0)
+    {}
+
+    // 处理一段区间：比粒度大就一直对半拆，右半边留给别人领，自己做左半边
+    void run(size_t begin, size_t end)
+    {
+        while(end - begin > grain_)
+        {
+            size_t mid = begin + (end - begin) / 2;
+            share(mid, end);
+            end = mid;
+        }
+        try
+        {
+            body_(begin, end);
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(!error_)
+                error_ = std::current_exception();
+        }
+        finish(end - begin);
+    }
+
+    // 调用线程：领不到区间才睡，直到全部做完，body抛的第一个异常在这里重新抛出
+    void runAndWait()
+    {
+        run(0, total_);
+        for(;;)
+        {
+            if(claim())
+                continue;
+            std::unique_lock<std::mutex> lock(mtx_);
+            cond_.wait(lock,[&]()->bool{return done_ == total_ || !pending_.empty();});
+            if(done_ == total_)
+                break;
+        }
+        if(error_)
+            std::rethrow_exception(error_);
+    }
+private:
+    // 领一段待处理区间来做，没有了返回false
+    bool claim()
+    {
+        std::pair<size_t, size_t> range;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if(pending_.empty())
+                return false;
+            range = pending_.front();// 最早拆出来的那段最大，拿走它再接着拆
+            pending_.pop_front();
+        }
+        run(range.first, range.second);
+        return true;
+    }
+
+    void share(size_t begin, size_t end)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            pending_.emplace_back(begin, end);
+            cond_.notify_all();// 调用线程可能在等
+        }
+        // 帮手不够就往池里再派一个，帮手做完手上的会接着领，领不到就退出
+        if(helpers_ < maxHelpers_)
+        {
+            helpers_++;
+            auto self = this->shared_from_this();
+            pool_.submit([self]()
+            {
+                while(self->claim());
+                self->helpers_--;
+            });
+        }
+    }
+
+    void finish(size_t size)
+    {
+        if(done_.fetch_add(size) + size == total_)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            cond_.notify_all();
+        }
+    }
+
+    ThreadPool& pool_;
+    Body& body_;// 只在领到区间时使用，调用线程要等全部完成才返回，所以引用一直有效
+    size_t total_;
+    size_t grain_;
+    int maxHelpers_;
+    std::atomic_int helpers_;
+    std::atomic<size_t> done_;
+    std::mutex mtx_;
+    std::condition_variable cond_;
+    std::deque<std::pair<size_t, size_t>> pending_;
+    std::exception_ptr error_;
+};
+
+// 自动粒度：按参与的线程数(池线程+调用线程)切成每人约8段，既能平衡负载又不会切得太碎
+inline size_t autoGrain(ThreadPool& pool, size_t total)
+{
+    size_t workers = pool.getThreadSize() + 1;
+    size_t grain = total / (workers * 8);
+    return grain > 0 ? grain : 1;
+}
+
+// 把[0, total)交给body并行处理，grain为0时自动决定粒度
+template<typename Body>
+void parallelRun(ThreadPool& pool, size_t total, size_t grain, Body body)
+{
+    if(total == 0)
+        return;
+    if(grain == 0)
+        grain = autoGrain(pool, total);
+    auto state = std::make_shared<ParallelState<Body>>(pool, body, total, grain, pool.getThreadSize());
+    state->runAndWait();
+}
+} // namespace detail
+
+// 对[first, last)里的每个下标/迭代器调用func，Index可以是整数也可以是随机访问迭代器
+template<typename Index, typename Func>
+void parallelFor(ThreadPool& pool, Index first, Index last, Func func, size_t grain = 0)
+{
+    if(!(first < last))
+        return;
+    using Diff = decltype(last - first);
+    detail::parallelRun(pool, static_cast<size_t>(last - first), grain, [&](size_t begin, size_t end)
+    {
+        for(size_t i=begin;i<end;i++)
+        {
+            func(first + static_cast<Diff>(i));
+        }
+    });
+}
+
+// 先对每个元素做transform，再用reduce合并，用法同std::transform_reduce，reduce需要满足结合律和交换律
+template<typename Iter, typename T, typename Reduce, typename Transform>
+T parallelTransformReduce(ThreadPool& pool, Iter first, Iter last, T init, Reduce reduce, Transform transform, size_t grain = 0)
+{
+    using Diff = typename std::iterator_traits<Iter>::difference_type;
+    std::mutex mtx;
+    T result = std::move(init);
+    detail::parallelRun(pool, static_cast<size_t>(std::distance(first, last)), grain, [&](size_t begin, size_t end)
+    {
+        // 每段先在本地合并，最后才加锁合并到结果上
+        Iter it = first + static_cast<Diff>(begin);
+        T partial = transform(*it);
+        for(size_t i=begin+1;i<end;i++)
+        {
+            ++it;
+            partial = reduce(std::move(partial), transform(*it));
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        result = reduce(std::move(result), std::move(partial));
+    });
+    return result;
+}
+
+// 用法同std::reduce
+template<typename Iter, typename T, typename Reduce = std::plus<>>
+T parallelReduce(ThreadPool& pool, Iter first, Iter last, T init, Reduce reduce = Reduce(), size_t grain = 0)
+{
+    using Value = typename std::iterator_traits<Iter>::value_type;
+    return parallelTransformReduce(pool, first, last, std::move(init), reduce,
+                                   [](const Value& value)->const Value& { return value; }, grain);
+}
+
+// 用法同std::inclusive_scan，结果写到out开始的位置，返回写完的末尾
+// 两遍：先并行求各块的和，串行求块和的前缀，再并行在各块内带着前缀做扫描
+template<typename Iter, typename OutIter, typename Op = std::plus<>>
+OutIter parallelInclusiveScan(ThreadPool& pool, Iter first, Iter last, OutIter out, Op op = Op(), size_t grain = 0)
+{
+    using Value = typename std::iterator_traits<Iter>::value_type;
+    using Diff = typename std::iterator_traits<Iter>::difference_type;
+    using OutDiff = typename std::iterator_traits<OutIter>::difference_type;
+    size_t total = static_cast<size_t>(std::distance(first, last));
+    if(total == 0)
+        return out;
+    size_t blockSize = grain > 0 ? grain : detail::autoGrain(pool, total);
+    size_t blocks = (total + blockSize - 1) / blockSize;
+    std::vector<std::optional<Value>> sums(blocks);
+
+    detail::parallelRun(pool, blocks, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t b=begin;b<end;b++)
+        {
+            size_t i = b * blockSize;
+            size_t stop = std::min(i + blockSize, total);
+            Iter it = first + static_cast<Diff>(i);
+            Value sum = *it;
+            for(i++;i<stop;i++)
+            {
+                ++it;
+                sum = op(std::move(sum), *it);
+            }
+            sums[b].emplace(std::move(sum));
+        }
+    });
+    for(size_t b=1;b<blocks;b++)
+    {
+        sums[b].emplace(op(*sums[b-1], *sums[b]));
+    }
+    detail::parallelRun(pool, blocks, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t b=begin;b<end;b++)
+        {
+            size_t i = b * blockSize;
+            size_t stop = std::min(i + blockSize, total);
+            Iter it = first + static_cast<Diff>(i);
+            OutIter dst = out + static_cast<OutDiff>(i);
+            std::optional<Value> acc;
+            if(b > 0)
+                acc.emplace(*sums[b-1]);
+            for(;i<stop;i++, ++it, ++dst)
+            {
+                if(acc)
+                    acc.emplace(op(std::move(*acc), *it));
+                else
+                    acc.emplace(*it);
+                *dst = *acc;
+            }
+        }
+    });
+    return out + static_cast<OutDiff>(total);
+}
+
+#endif //PARALLEL_H
@@ -0,0 +1,257 @@
+#include "parking.h"
+
+#include <climits>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#else
+#include <condition_variable>
+#endif
+
+const int PARKING_BUCKETS = 256;// 等待表的分片数，按标志的地址散列，不同标志上的等待基本不会抢同一把锁
+
+namespace
+{
+// 一组一起等的等待方，在它自己的栈上
+struct Waiter
+{
+    bool any_ = false;
+    std::atomic<size_t> pending_{1}; // 还没设置的标志数，多的1在挂完所有标志后由等待方自己减掉
+    std::atomic<uint32_t> signal_{0}; // 被叫醒了
+#ifndef __linux__
+    std::mutex mtx_;
+    std::condition_variable cond_;
+#endif
+};
+
+// 等待表里的一项：等待方在某一个标志上的登记
+struct Entry
+{
+    const CompletionFlag* key_ = nullptr;
+    Waiter* waiter_ = nullptr;
+    Entry* prev_ = nullptr;
+    Entry* next_ = nullptr;
+    bool linked_ = false; // 还挂在表里，所在分片的锁保护
+};
+
+struct alignas(64) Bucket
+{
+    std::mutex mtx_;
+    Entry* head_ = nullptr;
+};
+
+Bucket& bucketOf(const void* key)
+{
+    static Bucket buckets[PARKING_BUCKETS];
+    uintptr_t addr = reinterpret_cast<uintptr_t>(key);
+    return buckets[((addr >> 4) ^ (addr >> 12)) % PARKING_BUCKETS];
+}
+
+void unlink(Bucket& bucket, Entry* entry)
+{
+    if(entry->prev_ != nullptr)
+        entry->prev_->next_ = entry->next_;
+    else
+        bucket.head_ = entry->next_;
+    if(entry->next_ != nullptr)
+        entry->next_->prev_ = entry->prev_;
+    entry->linked_ = false;
+}
+
+#ifdef __linux__
+// 在word上睡到它不等于expect，或者到deadline；返回false表示超时
+bool futexWait(const std::atomic<uint32_t>& word, uint32_t expect, CompletionFlag::Deadline deadline)
+{
+    uint32_t* addr = reinterpret_cast<uint32_t*>(const_cast<std::atomic<uint32_t>*>(&word));
+    if(deadline == CompletionFlag::Deadline::max())
+    {
+        syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expect, nullptr, nullptr, 0);
+        return true;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(now >= deadline)
+        return false;
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+    timespec timeout;
+    timeout.tv_sec = ns / 1000000000;
+    timeout.tv_nsec = ns % 1000000000;
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expect, &timeout, nullptr, 0);
+    return true;
+}
+
+void futexWake(const std::atomic<uint32_t>& word, int count)
+{
+    uint32_t* addr = reinterpret_cast<uint32_t*>(const_cast<std::atomic<uint32_t>*>(&word));
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+#endif
+
+// 在分片锁里调用，等待方要拿到同一把锁才能清理自己的登记，所以叫醒之后它不会先于这里退出
+void signal(Waiter* waiter)
+{
+#ifdef __linux__
+    waiter->signal_.store(1, std::memory_order_release);
+    futexWake(waiter->signal_, 1);
+#else
+    std::lock_guard<std::mutex> lock(waiter->mtx_);
+    waiter->signal_.store(1, std::memory_order_release);
+    waiter->cond_.notify_one();
+#endif
+}
+} // namespace
+
+/////////////  CompletionFlag方法的实现
+bool CompletionFlag::waitUntil(Deadline deadline) const
+{
+#ifdef __linux__
+    // 打上WAITING再睡，set()看到它才会去唤醒；futex在内核里会再比较一次，中间set()了就不会睡死
+    uint32_t state = state_.load(std::memory_order_acquire);
+    while(!(state & SET))
+    {
+        if(!(state & WAITING))
+        {
+            if(!state_.compare_exchange_weak(state, state | WAITING, std::memory_order_acquire))
+                continue;
+            state |= WAITING;
+        }
+        if(!futexWait(state_, state, deadline))
+            return false;
+        state = state_.load(std::memory_order_acquire);
+    }
+    return true;
+#else
+    const CompletionFlag* self = this;
+    return waitAll(&self, 1, deadline);
+#endif
+}
+
+void CompletionFlag::wake(uint32_t old)
+{
+#ifdef __linux__
+    if(old & WAITING)
+        futexWake(state_, INT_MAX);
+#endif
+    if(!(old & PARKED))
+        return;
+    Bucket& bucket = bucketOf(this);
+    std::lock_guard<std::mutex> lock(bucket.mtx_);
+    for(Entry* entry = bucket.head_; entry != nullptr;)
+    {
+        Entry* next = entry->next_;
+        if(entry->key_ == this)
+        {
+            unlink(bucket, entry);
+            Waiter* waiter = entry->waiter_;
+            if(waiter->any_ || waiter->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                signal(waiter);
+        }
+        entry = next;
+    }
+}
+
+bool CompletionFlag::waitAll(const CompletionFlag* const* flags, size_t size, Deadline deadline)
+{
+    auto allSet = [&]()->bool
+    {
+        for(size_t i=0;i<size;i++)
+        {
+            if(flags[i] != nullptr && !flags[i]->isSet())
+                return false;
+        }
+        return true;
+    };
+    if(allSet())
+        return true;
+    park(flags, size, false, deadline);
+    return allSet();
+}
+
+size_t CompletionFlag::waitAny(const CompletionFlag* const* flags, size_t size, Deadline deadline)
+{
+    auto firstSet = [&]()->size_t
+    {
+        for(size_t i=0;i<size;i++)
+        {
+            if(flags[i] == nullptr || flags[i]->isSet())
+                return i;
+        }
+        return size;
+    };
+    size_t index = firstSet();
+    if(index < size || size == 0)
+        return index;
+    park(flags, size, true, deadline);
+    return firstSet();
+}
+
+void CompletionFlag::park(const CompletionFlag* const* flags, size_t size, bool any, Deadline deadline)
+{
+    Waiter waiter;
+    waiter.any_ = any;
+    std::vector<Entry> entries(size);
+    bool done = false;
+    for(size_t i=0;i<size && !done;i++)
+    {
+        const CompletionFlag* flag = flags[i];
+        if(flag == nullptr)
+        {
+            done = any;
+            continue;
+        }
+        Bucket& bucket = bucketOf(flag);
+        std::lock_guard<std::mutex> lock(bucket.mtx_);
+        // 分片锁里打上PARKED再挂上去，set()看到PARKED以后拿同一把锁，一定能找到这一项
+        if(flag->state_.fetch_or(PARKED, std::memory_order_acq_rel) & SET)
+        {
+            done = any;
+            continue;
+        }
+        Entry& entry = entries[i];
+        entry.key_ = flag;
+        entry.waiter_ = &waiter;
+        entry.next_ = bucket.head_;
+        if(entry.next_ != nullptr)
+            entry.next_->prev_ = &entry;
+        bucket.head_ = &entry;
+        entry.linked_ = true;
+        waiter.pending_.fetch_add(1, std::memory_order_relaxed);
+        if(any && waiter.signal_.load(std::memory_order_acquire))
+            done = true;// 挂前面几个的时候已经有一个设置了
+    }
+    // 减掉多的1：挂的过程中全部都设置了的话就不用睡了
+    if(waiter.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        done = true;
+
+    if(!done)
+    {
+#ifdef __linux__
+        while(!waiter.signal_.load(std::memory_order_acquire))
+        {
+            if(!futexWait(waiter.signal_, 0, deadline))
+                break;
+        }
+#else
+        std::unique_lock<std::mutex> lock(waiter.mtx_);
+        auto signaled = [&]()->bool{return waiter.signal_.load() != 0;};
+        if(deadline == Deadline::max())
+            waiter.cond_.wait(lock, signaled);
+        else
+            waiter.cond_.wait_until(lock, deadline, signaled);
+#endif
+    }
+
+    // 摘掉还挂着的登记(超时、或者waitAny已经等到一个)；set()在分片锁里叫醒，拿到锁以后它就不会再碰waiter了
+    for(size_t i=0;i<size;i++)
+    {
+        if(entries[i].key_ == nullptr)
+            continue;
+        Bucket& bucket = bucketOf(entries[i].key_);
+        std::lock_guard<std::mutex> lock(bucket.mtx_);
+        if(entries[i].linked_)
+            unlink(bucket, &entries[i]);
+    }
+}
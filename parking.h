@@ -0,0 +1,64 @@
+#ifndef PARKING_H
+#define PARKING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// 一次性的完成标志：只有一个32位的原子字，取代每个结果里的互斥锁+条件变量
+// set()在没人等的时候只是一次原子交换，不加锁也不进内核；有人等时等待方先在字上打上标记，set()看到标记才去唤醒
+// linux下单个等待直接用futex睡在这个字上；一组一起等(waitAll/waitAny)的等待方按地址挂到全局分片的等待表里，
+// 整组只睡一次，满足条件时由最后一个(或者第一个)set()的线程叫醒一次
+class CompletionFlag
+{
+public:
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    CompletionFlag()
+        : state_(0)
+    {}
+    CompletionFlag(const CompletionFlag&)=delete;
+    CompletionFlag& operator=(const CompletionFlag&)=delete;
+
+    bool isSet() const
+    {
+        return (state_.load(std::memory_order_acquire) & SET) != 0;
+    }
+    // 设置并唤醒所有等待方，之前的写入对等待方可见
+    void set()
+    {
+        uint32_t old = state_.exchange(SET, std::memory_order_acq_rel);
+        if(old & (WAITING | PARKED))
+            wake(old);
+    }
+    // 清掉标志重新使用，不能有人正在等
+    void reset()
+    {
+        state_.store(0, std::memory_order_relaxed);
+    }
+    void wait() const
+    {
+        if(!isSet())
+            waitUntil(Deadline::max());
+    }
+    // 等到设置或者到deadline，返回是否设置了
+    bool waitUntil(Deadline deadline) const;
+
+    // 等flags全部设置，到deadline返回false；空指针算已经设置
+    static bool waitAll(const CompletionFlag* const* flags, size_t size, Deadline deadline = Deadline::max());
+    // 等flags任意一个设置，返回它的下标，到deadline返回size
+    static size_t waitAny(const CompletionFlag* const* flags, size_t size, Deadline deadline = Deadline::max());
+private:
+    static const uint32_t SET = 1;
+    static const uint32_t WAITING = 2; // 有线程直接睡在这个字上(futex)
+    static const uint32_t PARKED = 4; // 有线程挂在等待表里
+
+    void wake(uint32_t old);
+    // 挂到等待表里一组一起等，any为true时任意一个设置就被叫醒；到deadline返回
+    static void park(const CompletionFlag* const* flags, size_t size, bool any, Deadline deadline);
+
+    mutable std::atomic<uint32_t> state_;
+};
+
+#endif //PARKING_H
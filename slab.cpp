@@ -0,0 +1,218 @@
+#include "slab.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace
+{
+// 块大小分档，都是16的倍数，slab头部占64字节，块都是16字节对齐的
+const size_t CLASS_SIZES[] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+const int CLASS_COUNT = sizeof(CLASS_SIZES) / sizeof(CLASS_SIZES[0]);
+const size_t SLAB_HEADER = 64;
+const size_t SLAB_ALIGN = 16;
+
+// 大小(按16字节向上取整后的份数) => 档位下标
+struct ClassTable
+{
+    int index_[SLAB_MAX_BLOCK / 16 + 1];
+    ClassTable()
+    {
+        int c = 0;
+        for(size_t units=0;units<=SLAB_MAX_BLOCK / 16;units++)
+        {
+            while(CLASS_SIZES[c] < units * 16)
+                c++;
+            index_[units] = c;
+        }
+    }
+};
+const ClassTable classTable;
+
+struct FreeBlock
+{
+    FreeBlock* next_;
+};
+
+struct ThreadCache;
+
+// slab按SLAB_SIZE对齐，块地址去掉低位就是所在slab的头部
+struct Slab
+{
+    ThreadCache* owner_;
+    int sizeClass_;
+};
+
+struct ThreadCache
+{
+    FreeBlock* free_[CLASS_COUNT] = {}; // 本线程释放的块
+    char* bump_[CLASS_COUNT] = {}; // 当前slab里还没切过的部分
+    char* bumpEnd_[CLASS_COUNT] = {};
+    std::atomic<FreeBlock*> remote_{nullptr}; // 别的线程还回来的块，所有档位混在一起
+};
+
+std::atomic<uint64_t> slabCount(0);
+std::atomic<uint64_t> remoteFreeCount(0);
+
+// 没有线程在用的缓存；故意不析构，进程退出时还没退出的线程(分离的线程)还会往里放
+struct IdleCaches
+{
+    std::mutex mtx_;
+    std::vector<ThreadCache*> caches_;
+};
+
+IdleCaches& idleCaches()
+{
+    static IdleCaches* idle = new IdleCaches();
+    return *idle;
+}
+
+ThreadCache* acquireCache()
+{
+    IdleCaches& idle = idleCaches();
+    std::lock_guard<std::mutex> lock(idle.mtx_);
+    if(idle.caches_.empty())
+        return new ThreadCache();
+    ThreadCache* cache = idle.caches_.back();
+    idle.caches_.pop_back();
+    return cache;
+}
+
+void releaseCache(ThreadCache* cache)
+{
+    IdleCaches& idle = idleCaches();
+    std::lock_guard<std::mutex> lock(idle.mtx_);
+    idle.caches_.push_back(cache);
+}
+
+thread_local ThreadCache* tlsCache = nullptr;
+thread_local bool tlsExited = false;
+
+// 线程退出时把缓存交回去
+struct CacheHolder
+{
+    ~CacheHolder()
+    {
+        if(tlsCache != nullptr)
+        {
+            releaseCache(tlsCache);
+            tlsCache = nullptr;
+        }
+        tlsExited = true;
+    }
+};
+thread_local CacheHolder tlsHolder;
+
+Slab* slabOf(void* ptr)
+{
+    return reinterpret_cast<Slab*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+void drainRemote(ThreadCache& cache)
+{
+    FreeBlock* block = cache.remote_.exchange(nullptr, std::memory_order_acquire);
+    while(block != nullptr)
+    {
+        FreeBlock* next = block->next_;
+        int c = slabOf(block)->sizeClass_;
+        block->next_ = cache.free_[c];
+        cache.free_[c] = block;
+        block = next;
+    }
+}
+
+void* allocateFrom(ThreadCache& cache, int c)
+{
+    if(cache.free_[c] == nullptr && cache.remote_.load(std::memory_order_relaxed) != nullptr)
+        drainRemote(cache);
+    if(FreeBlock* block = cache.free_[c])
+    {
+        cache.free_[c] = block->next_;
+        return block;
+    }
+    if(cache.bump_[c] + CLASS_SIZES[c] > cache.bumpEnd_[c])
+    {
+        void* memory = std::aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+        if(memory == nullptr)
+            throw std::bad_alloc();
+        Slab* slab = new (memory) Slab{&cache, c};
+        cache.bump_[c] = reinterpret_cast<char*>(slab) + SLAB_HEADER;
+        cache.bumpEnd_[c] = reinterpret_cast<char*>(slab) + SLAB_SIZE;
+        slabCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* ptr = cache.bump_[c];
+    cache.bump_[c] += CLASS_SIZES[c];
+    return ptr;
+}
+
+void freeTo(ThreadCache* local, void* ptr)
+{
+    Slab* slab = slabOf(ptr);
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    if(slab->owner_ == local)
+    {
+        block->next_ = local->free_[slab->sizeClass_];
+        local->free_[slab->sizeClass_] = block;
+        return;
+    }
+    // 不是本线程的块，压进所属缓存的无锁栈；所属线程只会整个取走，不会有ABA问题
+    std::atomic<FreeBlock*>& remote = slab->owner_->remote_;
+    block->next_ = remote.load(std::memory_order_relaxed);
+    while(!remote.compare_exchange_weak(block->next_, block, std::memory_order_release, std::memory_order_relaxed));
+    remoteFreeCount.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace
+
+/////////////  SlabResource方法的实现
+SlabResource* SlabResource::instance()
+{
+    static SlabResource resource;
+    return &resource;
+}
+
+SlabResource::Stats SlabResource::stats()
+{
+    Stats st;
+    st.slabs = slabCount.load(std::memory_order_relaxed);
+    st.remoteFrees = remoteFreeCount.load(std::memory_order_relaxed);
+    return st;
+}
+
+void* SlabResource::do_allocate(size_t bytes, size_t alignment)
+{
+    if(bytes > SLAB_MAX_BLOCK || alignment > SLAB_ALIGN)
+        return ::operator new(bytes, std::align_val_t(alignment));
+    int c = classTable.index_[(bytes + 15) / 16];
+
+    if(tlsCache == nullptr)
+    {
+        if(tlsExited)
+        {
+            // 线程退出过程中(别的thread_local析构时)还在分配，临时借一个空闲缓存
+            ThreadCache* cache = acquireCache();
+            void* ptr = allocateFrom(*cache, c);
+            releaseCache(cache);
+            return ptr;
+        }
+        (void)&tlsHolder;// 第一次用时构造，线程退出时析构
+        tlsCache = acquireCache();
+    }
+    return allocateFrom(*tlsCache, c);
+}
+
+void SlabResource::do_deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+    if(bytes > SLAB_MAX_BLOCK || alignment > SLAB_ALIGN)
+    {
+        ::operator delete(ptr, std::align_val_t(alignment));
+        return;
+    }
+    freeTo(tlsCache, ptr);
+}
+
+bool SlabResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,34 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+// 小块内存的每线程slab分配器，给任务对象、结果、共享状态用
+// 每个线程有自己的缓存：按大小分成几档，每档一个空闲链表，链表空了从自己的64KB slab里切；分配和本线程释放都不加锁
+// 别的线程释放的块(比如线程池线程执行完任务，结果在提交方释放)通过无锁栈还给所属线程的缓存，所属线程下次分配时一次收回
+// 线程退出时缓存交回全局列表，给之后新建的线程接着用，slab不还给系统
+// 超过SLAB_MAX_BLOCK字节或者对齐要求超过16字节的走::operator new
+class SlabResource : public std::pmr::memory_resource
+{
+public:
+    // 全局共享的一个实例(缓存本来就是按线程分开的，不需要多个实例)
+    static SlabResource* instance();
+
+    struct Stats
+    {
+        uint64_t slabs = 0; // 向系统申请过的slab个数
+        uint64_t remoteFrees = 0; // 跨线程释放的块数
+    };
+    static Stats stats();
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+const size_t SLAB_SIZE = 64 * 1024;
+const size_t SLAB_MAX_BLOCK = 1024;
+
+#endif //SLAB_H
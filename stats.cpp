@@ -0,0 +1,198 @@
+#include "stats.h"
+
+#include <cstdio>
+
+/////////////  Histogram方法的实现
+Histogram::Histogram()
+    : buckets(BUCKETS, 0)
+    , count(0)
+    , sum(0)
+    , max(0)
+{
+}
+
+int Histogram::bucketOf(uint64_t value)
+{
+    if(value < (1u << SUB_BITS))// 小的值每个值一个桶
+        return value;
+    int msb = 63 - __builtin_clzll(value);
+    int group = msb - SUB_BITS + 1;
+    int sub = (value >> (msb - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+    return (group << SUB_BITS) + sub;
+}
+
+uint64_t Histogram::bucketLow(int bucket)
+{
+    int group = bucket >> SUB_BITS;
+    uint64_t sub = bucket & ((1 << SUB_BITS) - 1);
+    if(group == 0)
+        return sub;
+    return ((1ull << SUB_BITS) + sub) << (group - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+    buckets[bucketOf(value)]++;
+    count++;
+    sum += value;
+    if(value > max)
+        max = value;
+}
+
+void Histogram::merge(const Histogram& other)
+{
+    for(int i=0;i<BUCKETS;i++)
+    {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    if(other.max > max)
+        max = other.max;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+    if(count == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(p / 100 * count);
+    if(rank >= count)
+        rank = count - 1;
+    uint64_t seen = 0;
+    for(int i=0;i<BUCKETS;i++)
+    {
+        seen += buckets[i];
+        if(seen > rank)
+        {
+            // 取桶的中间值，最大的那个桶不超过实际最大值
+            uint64_t low = bucketLow(i);
+            uint64_t high = i + 1 < BUCKETS ? bucketLow(i + 1) : low;
+            uint64_t mid = low + (high - low) / 2;
+            return mid < max ? mid : max;
+        }
+    }
+    return max;
+}
+
+double Histogram::mean() const
+{
+    return count == 0 ? 0 : (double)sum / count;
+}
+
+/////////////  AtomicHistogram方法的实现
+AtomicHistogram::AtomicHistogram()
+    : count_(0)
+    , sum_(0)
+    , max_(0)
+{
+    for(auto& bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AtomicHistogram::record(uint64_t value)
+{
+    WorkerCounters::add(buckets_[Histogram::bucketOf(value)], 1);
+    WorkerCounters::add(count_, 1);
+    WorkerCounters::add(sum_, value);
+    if(value > max_.load(std::memory_order_relaxed))
+        max_.store(value, std::memory_order_relaxed);
+}
+
+void AtomicHistogram::snapshotInto(Histogram& hist) const
+{
+    Histogram mine;
+    for(int i=0;i<Histogram::BUCKETS;i++)
+    {
+        mine.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        mine.count += mine.buckets[i];// 和桶保持一致，不用count_，免得读的过程中又写进来
+    }
+    mine.sum = sum_.load(std::memory_order_relaxed);
+    mine.max = max_.load(std::memory_order_relaxed);
+    hist.merge(mine);
+}
+
+/////////////  WorkerCounters方法的实现
+WorkerCounters::WorkerCounters(int threadId)
+    : threadId_(threadId)
+    , alive_(true)
+    , tasks_(0)
+    , busyNs_(0)
+    , idleNs_(0)
+    , steals_(0)
+    , helps_(0)
+{
+}
+
+/////////////  PoolStats方法的实现
+namespace
+{
+void appendMetric(std::string& out, const std::string& prefix, const char* name, const char* type, double value)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "# TYPE %s_%s %s\n%s_%s %.9g\n",
+                  prefix.c_str(), name, type, prefix.c_str(), name, value);
+    out += line;
+}
+
+// 直方图按summary导出：几个分位数 + 总和 + 个数，单位秒
+void appendSummary(std::string& out, const std::string& prefix, const char* name, const Histogram& hist)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "# TYPE %s_%s summary\n", prefix.c_str(), name);
+    out += line;
+    for(double q : {0.5, 0.9, 0.99, 0.999})
+    {
+        std::snprintf(line, sizeof(line), "%s_%s{quantile=\"%g\"} %.9f\n",
+                      prefix.c_str(), name, q, hist.percentile(q * 100) / 1e9);
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "%s_%s_sum %.9f\n%s_%s_count %llu\n",
+                  prefix.c_str(), name, hist.sum / 1e9, prefix.c_str(), name, (unsigned long long)hist.count);
+    out += line;
+}
+
+void appendWorkerMetric(std::string& out, const std::string& prefix, const char* name,
+                        const std::vector<WorkerStats>& workers, double (*value)(const WorkerStats&))
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "# TYPE %s_%s counter\n", prefix.c_str(), name);
+    out += line;
+    for(const WorkerStats& worker : workers)
+    {
+        std::snprintf(line, sizeof(line), "%s_%s{worker=\"%d\"} %.9g\n",
+                      prefix.c_str(), name, worker.threadId, value(worker));
+        out += line;
+    }
+}
+} // namespace
+
+std::string PoolStats::toPrometheus(const std::string& prefix) const
+{
+    std::string out;
+    appendMetric(out, prefix, "tasks_submitted_total", "counter", submitted);
+    appendMetric(out, prefix, "tasks_completed_total", "counter", completed);
+    appendMetric(out, prefix, "tasks_rejected_total", "counter", rejected);
+    appendMetric(out, prefix, "tasks_dropped_total", "counter", dropped);
+    appendMetric(out, prefix, "tasks_caller_runs_total", "counter", callerRuns);
+    appendMetric(out, prefix, "queue_depth", "gauge", queueDepth);
+    appendMetric(out, prefix, "queue_depth_peak", "gauge", peakQueueDepth);
+    appendMetric(out, prefix, "threads", "gauge", threadSize);
+    appendMetric(out, prefix, "threads_idle", "gauge", idleThreadSize);
+    appendMetric(out, prefix, "threads_spawned_total", "counter", threadsSpawned);
+    appendMetric(out, prefix, "threads_retired_total", "counter", threadsRetired);
+    appendSummary(out, prefix, "queue_wait_seconds", queueWait);
+    appendSummary(out, prefix, "exec_time_seconds", execTime);
+    appendWorkerMetric(out, prefix, "worker_tasks_total", workers,
+                       [](const WorkerStats& w)->double { return w.tasks; });
+    appendWorkerMetric(out, prefix, "worker_busy_seconds_total", workers,
+                       [](const WorkerStats& w)->double { return w.busyNs / 1e9; });
+    appendWorkerMetric(out, prefix, "worker_idle_seconds_total", workers,
+                       [](const WorkerStats& w)->double { return w.idleNs / 1e9; });
+    appendWorkerMetric(out, prefix, "worker_steals_total", workers,
+                       [](const WorkerStats& w)->double { return w.steals; });
+    appendWorkerMetric(out, prefix, "worker_helps_total", workers,
+                       [](const WorkerStats& w)->double { return w.helps; });
+    return out;
+}
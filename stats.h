@@ -0,0 +1,117 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 当前时间(steady_clock)的纳秒数，统计排队/执行耗时用
+inline uint64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// HDR风格的对数-线性直方图(快照)：按最高位分组，每组再细分8档，相对误差不超过12.5%，记录的单位是纳秒
+class Histogram
+{
+public:
+    static const int SUB_BITS = 3;
+    static const int BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+    Histogram();
+
+    // 值落在哪个桶
+    static int bucketOf(uint64_t value);
+    // 桶能表示的最小值
+    static uint64_t bucketLow(int bucket);
+
+    // 记一个值，不是线程安全的
+    void record(uint64_t value);
+    void merge(const Histogram& other);
+    // p取0~100，返回对应百分位的近似值，没有数据返回0
+    uint64_t percentile(double p) const;
+    double mean() const;
+
+    std::vector<uint64_t> buckets;
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+// 记录用的直方图，只允许一个线程写(每个线程一份)，其他线程随时可以读快照
+class AtomicHistogram
+{
+public:
+    AtomicHistogram();
+    AtomicHistogram(const AtomicHistogram&)=delete;
+    AtomicHistogram& operator=(const AtomicHistogram&)=delete;
+
+    void record(uint64_t value);
+    void snapshotInto(Histogram& hist) const;
+private:
+    std::atomic<uint64_t> buckets_[Histogram::BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+// 单个线程自己写的计数器，按缓存行对齐，线程之间不会伪共享，收集时也不用加它们的锁
+struct alignas(64) WorkerCounters
+{
+    WorkerCounters(int threadId);
+
+    // 只有所属线程调用，不需要原子的读改写
+    static void add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    int threadId_;
+    std::atomic_bool alive_; // 线程退出前置false，之后计数并进线程池的汇总，这份计数器就删掉了
+    std::atomic<uint64_t> tasks_; // 执行完的任务数
+    std::atomic<uint64_t> busyNs_; // 执行任务的总时间
+    std::atomic<uint64_t> idleNs_; // 两个任务之间空闲(等任务)的总时间
+    std::atomic<uint64_t> steals_; // 从别的线程本地队列偷到的任务数
+    std::atomic<uint64_t> helps_; // 在任务里等结果时顺便执行的任务数
+    AtomicHistogram waitHist_; // 任务从入队到开始执行的时间
+    AtomicHistogram execHist_; // 任务执行的时间
+};
+
+// 单个线程的统计快照
+struct WorkerStats
+{
+    int threadId; // 已经退出的线程合成一项，threadId为-1
+    bool alive;
+    uint64_t tasks;
+    uint64_t busyNs;
+    uint64_t idleNs;
+    uint64_t steals;
+    uint64_t helps;
+};
+
+// ThreadPool::stats()返回的快照
+struct PoolStats
+{
+    uint64_t submitted = 0; // 成功提交的任务数
+    uint64_t completed = 0; // 执行完的任务数
+    uint64_t rejected = 0; // 队列满提交失败的任务数
+    uint64_t dropped = 0; // 队列满时被OVERFLOW_DROP_OLDEST挤掉的任务数
+    uint64_t callerRuns = 0; // 队列满时按OVERFLOW_CALLER_RUNS在提交方执行的任务数
+    int queueDepth = 0; // 当前排队的任务数
+    int peakQueueDepth = 0; // 排队任务数的历史最大值
+    int threadSize = 0; // 当前线程数
+    int idleThreadSize = 0; // 当前空闲线程数
+    uint64_t threadsSpawned = 0; // 一共创建过的线程数
+    uint64_t threadsRetired = 0; // 一共回收的线程数
+    Histogram queueWait; // 入队到开始执行，纳秒
+    Histogram execTime; // 执行耗时，纳秒
+    std::vector<WorkerStats> workers;
+
+    // 转成Prometheus文本格式，指标名都以prefix开头
+    std::string toPrometheus(const std::string& prefix = "threadpool") const;
+};
+
+#endif //STATS_H
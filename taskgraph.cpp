@@ -0,0 +1,154 @@
+#include "taskgraph.h"
+
+#include <stdexcept>
+
+// 一次run的完成状态，和submit返回的Future用同一套等待/异常机制
+class TaskGraph::RunState : public FutureState<void>
+{
+public:
+    void fail(std::exception_ptr error)
+    {
+        if(!failed_.exchange(true))// 只保留第一个异常
+            setError(error);
+    }
+    bool failed() const
+    {
+        return failed_;
+    }
+    void finish(bool inTask)
+    {
+        complete(inTask);
+    }
+private:
+    std::atomic_bool failed_{false};
+};
+
+/////////////  TaskGraph方法的实现
+TaskGraph::TaskGraph()
+    : prepared_(false)
+    , remaining_(0)
+    , pool_(nullptr)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+}
+
+int TaskGraph::addNode(std::function<void()> func)
+{
+    int index = nodes_.size();
+    auto node = std::make_unique<Node>();
+    node->func_ = std::move(func);
+    nodes_.emplace_back(std::move(node));
+    prepared_ = false;
+    return index;
+}
+
+void TaskGraph::addEdge(int from, int to)
+{
+    if(from < 0 || from >= (int)nodes_.size() || to < 0 || to >= (int)nodes_.size())
+        throw std::out_of_range("task graph node does not exist");
+    nodes_[from]->successors_.push_back(to);
+    nodes_[to]->predecessors_++;
+    prepared_ = false;
+}
+
+size_t TaskGraph::size() const
+{
+    return nodes_.size();
+}
+
+void TaskGraph::prepare()
+{
+    // Kahn拓扑排序：能排完所有节点就没有环
+    std::vector<int> pending(nodes_.size());
+    std::vector<int> ready;
+    for(size_t i=0;i<nodes_.size();i++)
+    {
+        pending[i] = nodes_[i]->predecessors_;
+        if(pending[i] == 0)
+            ready.push_back(i);
+    }
+    roots_ = ready;
+    size_t visited = 0;
+    while(!ready.empty())
+    {
+        int index = ready.back();
+        ready.pop_back();
+        visited++;
+        for(int next : nodes_[index]->successors_)
+        {
+            if(--pending[next] == 0)
+                ready.push_back(next);
+        }
+    }
+    if(visited != nodes_.size())
+        throw std::logic_error("task graph has a cycle");
+    prepared_ = true;
+}
+
+Future<void> TaskGraph::run(ThreadPool& pool)
+{
+    if(!prepared_)
+        prepare();
+
+    auto run = std::make_shared<RunState>();
+    if(nodes_.empty())
+    {
+        run->finish(false);
+        return Future<void>(run);
+    }
+
+    for(auto& node : nodes_)
+    {
+        node->pending_.store(node->predecessors_, std::memory_order_relaxed);
+    }
+    remaining_.store(nodes_.size(), std::memory_order_relaxed);
+    pool_ = &pool;
+    run_ = run;
+    for(int index : roots_)
+    {
+        dispatchNode(index, false);// 入队有锁，上面的写入对执行节点的线程都可见
+    }
+    return Future<void>(run);
+}
+
+void TaskGraph::execNode(int index, bool inTask)
+{
+    Node& node = *nodes_[index];
+    std::shared_ptr<RunState> run = run_;// 最后一个节点完成后图可能马上被再次run或者析构，先拿住
+    if(!run->failed())
+    {
+        try
+        {
+            node.func_();
+        }
+        catch(...)
+        {
+            run->fail(std::current_exception());
+        }
+    }
+
+    for(int next : node.successors_)
+    {
+        // acq_rel：前驱里的写入对后继可见
+        if(nodes_[next]->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            dispatchNode(next, inTask);
+    }
+
+    if(remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        run_ = nullptr;
+        run->finish(inTask);// 之后不能再碰this
+    }
+}
+
+void TaskGraph::dispatchNode(int index, bool inTask)
+{
+    // 第一个就绪的后继由当前线程接着执行，其他的入队；队列满了就在当前线程直接执行，保证图能跑完
+    // 队列里的任务只记着是哪个图的哪个节点，直接放在队列里，没有堆分配
+    // 直接执行时调用方的任务还没结束(可能接着就要等这个图)，不是在任务的最后，它的后继不能交给当前线程接着做
+    if(!pool_->dispatchTask(TaskItem([this, index]() { execNode(index, true); }), inTask))
+        execNode(index, false);
+}
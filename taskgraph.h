@@ -0,0 +1,68 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "threadpool.h"
+
+/*
+example:
+TaskGraph graph;
+int load = graph.addNode([]{ ... });
+int parse = graph.addNode([]{ ... });
+int store = graph.addNode([]{ ... });
+graph.addEdge(load, parse);  // parse等load执行完
+graph.addEdge(parse, store);
+for(...) graph.run(pool).get(); // 建一次，跑多次
+*/
+
+// 任务图(DAG)：先声明节点和依赖关系，之后在线程池上反复执行
+// 每个节点有一个原子的待完成前驱计数，最后一个前驱执行完的线程把它减到0，直接接着执行这个节点(不进队列)，
+// 同时就绪的其他后继才放进队列；整个过程没有线程阻塞等待
+class TaskGraph
+{
+public:
+    TaskGraph();
+    ~TaskGraph();
+    TaskGraph(const TaskGraph&)=delete;
+    TaskGraph& operator=(const TaskGraph&)=delete;
+
+    // 加一个节点，返回节点编号
+    int addNode(std::function<void()> func);
+    // to要等from执行完才能执行
+    void addEdge(int from, int to);
+    // 节点个数
+    size_t size() const;
+
+    // 在pool上执行一遍整个图，返回的Future在所有节点执行完后就绪
+    // 某个节点抛了异常，之后还没开始的节点都不再执行，get()时抛出第一个异常；图里有环时抛std::logic_error
+    // 同一个图可以反复run，但上一次run完成之前不能再run，也不能改图
+    Future<void> run(ThreadPool& pool);
+private:
+    class RunState;
+    struct Node
+    {
+        std::function<void()> func_;
+        std::vector<int> successors_;
+        int predecessors_ = 0;
+        std::atomic_int pending_{0}; // 本次run还没执行完的前驱数
+    };
+
+    // 检查有没有环，找出没有前驱的节点
+    void prepare();
+    // inTask表示这次执行是队列里的一个任务(执行完就是任务的最后)，就绪的后继可以交给当前线程接着做
+    void execNode(int index, bool inTask);
+    void dispatchNode(int index, bool inTask);
+
+    std::vector<std::unique_ptr<Node>> nodes_;
+    std::vector<int> roots_;
+    bool prepared_; // 图改过以后要重新检查
+    std::atomic_int remaining_; // 本次run还没执行完的节点数
+    ThreadPool* pool_; // 本次run用的线程池
+    std::shared_ptr<RunState> run_; // 本次run的结果
+};
+
+#endif //TASKGRAPH_H
@@ -0,0 +1,81 @@
+#include <atomic>
+
+#include "tests/check.h"
+
+// 取消令牌、截止时间和限时等待：出队时已经取消或者过了截止时间的任务不执行，等待方拿到TaskCancelled
+namespace
+{
+void token()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::atomic_bool ran{false};
+    CancelToken token;
+    Future<int> future = pool.submit(TaskOptions{TaskPriority::PRIORITY_NORMAL, token}, [&ran]() { ran = true; return 1; });
+    token.cancel();
+    CHECK(token.isCancelled());
+    gate.open();
+    CHECK(future.waitFor(std::chrono::seconds(5)) == WaitStatus::CANCELLED);
+    CHECK(check::throws<TaskCancelled>([&]() { future.get(); }));
+    CHECK(!ran);
+
+    // 空令牌永远不会被取消
+    CHECK(pool.submit(TaskOptions{TaskPriority::PRIORITY_NORMAL, nullptr}, []() { return 2; }).get() == 2);
+}
+
+void deadline()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::atomic_bool ran{false};
+    TaskOptions options;
+    options.deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+    Future<void> late = pool.submit(options, [&ran]() { ran = true; });
+    options.deadline_ = std::chrono::steady_clock::now() + std::chrono::hours(1);
+    Future<void> early = pool.submit(options, []() {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    gate.open();
+    CHECK(late.waitFor(std::chrono::seconds(5)) == WaitStatus::CANCELLED);
+    CHECK(early.waitFor(std::chrono::seconds(5)) == WaitStatus::READY);
+    CHECK(!ran);
+}
+
+void timedWait()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    Future<int> future = pool.submit([]() { return 3; });
+    auto begin = check::Clock::now();
+    CHECK(future.waitFor(std::chrono::milliseconds(10)) == WaitStatus::TIMEOUT);
+    CHECK(check::elapsedMs(begin) >= 9);
+    CHECK(!future.ready());
+    gate.open();
+    CHECK(future.waitUntil(Deadline::max()) == WaitStatus::READY);
+    CHECK(future.get() == 3);
+}
+
+// 任务抛出的异常在get时重新抛出
+void error()
+{
+    ThreadPool pool;
+    pool.start(1);
+    Future<int> future = pool.submit([]() -> int { throw std::logic_error("boom"); });
+    CHECK(check::throws<std::logic_error>([&]() { future.get(); }));
+}
+
+void cancel()
+{
+    token();
+    deadline();
+    timedWait();
+    error();
+}
+} // namespace
+
+TEST_REGISTER("cancel", cancel);
@@ -0,0 +1,138 @@
+#ifndef THREADPOOL_CHECK_H
+#define THREADPOOL_CHECK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "threadpool.h"
+
+// 单元测试的公共工具：按名字注册用例，CHECK失败只记下来接着跑，main里按失败数返回
+// 用例只用1、2个线程，靠Gate占住线程来构造队列满、任务排着队这些状态，不靠sleep猜时机
+namespace check
+{
+using Clock = std::chrono::steady_clock;
+
+using TestFunc = std::function<void()>;
+
+// 名字 => 用例
+inline std::map<std::string, TestFunc>& registry()
+{
+    static std::map<std::string, TestFunc> tests;
+    return tests;
+}
+
+struct Registrar
+{
+    Registrar(const char* name, TestFunc func)
+    {
+        registry().emplace(name, std::move(func));
+    }
+};
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void fail(const char* expr, const char* file, int line)
+{
+    std::printf("%s:%d: CHECK(%s) failed\n", file, line, expr);
+    std::fflush(stdout);
+    failures()++;
+}
+
+// 从begin到现在经过的毫秒数
+inline double elapsedMs(Clock::time_point begin)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+// 调用func，抛出E返回true
+template<typename E, typename Func>
+bool throws(Func&& func)
+{
+    try
+    {
+        func();
+    }
+    catch(const E&)
+    {
+        return true;
+    }
+    catch(...)
+    {
+    }
+    return false;
+}
+
+// 轮询到cond成立，最多等timeout
+template<typename Cond>
+bool eventually(Cond&& cond, std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+{
+    auto deadline = Clock::now() + timeout;
+    while(!cond())
+    {
+        if(Clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// 占住线程池的线程：occupy提交count个等在门上的任务，等它们都开始执行了才返回，open()放行
+// 声明在ThreadPool后面，先于线程池析构(析构时放行)，线程池析构等任务做完时不会卡住
+class Gate
+{
+public:
+    ~Gate()
+    {
+        open();
+    }
+    void occupy(ThreadPool& pool, int count = 1)
+    {
+        for(int i=0;i<count;i++)
+        {
+            pool.post([this]()
+            {
+                started_++;
+                while(!open_.load())
+                {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        eventually([&]() { return started_.load() >= count; });
+    }
+    void open()
+    {
+        open_ = true;
+    }
+    bool isOpen() const
+    {
+        return open_.load();
+    }
+    // delay以后在另一个线程上放行，调用方接着阻塞在线程池上(shutdown)
+    std::thread openAfter(std::chrono::milliseconds delay)
+    {
+        return std::thread([this, delay]()
+        {
+            std::this_thread::sleep_for(delay);
+            open();
+        });
+    }
+private:
+    std::atomic_bool open_{false};
+    std::atomic_int started_{0};
+};
+} // namespace check
+
+#define CHECK(cond) ((cond) ? (void)0 : check::fail(#cond, __FILE__, __LINE__))
+#define TEST_REGISTER(name, func) static check::Registrar check_registrar_##func(name, func)
+
+#endif //THREADPOOL_CHECK_H
@@ -0,0 +1,102 @@
+#include <vector>
+
+#include "tests/check.h"
+
+// waitAll/waitAny/BatchResult：等一组任务全部或者任意一个完成
+namespace
+{
+class ValueTask : public Task
+{
+public:
+    explicit ValueTask(int value)
+        : value_(value)
+    {}
+    Any run() override { return value_; }
+private:
+    int value_;
+};
+
+void futures()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::vector<Future<int>> all;
+    for(int i=0;i<100;i++)
+    {
+        all.push_back(pool.submit([i]() { return i; }));
+    }
+    waitAll(all);
+    bool ready = true;
+    for(int i=0;i<100;i++)
+    {
+        ready = ready && all[i].ready();
+    }
+    CHECK(ready);
+    CHECK(all[42].get() == 42);
+
+    // 第0个等着放行，第1个在另一个线程上先完成
+    std::atomic_bool release{false};
+    std::vector<Future<int>> pair;
+    pair.push_back(pool.submit([&release]()
+    {
+        while(!release.load())
+        {
+            std::this_thread::yield();
+        }
+        return 0;
+    }));
+    pair.push_back(pool.submit([]() { return 1; }));
+    CHECK(waitAny(pair) == 1);
+    CHECK(!pair[0].ready());
+    release = true;
+    waitAll(pair);
+    CHECK(pair[0].get() == 0);
+
+    std::vector<Future<int>> empty;
+    waitAll(empty);
+    CHECK(waitAny(empty) == 0);
+}
+
+void results()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::vector<Result> results;
+    results.push_back(pool.submitTask(std::make_shared<ValueTask>(7)));
+    results.push_back(pool.trySubmitTask(std::make_shared<ValueTask>(8)));// 队列满了，无效的Result
+    // 无效的算已经完成
+    CHECK(waitAny(results) == 1);
+    CHECK(results[1].waitFor(std::chrono::milliseconds(0)) == WaitStatus::CANCELLED);
+    CHECK(results[0].waitFor(std::chrono::milliseconds(5)) == WaitStatus::TIMEOUT);
+    gate.open();
+    waitAll(results);
+    CHECK(results[0].get().cast_<int>() == 7);
+}
+
+void batch()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::vector<std::shared_ptr<Task>> tasks;
+    for(int i=0;i<10;i++)
+    {
+        tasks.push_back(std::make_shared<ValueTask>(i));
+    }
+    BatchResult result = pool.submitBatch(tasks);
+    CHECK(result.size() == 10);
+    result.wait();
+    CHECK(result.result(9).get().cast_<int>() == 9);
+}
+
+void completion()
+{
+    futures();
+    results();
+    batch();
+}
+} // namespace
+
+TEST_REGISTER("completion", completion);
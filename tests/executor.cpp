@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "executor.h"
+#include "tests/check.h"
+
+namespace
+{
+// 跑满一批以后线程池队列是满的：OVERFLOW_CALLER_RUNS下不能在drain里递归执行下一批，
+// 每个任务都应该在同一层栈上执行，栈地址不会一批比一批深
+void repostWhenFull()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_CALLER_RUNS);
+    pool.start(1);
+    ExecutorGroup group(pool, 1);
+    int tenant = group.addTenant("t");
+
+    std::atomic_bool filled{false};
+    std::atomic_bool started{false};
+    std::thread::id worker;
+    group.post(tenant, [&]()
+    {
+        worker = std::this_thread::get_id();
+        started = true;
+        while(!filled.load())
+        {
+            std::this_thread::yield();
+        }
+    });
+    CHECK(check::eventually([&]() { return started.load(); }));
+    std::atomic<uintptr_t> lowest{UINTPTR_MAX};
+    std::atomic<uintptr_t> highest{0};
+    std::atomic_int done{0};
+    for(int i=0;i<200;i++)
+    {
+        group.post(tenant, [&]()
+        {
+            if(std::this_thread::get_id() == worker)
+            {
+                uintptr_t frame = (uintptr_t)__builtin_frame_address(0);
+                uintptr_t low = lowest.load();
+                while(frame < low && !lowest.compare_exchange_weak(low, frame));
+                uintptr_t high = highest.load();
+                while(frame > high && !highest.compare_exchange_weak(high, frame));
+            }
+            done++;
+        });
+    }
+    CHECK(pool.post([]() {}));// 占满线程池队列
+    filled = true;
+    group.wait();
+    CHECK(done == 200);
+    CHECK(highest - lowest < 256);
+}
+
+void spinUs(int us)
+{
+    uint64_t end = steadyNowNs() + (uint64_t)us * 1000;
+    while(steadyNowNs() < end);
+}
+
+// DRR：两个租户都一直有任务排着时，执行时间按权重3:1分；容量满了拒绝
+void fairness()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    ExecutorGroup group(pool);
+    int heavy = group.addTenant("heavy", 3);
+    int light = group.addTenant("light", 1);
+    CHECK(group.tenantCount() == 2);
+
+    gate.occupy(pool);// 先让任务都排上
+    std::mutex mtx;
+    std::vector<int> order;
+    for(int i=0;i<200;i++)
+    {
+        for(int tenant : {heavy, light})
+        {
+            CHECK(group.post(tenant, [&mtx, &order, tenant]()
+            {
+                spinUs(50);
+                std::lock_guard<std::mutex> lock(mtx);
+                order.push_back(tenant);
+            }));
+        }
+    }
+    gate.open();
+    group.wait();
+    CHECK(order.size() == 400);
+
+    // 前160个里heavy大约占3/4
+    int heavyRan = 0;
+    for(int i=0;i<160;i++)
+    {
+        heavyRan += order[i] == heavy ? 1 : 0;
+    }
+    CHECK(heavyRan >= 100 && heavyRan <= 140);
+    TenantStats st = group.stats(heavy);
+    CHECK(st.name == "heavy" && st.weight == 3);
+    CHECK(st.submitted == 200 && st.completed == 200 && st.queueDepth == 0);
+
+    int small = group.addTenant("small", 1, 2);
+    check::Gate busy;// 先于group析构放行，group析构时等得到排着的任务
+    busy.occupy(pool);
+    CHECK(group.post(small, []() {}));
+    CHECK(group.post(small, []() {}));
+    CHECK(!group.post(small, []() {}));
+    Future<int> rejected = group.submit(small, []() { return 1; });
+    CHECK(check::throws<std::runtime_error>([&]() { rejected.get(); }));
+    CHECK(group.stats(small).rejected == 2);
+}
+
+void executor()
+{
+    repostWhenFull();
+    fairness();
+}
+} // namespace
+
+TEST_REGISTER("executor", executor);
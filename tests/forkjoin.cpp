@@ -0,0 +1,95 @@
+#include <atomic>
+
+#include "taskgraph.h"
+#include "tests/check.h"
+
+// 池内线程在任务里等别的任务(helpWait)：固定1、2个线程，队列满了也要能跑完
+namespace
+{
+long fibSeq(int n)
+{
+    return n < 2 ? n : fibSeq(n - 1) + fibSeq(n - 2);
+}
+
+long fibPar(ThreadPool& pool, int n)
+{
+    if(n < 10)
+        return fibSeq(n);
+    Future<long> left = pool.submit([&pool, n]() { return fibPar(pool, n - 1); });
+    long right = fibPar(pool, n - 2);
+    return left.get() + right;
+}
+
+void fib()
+{
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        for(int threads : {1, 2})
+        {
+            ThreadPool pool;
+            pool.setMode(mode);
+            pool.start(threads);
+            CHECK(pool.submit([&pool]() { return fibPar(pool, 20); }).get() == fibSeq(20));
+        }
+    }
+}
+
+// 队列只放得下1个任务：子任务放不进去时在提交方直接执行，照样算对
+void fibQueueFull()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_CALLER_RUNS);
+    pool.start(1);
+    CHECK(pool.submit([&pool]() { return fibPar(pool, 18); }).get() == fibSeq(18));
+}
+
+// 队列满了任务图的节点在调用方的任务中间直接执行，它的后继不能交给当前线程留到任务结束，
+// 否则调用方接着等这个图就永远等不到
+void graphQueueFull()
+{
+    for(OverflowPolicy policy : {OverflowPolicy::OVERFLOW_CALLER_RUNS, OverflowPolicy::OVERFLOW_BLOCK})
+    {
+        ThreadPool pool;
+        pool.setTaskQueMaxThreshHold(1);
+        pool.setOverflowPolicy(policy);
+        pool.setSubmitTimeout(20);
+        pool.start(1);
+        int ran = pool.submit([&pool]()
+        {
+            pool.post([]() {});// 占满队列
+            std::atomic_int count{0};
+            TaskGraph graph;
+            int first = graph.addNode([&]() { count++; });
+            int second = graph.addNode([&]() { count++; });
+            graph.addEdge(first, second);
+            graph.run(pool).get();
+            return count.load();
+        }).get();
+        CHECK(ran == 2);
+    }
+}
+
+// 池内线程get一个then出来的Future：后继在完成前一个任务的线程上接着执行
+void thenChain()
+{
+    ThreadPool pool;
+    pool.start(1);
+    int value = pool.submit([&pool]()
+    {
+        Future<int> first = pool.submit([]() { return 20; });
+        return first.then(pool, [](int v) { return v + 1; }).then(pool, [](int v) { return v * 2; }).get();
+    }).get();
+    CHECK(value == 42);
+}
+
+void forkjoin()
+{
+    fib();
+    fibQueueFull();
+    graphQueueFull();
+    thenChain();
+}
+} // namespace
+
+TEST_REGISTER("forkjoin", forkjoin);
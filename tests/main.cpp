@@ -0,0 +1,34 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "tests/check.h"
+
+// 用法：threadpool_test [名字...]
+// 不带名字跑全部，带名字只跑同名的用例(ctest每个用例单独跑一次)；有CHECK失败返回1
+int main(int argc, char* argv[])
+{
+    int ran = 0;
+    for(auto& item : check::registry())
+    {
+        bool selected = argc < 2;
+        for(int i=1;i<argc && !selected;i++)
+        {
+            selected = item.first == argv[i];
+        }
+        if(!selected)
+            continue;
+        int before = check::failures();
+        std::printf("== %s\n", item.first.c_str());
+        std::fflush(stdout);
+        item.second();
+        std::printf("%s %s\n", check::failures() == before ? "ok" : "FAILED", item.first.c_str());
+        ran++;
+    }
+    if(ran == 0)
+    {
+        std::printf("no test selected\n");
+        return 1;
+    }
+    return check::failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "tests/check.h"
+
+// 队列满了时的每种处理方式：1个线程占住，队列上限1，再放一个就满了
+namespace
+{
+void fail(QueueMode queue)
+{
+    ThreadPool pool;
+    pool.setQueueMode(queue);
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_FAIL);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.post([]() {}));
+    auto begin = check::Clock::now();
+    CHECK(!pool.post([]() {}));
+    Future<int> rejected = pool.submit([]() { return 1; });
+    CHECK(check::throws<std::runtime_error>([&]() { rejected.get(); }));
+    CHECK(check::elapsedMs(begin) < 500);
+    CHECK(pool.stats().rejected == 2);
+}
+
+void block(QueueMode queue)
+{
+    ThreadPool pool;
+    pool.setQueueMode(queue);
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setSubmitTimeout(200);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.post([]() {}));
+    auto begin = check::Clock::now();
+    CHECK(!pool.post([]() {}));// 等满submitTimeout还是放不进去
+    CHECK(check::elapsedMs(begin) >= 190);
+    // tryPost不管设的是什么都不等
+    begin = check::Clock::now();
+    CHECK(!pool.tryPost([]() {}));
+    CHECK(check::elapsedMs(begin) < 190);
+
+    // 等的过程中线程放行、取走排队的任务，空出位置就能放进去
+    std::thread opener = gate.openAfter(std::chrono::milliseconds(5));
+    CHECK(pool.post([]() {}));
+    opener.join();
+}
+
+void callerRuns(QueueMode queue)
+{
+    ThreadPool pool;
+    pool.setQueueMode(queue);
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_CALLER_RUNS);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.post([]() {}));
+    std::thread::id runner;
+    CHECK(pool.post([&runner]() { runner = std::this_thread::get_id(); }));
+    CHECK(runner == std::this_thread::get_id());
+    CHECK(pool.submit([]() { return std::this_thread::get_id(); }).get() == std::this_thread::get_id());
+    CHECK(pool.stats().callerRuns == 2);
+}
+
+void dropOldest(QueueMode queue)
+{
+    ThreadPool pool;
+    pool.setQueueMode(queue);
+    pool.setTaskQueMaxThreshHold(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_DROP_OLDEST);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::atomic_bool oldRan{false};
+    Future<int> oldest = pool.submit([&oldRan]() { oldRan = true; return 1; });
+    Future<int> newest = pool.submit([]() { return 2; });
+    CHECK(oldest.waitFor(std::chrono::milliseconds(0)) == WaitStatus::CANCELLED);
+    gate.open();
+    CHECK(newest.get() == 2);
+    CHECK(!oldRan);
+    CHECK(pool.stats().dropped == 1);
+}
+
+// 按内存限制：单个任务比限制还大时，队列空着也能放一个，之后就满了
+void bytes()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxBytes(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_FAIL);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.post([]() {}));
+    CHECK(!pool.post([]() {}));
+    CHECK(check::throws<std::runtime_error>([&]() { pool.submit([]() { return 1; }).get(); }));
+}
+
+// 工作窃取模式池内线程提交的任务放进本地队列，不算字节数；shutdown时取出来不能减它们的字节数，
+// 否则字节数的统计被减成负的，负数会被当成队列空着，限制就失效了
+void bytesAfterRestart()
+{
+    ThreadPool pool;
+    pool.setMode(PoolMode::MODE_STEALING);
+    pool.setTaskQueMaxBytes(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_FAIL);
+    pool.start(1);
+    check::Gate gate;
+    std::atomic_bool posted{false};
+    pool.post([&]()
+    {
+        for(int i=0;i<8;i++)
+        {
+            pool.post([]() {});// 本地队列不限长度
+        }
+        posted = true;
+        while(!gate.isOpen())
+        {
+            std::this_thread::yield();
+        }
+    });
+    CHECK(check::eventually([&]() { return posted.load(); }));
+    std::thread opener = gate.openAfter(std::chrono::milliseconds(20));
+    std::vector<TaskItem> pending = pool.shutdown(ShutdownMode::SHUTDOWN_DISCARD);
+    opener.join();
+    CHECK(pending.size() == 8);
+    pending.clear();
+
+    pool.start(1);
+    check::Gate busy;
+    busy.occupy(pool);
+    CHECK(pool.post([]() {}));
+    CHECK(!pool.post([]() {}));
+}
+
+class NopTask : public Task
+{
+public:
+    Any run() override { return 0; }
+};
+
+// 分片队列的一批任务和单个提交一样：OVERFLOW_BLOCK等空位，也看内存限制
+void batchSharded()
+{
+    std::vector<std::shared_ptr<Task>> tasks;
+    for(int i=0;i<3;i++)
+    {
+        tasks.push_back(std::make_shared<NopTask>());
+    }
+    {
+        ThreadPool pool;
+        pool.setQueueMode(QueueMode::MODE_SHARDED);
+        pool.setTaskQueMaxThreshHold(1);
+        pool.setSubmitTimeout(2000);
+        pool.start(1);
+        check::Gate gate;
+        gate.occupy(pool);
+        std::thread opener = gate.openAfter(std::chrono::milliseconds(5));
+        BatchResult result = pool.submitBatch(tasks);
+        opener.join();
+        CHECK(result.size() == 3);
+        result.wait();
+    }
+    ThreadPool pool;
+    pool.setQueueMode(QueueMode::MODE_SHARDED);
+    pool.setTaskQueMaxBytes(1);
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_FAIL);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.submitBatch(tasks).size() == 1);
+}
+
+void overflow()
+{
+    for(QueueMode queue : {QueueMode::MODE_MUTEX, QueueMode::MODE_RING, QueueMode::MODE_SHARDED})
+    {
+        fail(queue);
+        block(queue);
+        callerRuns(queue);
+        dropOldest(queue);
+    }
+    bytes();
+    bytesAfterRestart();
+    batchSharded();
+}
+} // namespace
+
+TEST_REGISTER("overflow", overflow);
@@ -0,0 +1,84 @@
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.h"
+#include "tests/check.h"
+
+// 并行算法的结果和串行版本一样：自动粒度、粒度为1、空区间和只有一个元素
+namespace
+{
+void forEach()
+{
+    ThreadPool pool;
+    pool.start(2);
+    for(size_t grain : {size_t(0), size_t(1), size_t(1000)})
+    {
+        std::vector<int> out(10000, -1);
+        parallelFor(pool, 0, (int)out.size(), [&out](int i) { out[i] = i * 2; }, grain);
+        bool all = true;
+        for(int i=0;i<(int)out.size();i++)
+        {
+            all = all && out[i] == i * 2;
+        }
+        CHECK(all);
+    }
+    int calls = 0;
+    parallelFor(pool, 5, 5, [&calls](int) { calls++; });
+    CHECK(calls == 0);
+
+    // body抛的异常在调用线程上重新抛出
+    CHECK(check::throws<std::runtime_error>([&]()
+    {
+        parallelFor(pool, 0, 100, [](int i) { if(i == 57) throw std::runtime_error("body"); }, 1);
+    }));
+}
+
+void reduce()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::vector<long> data(100000);
+    std::iota(data.begin(), data.end(), 1);
+    long expect = (long)data.size() * ((long)data.size() + 1) / 2;
+    CHECK(parallelReduce(pool, data.begin(), data.end(), 0L) == expect);
+    CHECK(parallelReduce(pool, data.begin(), data.end(), 0L, std::plus<>(), 7) == expect);
+    CHECK(parallelReduce(pool, data.begin(), data.begin(), 5L) == 5);
+    CHECK(parallelReduce(pool, data.begin(), data.begin() + 1, 5L) == 6);
+    long squares = parallelTransformReduce(pool, data.begin(), data.begin() + 100, 0L, std::plus<>(),
+                                           [](long value) { return value * value; });
+    CHECK(squares == 338350);
+}
+
+void scan()
+{
+    ThreadPool pool;
+    pool.start(2);
+    for(size_t size : {size_t(0), size_t(1), size_t(7), size_t(10000)})
+    {
+        std::vector<int> data(size);
+        for(size_t i=0;i<size;i++)
+        {
+            data[i] = (int)(i % 13) - 6;
+        }
+        std::vector<int> expect(size);
+        std::inclusive_scan(data.begin(), data.end(), expect.begin());
+        for(size_t grain : {size_t(0), size_t(1), size_t(64)})
+        {
+            std::vector<int> out(size, 0);
+            auto end = parallelInclusiveScan(pool, data.begin(), data.end(), out.begin(), std::plus<>(), grain);
+            CHECK(end == out.end());
+            CHECK(out == expect);
+        }
+    }
+}
+
+void parallel()
+{
+    forEach();
+    reduce();
+    scan();
+}
+} // namespace
+
+TEST_REGISTER("parallel", parallel);
@@ -0,0 +1,84 @@
+#include <mutex>
+#include <vector>
+
+#include "tests/check.h"
+
+// 优先级：线程占住时排着的任务按优先级出队；老化：等得够久的低优先级任务隔几个就能出一次
+namespace
+{
+void order()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::mutex mtx;
+    std::vector<int> ran;
+    auto record = [&](int id)
+    {
+        return [&, id]()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ran.push_back(id);
+        };
+    };
+    pool.post(record(2), TaskPriority::PRIORITY_LOW);
+    pool.post(record(1), TaskPriority::PRIORITY_NORMAL);
+    pool.post(record(0), TaskPriority::PRIORITY_HIGH);
+    Future<void> last = pool.submit(TaskOptions{TaskPriority::PRIORITY_LOW}, record(3));
+    gate.open();
+    last.get();
+    CHECK((ran == std::vector<int>{0, 1, 2, 3}));
+}
+
+// 直接测MultiLevelQueue：队头的入队时间决定有没有老化
+void aging()
+{
+    std::vector<int> ran;
+    auto item = [&ran](int id, uint64_t enqueueNs)
+    {
+        TaskItem task([&ran, id]() { ran.push_back(id); });
+        task.enqueueNs_ = enqueueNs;
+        return task;
+    };
+    auto drain = [&ran](MultiLevelQueue& que)
+    {
+        ran.clear();
+        while(TaskItem task = que.pop())
+        {
+            task.func_();
+        }
+    };
+
+    MultiLevelQueue fresh;
+    fresh.setAging(uint64_t(60) * 1000 * 1000 * 1000);
+    uint64_t now = steadyNowNs();
+    fresh.push(item(9, now), TaskPriority::PRIORITY_LOW);
+    for(int i=0;i<6;i++)
+    {
+        fresh.push(item(i, now), TaskPriority::PRIORITY_HIGH);
+    }
+    drain(fresh);
+    CHECK((ran == std::vector<int>{0, 1, 2, 3, 4, 5, 9}));
+
+    // 低优先级等了很久：连续跳过3次以后必须出一次
+    MultiLevelQueue aged;
+    aged.setAging(1000);
+    aged.push(item(9, 1), TaskPriority::PRIORITY_LOW);
+    for(int i=0;i<6;i++)
+    {
+        aged.push(item(i, steadyNowNs()), TaskPriority::PRIORITY_HIGH);
+    }
+    drain(aged);
+    CHECK((ran == std::vector<int>{0, 1, 2, 9, 3, 4, 5}));
+    CHECK(aged.empty());
+}
+
+void priority()
+{
+    order();
+    aging();
+}
+} // namespace
+
+TEST_REGISTER("priority", priority);
@@ -0,0 +1,50 @@
+#include <atomic>
+
+#include "tests/check.h"
+
+// 无锁环形队列模式：start之前排的任务比环形队列还多，以及容量向上取整以后阈值仍然精确
+namespace
+{
+void backlog()
+{
+    ThreadPool pool;
+    pool.setQueueMode(QueueMode::MODE_RING);
+    std::atomic_int ran{0};
+    const int tasks = 70000;// 比环形队列的最大容量(65536)多
+    for(int i=0;i<tasks;i++)
+    {
+        pool.post([&ran]() { ran++; });
+    }
+    pool.start(2);
+    CHECK(pool.shutdown(ShutdownMode::SHUTDOWN_DRAIN).empty());
+    CHECK(ran == tasks);
+}
+
+void threshold()
+{
+    ThreadPool pool;
+    pool.setQueueMode(QueueMode::MODE_RING);
+    pool.setTaskQueMaxThreshHold(5);// 环形队列容量是8
+    pool.setOverflowPolicy(OverflowPolicy::OVERFLOW_FAIL);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    int accepted = 0;
+    for(int i=0;i<20;i++)
+    {
+        accepted += pool.post([]() {}) ? 1 : 0;
+    }
+    CHECK(accepted == 5);
+    gate.open();
+    CHECK(check::eventually([&]() { return pool.stats().queueDepth == 0; }));
+    CHECK(pool.post([]() {}));
+}
+
+void ring()
+{
+    backlog();
+    threshold();
+}
+} // namespace
+
+TEST_REGISTER("ring", ring);
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include "tests/check.h"
+
+// shutdown的三种方式各自返回什么、执行了什么，以及之后重新start
+namespace
+{
+void drain()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::atomic_int ran{0};
+    for(int i=0;i<50;i++)
+    {
+        pool.post([&ran]() { ran++; });
+    }
+    CHECK(pool.shutdown(ShutdownMode::SHUTDOWN_DRAIN).empty());
+    CHECK(ran == 50);
+    CHECK(pool.getThreadSize() == 0);
+}
+
+void discard()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::atomic_int ran{0};
+    std::vector<Future<void>> futures;
+    for(int i=0;i<5;i++)
+    {
+        futures.push_back(pool.submit([&ran]() { ran++; }));
+    }
+    std::thread opener = gate.openAfter(std::chrono::milliseconds(20));
+    std::vector<TaskItem> pending = pool.shutdown(ShutdownMode::SHUTDOWN_DISCARD);
+    opener.join();
+    CHECK(pending.size() == 5);
+    CHECK(ran == 0);
+    for(TaskItem& task : pending)
+    {
+        ThreadPool::discardTask(std::move(task));
+    }
+    for(Future<void>& future : futures)
+    {
+        CHECK(future.waitFor(std::chrono::milliseconds(0)) == WaitStatus::CANCELLED);
+    }
+}
+
+// 到deadline线程还卡着，排队的任务原样返回
+void deadline()
+{
+    ThreadPool pool;
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    std::atomic_int ran{0};
+    for(int i=0;i<5;i++)
+    {
+        pool.post([&ran]() { ran++; });
+    }
+    std::thread opener = gate.openAfter(std::chrono::milliseconds(50));
+    auto begin = check::Clock::now();
+    std::vector<TaskItem> pending = pool.shutdown(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+    opener.join();
+    CHECK(check::elapsedMs(begin) >= 40);// 手上的任务总会执行完，join要等它
+    CHECK(pending.size() == 5);
+    CHECK(ran == 0);
+    for(TaskItem& task : pending)
+    {
+        task.func_();// 返回的任务可以自己执行
+    }
+    CHECK(ran == 5);
+}
+
+void restart()
+{
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING, PoolMode::MODE_CACHED})
+    {
+        ThreadPool pool;
+        pool.setMode(mode);
+        pool.start(1);
+        CHECK(pool.submit([]() { return 1; }).get() == 1);
+        pool.shutdown();
+        // 停止以后提交的任务留在队列里，重新start后执行
+        Future<int> later = pool.submit([]() { return 2; });
+        pool.start(2);
+        CHECK(later.get() == 2);
+        CHECK(pool.getThreadSize() == 2);
+    }
+}
+
+void ownThread()
+{
+    ThreadPool pool;
+    pool.start(1);
+    Future<void> future = pool.submit([&pool]() { pool.shutdown(); });
+    CHECK(check::throws<std::logic_error>([&]() { future.get(); }));
+}
+
+// 在自己线程执行的任务里析构线程池：不抛异常、不join自己，之前排队的任务由别的线程执行完
+void destroyInTask()
+{
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_CACHED, PoolMode::MODE_STEALING})
+    {
+        ThreadPool* pool = new ThreadPool;
+        pool->setMode(mode);
+        pool->start(2);
+        std::atomic_int ran{0};
+        std::atomic_bool posted{false};
+        std::atomic_bool destroyed{false};
+        for(int i=0;i<10;i++)
+        {
+            pool->post([&ran]() { ran++; });
+        }
+        pool->post([pool, &posted, &destroyed]()
+        {
+            while(!posted.load())// post返回之前提交方还在用线程池
+            {
+                std::this_thread::yield();
+            }
+            delete pool;
+            destroyed = true;
+        });
+        posted = true;
+        CHECK(check::eventually([&]() { return destroyed.load(); }));
+        CHECK(ran == 10);
+    }
+}
+
+void shutdown()
+{
+    drain();
+    discard();
+    deadline();
+    restart();
+    ownThread();
+    destroyInTask();
+}
+} // namespace
+
+TEST_REGISTER("shutdown", shutdown);
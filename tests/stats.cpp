@@ -0,0 +1,86 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tests/check.h"
+
+// 统计快照和Prometheus导出；shutdown/start以后退出的线程合成一项，计数不丢
+namespace
+{
+void counters()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::vector<Future<int>> futures;
+    for(int i=0;i<100;i++)
+    {
+        futures.push_back(pool.submit([i]() { return i; }));
+    }
+    for(auto& future : futures)
+    {
+        future.get();
+    }
+    // Future就绪以后线程才记执行完的计数
+    CHECK(check::eventually([&]() { return pool.stats().completed == 100; }));
+    PoolStats st = pool.stats();
+    CHECK(st.submitted == 100);
+    CHECK(st.completed == 100);
+    CHECK(st.rejected == 0);
+    CHECK(st.threadSize == 2);
+    CHECK(st.threadsSpawned == 2);
+    CHECK(st.threadsRetired == 0);
+    CHECK(st.workers.size() == 2);
+    CHECK(st.queueWait.count == 100);
+    CHECK(st.execTime.count == 100);
+
+    std::string text = st.toPrometheus();
+    CHECK(text.find("# TYPE threadpool_tasks_submitted_total counter\nthreadpool_tasks_submitted_total 100\n") != std::string::npos);
+    CHECK(text.find("threadpool_tasks_completed_total 100\n") != std::string::npos);
+    CHECK(text.find("threadpool_queue_wait_seconds_count 100\n") != std::string::npos);
+    CHECK(text.find("threadpool_worker_tasks_total{worker=\"") != std::string::npos);
+    CHECK(st.toPrometheus("app").find("app_threads 2\n") != std::string::npos);
+
+    // 退出的线程并成threadId为-1的一项
+    pool.shutdown();
+    pool.start(1);
+    pool.submit([]() { return 0; }).get();
+    CHECK(check::eventually([&]() { return pool.stats().completed == 101; }));
+    st = pool.stats();
+    CHECK(st.completed == 101);
+    CHECK(st.threadsSpawned == 3);
+    CHECK(st.threadsRetired == 2);
+    CHECK(st.workers.size() == 2);
+    CHECK(st.workers.back().threadId == -1);
+    CHECK(!st.workers.back().alive);
+    CHECK(st.workers.back().tasks == 100);
+    CHECK(st.execTime.count == 101);
+}
+
+void exportFile()
+{
+    ThreadPool pool;
+    pool.start(1);
+    pool.submit([]() { return 0; }).get();
+    std::string path = "threadpool_stats_test.prom";
+    CHECK(pool.exportStats(path));
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    CHECK(text.str().find("threadpool_tasks_submitted_total 1\n") != std::string::npos);
+    std::remove(path.c_str());
+
+    std::string called;
+    pool.exportStats([&called](const std::string& text) { called = text; });
+    CHECK(called.find("threadpool_threads 1\n") != std::string::npos);
+}
+
+void stats()
+{
+    counters();
+    exportFile();
+}
+} // namespace
+
+TEST_REGISTER("stats", stats);
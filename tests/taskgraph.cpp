@@ -0,0 +1,88 @@
+#include <atomic>
+#include <stdexcept>
+
+#include "taskgraph.h"
+#include "tests/check.h"
+
+// then和任务图：后继在前驱完成后才执行，异常传下去，之后的节点不再执行
+namespace
+{
+void then()
+{
+    ThreadPool pool;
+    pool.start(2);
+    Future<int> doubled = pool.submit([]() { return 21; }).then(pool, [](int value) { return value * 2; });
+    CHECK(doubled.get() == 42);
+
+    std::atomic_bool ran{false};
+    Future<void> done = pool.submit([]() {}).then(pool, [&ran]() { ran = true; });
+    done.get();
+    CHECK(ran);
+
+    // 前一个任务抛了异常，func不执行，异常到返回的Future上
+    std::atomic_bool skipped{true};
+    Future<int> failed = pool.submit([]() -> int { throw std::runtime_error("first"); })
+        .then(pool, [&skipped](int value) { skipped = false; return value; });
+    CHECK(check::throws<std::runtime_error>([&]() { failed.get(); }));
+    CHECK(skipped);
+}
+
+// 菱形：a -> b, a -> c, b -> d, c -> d，同一个图跑几遍
+void diamond()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::atomic_int clock{0};
+    int stamp[4] = {0, 0, 0, 0};
+    TaskGraph graph;
+    int a = graph.addNode([&]() { stamp[0] = ++clock; });
+    int b = graph.addNode([&]() { stamp[1] = ++clock; });
+    int c = graph.addNode([&]() { stamp[2] = ++clock; });
+    int d = graph.addNode([&]() { stamp[3] = ++clock; });
+    graph.addEdge(a, b);
+    graph.addEdge(a, c);
+    graph.addEdge(b, d);
+    graph.addEdge(c, d);
+    CHECK(graph.size() == 4);
+    for(int round=0;round<3;round++)
+    {
+        graph.run(pool).get();
+        CHECK(stamp[0] < stamp[1] && stamp[0] < stamp[2]);
+        CHECK(stamp[1] < stamp[3] && stamp[2] < stamp[3]);
+        CHECK(stamp[3] == clock);
+    }
+    CHECK(clock == 12);
+}
+
+void failures()
+{
+    ThreadPool pool;
+    pool.start(2);
+    std::atomic_bool after{false};
+    TaskGraph graph;
+    int first = graph.addNode([]() { throw std::runtime_error("node"); });
+    int second = graph.addNode([&after]() { after = true; });
+    graph.addEdge(first, second);
+    CHECK(check::throws<std::runtime_error>([&]() { graph.run(pool).get(); }));
+    CHECK(!after);
+
+    TaskGraph cycle;
+    int x = cycle.addNode([]() {});
+    int y = cycle.addNode([]() {});
+    cycle.addEdge(x, y);
+    cycle.addEdge(y, x);
+    CHECK(check::throws<std::logic_error>([&]() { cycle.run(pool); }));
+
+    TaskGraph empty;
+    empty.run(pool).get();
+}
+
+void taskgraph()
+{
+    then();
+    diamond();
+    failures();
+}
+} // namespace
+
+TEST_REGISTER("taskgraph", taskgraph);
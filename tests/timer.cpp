@@ -0,0 +1,87 @@
+#include <atomic>
+
+#include "tests/check.h"
+
+// 定时任务：不提前执行、到期前取消、周期任务取消、队列满时不拖住定时线程、shutdown返回没到期的
+namespace
+{
+void after()
+{
+    ThreadPool pool;
+    pool.start(1);
+    auto begin = check::Clock::now();
+    TimerFuture<int> future = pool.submitAfter(std::chrono::milliseconds(20), []() { return 1; });
+    CHECK(future.get() == 1);
+    CHECK(check::elapsedMs(begin) >= 20);
+    CHECK(!future.cancel());// 已经执行了
+}
+
+void cancel()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::atomic_bool ran{false};
+    TimerFuture<void> future = pool.submitAfter(std::chrono::hours(1), [&ran]() { ran = true; });
+    CHECK(future.cancel());
+    CHECK(!future.cancel());
+    CHECK(check::throws<TaskCancelled>([&]() { future.get(); }));
+    CHECK(!ran);
+}
+
+void every()
+{
+    ThreadPool pool;
+    pool.start(1);
+    std::atomic_int count{0};
+    TimerHandle handle = pool.submitEvery(std::chrono::milliseconds(2), [&count]() { count++; });
+    CHECK(check::eventually([&]() { return count.load() >= 3; }));
+    CHECK(handle.cancel());
+    CHECK(!handle.cancel());
+    int stopped = count.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(count.load() <= stopped + 1);// 取消时正在排队或者执行的那一次可能还会执行完
+}
+
+// 队列满了到期的任务按取消处理，不等队列空位(默认OVERFLOW_BLOCK要等1s)
+void queueFull()
+{
+    ThreadPool pool;
+    pool.setTaskQueMaxThreshHold(1);
+    pool.start(1);
+    check::Gate gate;
+    gate.occupy(pool);
+    CHECK(pool.post([]() {}));
+    auto begin = check::Clock::now();
+    TimerFuture<int> first = pool.submitAfter(std::chrono::milliseconds(1), []() { return 1; });
+    TimerFuture<int> second = pool.submitAfter(std::chrono::milliseconds(2), []() { return 2; });
+    CHECK(first.waitFor(std::chrono::seconds(5)) == WaitStatus::CANCELLED);
+    CHECK(second.waitFor(std::chrono::seconds(5)) == WaitStatus::CANCELLED);
+    CHECK(check::elapsedMs(begin) < 500);
+}
+
+void shutdown()
+{
+    ThreadPool pool;
+    pool.start(1);
+    TimerFuture<int> future = pool.submitAfter(std::chrono::hours(1), []() { return 1; });
+    pool.submitEvery(std::chrono::hours(1), []() {});// 周期任务不返回
+    std::vector<TaskItem> pending = pool.shutdown();
+    CHECK(pending.size() == 1);
+    for(TaskItem& task : pending)
+    {
+        ThreadPool::discardTask(std::move(task));
+    }
+    CHECK(future.waitFor(std::chrono::milliseconds(0)) == WaitStatus::CANCELLED);
+}
+
+void timer()
+{
+    after();
+    cancel();
+    every();
+    queueFull();
+    shutdown();
+}
+} // namespace
+
+TEST_REGISTER("timer", timer);
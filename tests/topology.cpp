@@ -0,0 +1,40 @@
+#include <vector>
+
+#include "topology.h"
+#include "tests/check.h"
+
+// cpulist的解析，以及读不到sysfs时退回一个节点
+namespace
+{
+void parse()
+{
+    CHECK((Topology::parseCpuList("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    CHECK((Topology::parseCpuList("5") == std::vector<int>{5}));
+    CHECK((Topology::parseCpuList("0-1,4-5\n") == std::vector<int>{0, 1, 4, 5}));// 文件里读出来带换行
+    CHECK(Topology::parseCpuList("").empty());
+    CHECK(Topology::parseCpuList("\n").empty());
+    CHECK((Topology::parseCpuList(",2,,x,3") == std::vector<int>{2, 3}));
+}
+
+void fallback()
+{
+    Topology uniform = Topology::uniform(4);
+    CHECK(uniform.nodes().size() == 1);
+    CHECK((uniform.cpus() == std::vector<int>{0, 1, 2, 3}));
+    CHECK(uniform.nodeOf(3) == 0);
+    CHECK(uniform.nodeOf(4) == -1);
+
+    Topology missing = Topology::detect("/nonexistent/sys/devices/system/node");
+    CHECK(missing.nodes().size() == 1);
+    CHECK(!missing.cpus().empty());
+    CHECK(missing.nodeOf(missing.cpus().front()) == 0);
+}
+
+void topology()
+{
+    parse();
+    fallback();
+}
+} // namespace
+
+TEST_REGISTER("topology", topology);
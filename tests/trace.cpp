@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "trace.h"
+#include "tests/check.h"
+
+// 线程退出以后它记录的事件还能导出；退出的线程留下的事件有总数上限
+namespace
+{
+const int BUFFER_SIZE = 16384; // 和trace.cpp里默认的THREADPOOL_TRACE_BUFFER_SIZE一样
+const int RETAINED_SIZE = 65536;
+
+void recordOnThread(int events)
+{
+    std::thread([events]()
+    {
+        for(int i=0;i<events;i++)
+        {
+            trace::record(trace::EventType::PARK);
+        }
+    }).join();
+}
+
+size_t countOf(const std::string& text, const std::string& what)
+{
+    size_t count = 0;
+    for(size_t pos=text.find(what);pos!=std::string::npos;pos=text.find(what, pos + 1))
+    {
+        count++;
+    }
+    return count;
+}
+
+std::string dump()
+{
+    std::string path = "threadpool_trace_test.json";
+    CHECK(trace::dumpChromeJson(path));
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::remove(path.c_str());
+    return text.str();
+}
+
+void exited()
+{
+    trace::clear();
+    for(int i=0;i<3;i++)
+    {
+        recordOnThread(10);
+    }
+    std::string text = dump();
+    CHECK(countOf(text, "\"thread_name\"") == 3);
+    CHECK(countOf(text, "\"name\":\"park\"") == 30);
+    trace::clear();
+    CHECK(countOf(dump(), "\"name\":\"park\"") == 0);
+}
+
+void bounded()
+{
+    trace::clear();
+    for(int i=0;i<RETAINED_SIZE / BUFFER_SIZE * 2;i++)
+    {
+        recordOnThread(BUFFER_SIZE);
+    }
+    std::string text = dump();
+    CHECK(countOf(text, "\"thread_name\"") == (size_t)(RETAINED_SIZE / BUFFER_SIZE));
+    CHECK(countOf(text, "\"name\":\"park\"") == (size_t)RETAINED_SIZE);
+}
+
+void tracing()
+{
+    exited();
+    bounded();
+}
+} // namespace
+
+TEST_REGISTER("trace", tracing);
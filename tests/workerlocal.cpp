@@ -0,0 +1,91 @@
+#include <atomic>
+#include <set>
+
+#include "tests/check.h"
+
+// 线程的初始化/退出钩子和线程上下文：每个线程各调一次，上下文跟线程同生共死
+namespace
+{
+std::atomic_int inits{0};
+std::atomic_int exits{0};
+std::atomic_int contexts{0};
+
+struct Context
+{
+    explicit Context(int index)
+        : index_(index)
+    {
+        contexts++;
+    }
+    ~Context()
+    {
+        contexts--;
+    }
+    int index_;
+};
+
+void workerlocal()
+{
+    CHECK(ThreadPool::currentWorker() == nullptr);
+    CHECK(ThreadPool::workerContext<Context>() == nullptr);
+    for(PoolMode mode : {PoolMode::MODE_FIXED, PoolMode::MODE_STEALING})
+    {
+        inits = 0;
+        exits = 0;
+        ThreadPool pool;
+        pool.setMode(mode);
+        pool.setWorkerContext<Context>([](const WorkerInfo& worker) { return std::make_unique<Context>(worker.index); });
+        pool.setWorkerHooks([](const WorkerInfo&)
+        {
+            if(ThreadPool::workerContext<Context>() != nullptr)// 上下文在init之前建好
+                inits++;
+        },
+        [](const WorkerInfo&)
+        {
+            if(ThreadPool::workerContext<Context>() != nullptr)// 在exit之后才析构
+                exits++;
+        });
+        pool.start(2);
+
+        std::set<int> indexes;
+        std::mutex mtx;
+        std::vector<Future<bool>> futures;
+        for(int i=0;i<100;i++)
+        {
+            futures.push_back(pool.submit([&]()
+            {
+                const WorkerInfo* worker = ThreadPool::currentWorker();
+                Context* context = ThreadPool::workerContext<Context>();
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    indexes.insert(worker->index);
+                }
+                return worker->pool == &pool && context != nullptr && context->index_ == worker->index
+                    && ThreadPool::workerContext<int>() == nullptr;
+            }));
+        }
+        bool ok = true;
+        for(Future<bool>& future : futures)
+        {
+            ok = future.get() && ok;
+        }
+        CHECK(ok);
+        CHECK(*indexes.rbegin() < 2);
+        CHECK(inits == 2);
+
+        pool.shutdown();
+        CHECK(exits == 2);
+        CHECK(contexts == 0);
+
+        // 重新start，钩子还在，序号从0重新编
+        pool.start(1);
+        CHECK(pool.submit([]() { return ThreadPool::currentWorker()->index; }).get() == 0);
+        pool.shutdown();
+        CHECK(inits == 3);
+        CHECK(exits == 3);
+        CHECK(contexts == 0);
+    }
+}
+} // namespace
+
+TEST_REGISTER("workerlocal", workerlocal);
@@ -1,24 +1,73 @@
 #include "threadpool.h"
+#include "trace.h"
 #include <functional> //函数对象头文件
 #include <thread>
 #include <iostream>
+#include <climits>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cmath>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 
 /////////////////// 线程池方法的实现
 const int TASK_MAX_THRESHHOLD = INT32_MAX;//最大任务数
 const int THREAD_MAX_THRESHHOLD= 1024;//最大线程执行数
 const int THREAD_MAX_IDLE_TIME = 10;// 线程最大处于空闲的时间
+const int THREAD_CONTROL_INTERVAL_MS = 10;// cached模式控制线程的采样周期
+const double THREAD_CONTROL_ALPHA = 0.3;// EWMA平滑系数，越大越看重最新的采样
+const int TASK_RING_MAX_SIZE = 65536;// 无锁环形队列的最大容量，槽位在start时一次性分配
+const int TASK_PRIORITY_AGING_MS = 100;// 低优先级任务每排队这么久提升一级
+const int TASK_SUBMIT_TIMEOUT_MS = 1000;// 队列满了OVERFLOW_BLOCK默认最多等多久
+const int IDLE_SPIN_MIN = 64;// IDLE_SPIN自旋次数(每次一条pause)的下限和上限
+const int IDLE_SPIN_MAX = 4096;
+const int IDLE_YIELD_COUNT = 4;// 自旋完再让出CPU几次才睡眠
+const int TIMER_TICK_US = 1000;// 时间轮默认一个tick的长度
+const int TASK_HELP_MAX_DEPTH = 1024;// helpWait最多嵌套几层，再深就阻塞等，防止栈溢出
+const int TASK_HELP_WAIT_MIN_US = 50;// helpWait没有任务可执行时睡多久再看队列，连续取不到就加倍到上限
+const int TASK_HELP_WAIT_MAX_US = 2000;
+const int TASK_AGING_RATIO = 3;// 最多连续跳过老化任务的次数，老化任务至少分到1/(TASK_AGING_RATIO+1)的出队机会
 
 //线程池构造
 ThreadPool::ThreadPool()
     :initThreadSize_(0)
-    , taskSize_(0)
-    , idleThreadSize_(0)
+    , threadSizeThreshHold_(THREAD_MAX_THRESHHOLD)
     , curThreadSize_(0)
+    , idleThreadSize_(0)
+    , taskSize_(0)
     , taskQueMaxThreshHold_(TASK_MAX_THRESHHOLD)
-    , threadSizeThreshHold_(THREAD_MAX_THRESHHOLD)
     , poolMode_(PoolMode::MODE_FIXED)
     , isPoolRunning_(false)
+    , controlKicked_(false)
+    , retireThreadSize_(0)
+    , queueMode_(QueueMode::MODE_MUTEX)
+    , injectShards_(0)
+    , idlePolicy_(IdlePolicy::IDLE_PARK)
+    , timerTickNs_((uint64_t)TIMER_TICK_US * 1000)
+    , spinningThreads_(0)
+    , ringBacklog_(false)
+    , memoryResource_(SlabResource::instance())
+    , overflowPolicy_(OverflowPolicy::OVERFLOW_BLOCK)
+    , submitTimeout_(TASK_SUBMIT_TIMEOUT_MS)
+    , taskQueMaxBytes_(0)
+    , queuedBytes_(0)
+    , droppedCount_(0)
+    , callerRunsCount_(0)
+    , affinityMode_(AffinityMode::AFFINITY_NONE)
+    , contextType_(nullptr)
+    , nextWorkerIndex_(0)
+    , submittedCount_(0)
+    , rejectedCount_(0)
+    , peakTaskSize_(0)
+    , retiredStats_()
+    , exitedThreads_(0)
 {
     // std::cout<<taskQue_.size()<<std::endl;
 }
@@ -26,330 +75,2326 @@ ThreadPool::ThreadPool()
 //线程池析构
 ThreadPool::~ThreadPool()
 {   // pool对象到}后执行该析构函数
-    isPoolRunning_ = false;
-    //notEmpty_.notify_all();//把所有等任务的线程唤醒，开始抢锁-》发现线程池要结束的信息，开始自行析构各种线程
-    // 等待线程池里面所有的线程返回 有两种状态：阻塞 & 正在执行任务中
-    std::unique_lock<std::mutex> lock(taskQueMtx_);
-    notEmpty_.notify_all();//把所有等任务的线程唤醒，开始抢锁-》发现线程池要结束的信息，开始自行析构各种线程
-    exitCond_.wait(lock,[&]()->bool {return threads_.size() == 0;});//等其他线程都清空（睡着+等唤醒）
-
+    // 排队的任务全部执行完；线程都退出以后才提交进来的任务按取消处理，等待方不会一直等
+    TaskItem next;
+    if(tlsPool_ == this)
+    {
+        // 在自己线程执行的任务里析构：不能抛异常(析构函数里抛出直接terminate)，也不能join自己
+        // 当前线程在shutdown里被detach，任务返回后线程函数看到tlsOrphaned_直接退出，不再碰线程池
+        tlsOrphaned_ = true;
+        tlsPool_ = nullptr;
+        tlsStats_ = nullptr;
+        tlsQue_ = nullptr;
+        tlsIndex_ = -1;
+        tlsNode_ = -1;
+        next = std::move(tlsNextTask_);
+    }
+    std::vector<TaskItem> pending = shutdown(ShutdownMode::SHUTDOWN_DRAIN);
+    if(next)
+        pending.push_back(std::move(next));
+    for(TaskItem& task : pending)
+    {
+        discardTask(std::move(task));
+    }
 }
 
-// 设置线程池的工作模式
-void ThreadPool::setMode(PoolMode mode)
+std::vector<TaskItem> ThreadPool::shutdown(ShutdownMode mode)
 {
-    if(checkRunningState())
-        return;
-    poolMode_=mode;
+    return shutdown(mode, Deadline::max());
 }
 
-
-// 设置task任务队列上线阈值
-void ThreadPool::setTaskQueMaxThreshHold(int threshhold)
+std::vector<TaskItem> ThreadPool::shutdown(Deadline deadline)
 {
-    if(checkRunningState())
-        return;
-    taskQueMaxThreshHold_ = threshhold;
+    return shutdown(ShutdownMode::SHUTDOWN_DRAIN, deadline);
 }
 
-void ThreadPool::setThreadSizeThreshHold(int threshhold)
+std::vector<TaskItem> ThreadPool::shutdown(ShutdownMode mode, Deadline deadline)
 {
-    if(checkRunningState())
-        return;
-    if(poolMode_ == PoolMode::MODE_CACHED)//该模式下才可设置
+    if(tlsPool_ == this)
+        throw std::logic_error("can not shutdown a thread pool from its own thread.");
+    // 先停掉定时线程，之后不会再有到期的定时任务放进队列
+    std::vector<TaskItem> timed = stopTimers();
+    if(!isPoolRunning_)
     {
-        threadSizeThreshHold_ = threshhold;
+        std::vector<TaskItem> pending = takePending();
+        std::move(timed.begin(), timed.end(), std::back_inserter(pending));
+        return pending;
     }
-}
 
-// 外部给线程池提交任务  基类为Task的派生任务对象
-Result ThreadPool::submitTask(std::shared_ptr<Task> sp)
-{
-    // 获取锁
-    std::unique_lock<std::mutex> lock(taskQueMtx_);
-    // 线程的通信 等待任务队列有空余
-    //    while(taskQue_.size() == taskQueMaxThreshHold_)
-    //    {
-    //        notFull_.wait(lock);
-    //    }
-    // 线程通信等待任务队列有空余   wait(等到条件满足为止)  wait_for(等到时间段完没满足告知结果错误)  wait_until(等到某个时间点告知结果错误)
-    // 用户提交任务，你不能用wait让客户老等着，最长不能阻塞超过1s, 否则判断提交任务失败，返回
-//    std::cout<<taskQue_.size()<<std::endl;
-    if(!notFull_.wait_for(lock,std::chrono::seconds(1),
-                         [&]()->bool{return taskQue_.size() < (size_t)taskQueMaxThreshHold_;}))//条件成功，继续执行，否则阻塞返锁)
+    // 先停掉控制线程，之后线程数量不会再变
+    isPoolRunning_ = false;
+    if(controlThread_.joinable())
     {
-        //表示notFull_等待1s钟，条件依然没有满足
-        std::cerr<<"task queue is full, submit task fail."<<std::endl;
-        // return task->getResult(); // Task 里有Result，返回result，不行， 线程执行完task后，task对象被析构掉了
-        return Result(sp,false); // 14 改 17 就行？c++17前，这里返回result应该是值赋值给result返回，
+        {
+            std::lock_guard<std::mutex> lock(controlMtx_);
+            controlCond_.notify_all();
+        }
+        controlThread_.join();
     }
 
-    // 如果有空余，把任务放入任务队列中
-    taskQue_.emplace(sp);
-    taskSize_++;//记录任务数
-    // 因为新放了任务，任务队列肯定不空了，在notEmpty_上进行通知，让线程执行任务
-    notEmpty_.notify_all();
+    std::vector<TaskItem> pending;
+    if(mode == ShutdownMode::SHUTDOWN_DISCARD)
+    {
+        pending = takePending();
+    }
 
-    // cached模式 任务处理比较紧急 场景：小而快的任务 需要根据任务数量和空闲线程的数量，判断是否需要创建新的线程出来？（空闲线程<任务）
-    if(poolMode_ == PoolMode::MODE_CACHED // 判断是cached模式
-      && taskSize_ > idleThreadSize_      // 判断任务队列里任务数 > 线程空闲数，空闲线程不够
-      && curThreadSize_< threadSizeThreshHold_) // 判断目前运行线程数 < 设置的线程阈值
+    std::unordered_map<int, std::unique_ptr<Thread>> threads;
     {
-        std::cout<<" >>> create new thread..."<<std::endl;
-        // 创建新线程对象
-//        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this));
-//        threads_.emplace_back(std::move(ptr));//unique_ptr指针只能指一个该对象，这里通过move转移到形参上接着指
-        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1));
-        int threadId = ptr->getId();
-        threads_.emplace(threadId, std::move(ptr));
-        // 启动线程
-        threads_[threadId]->start();
-        // 修改线程个数相关的变量
-        curThreadSize_++;
-        idleThreadSize_++;
+        // 把所有等任务的线程唤醒，它们发现线程池要结束，做完排队的任务就自己退出
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        notEmpty_.notify_all();
+        idleEvent_.notifyAll();
+        if(deadline != Deadline::max()
+           && !exitCond_.wait_until(lock, deadline, [&]()->bool {return curThreadSize_ == 0;}))
+        {
+            // 到时间了还没做完，剩下的不做了；线程做完手上的任务就会退出
+            lock.unlock();
+            std::vector<TaskItem> rest = takePending();
+            std::move(rest.begin(), rest.end(), std::back_inserter(pending));
+            lock.lock();
+        }
+        threads.swap(threads_);
+    }
+    // 直接join，不用在条件变量上等线程一个个把自己从列表里删掉
+    for(auto& item : threads)
+    {
+        item.second->join();
     }
+    threads.clear();
+    joinRetiredThreads();
 
-    // 返回任务的Result对象
-    return Result(sp);
+    // 线程都退出以后还留在队列里的(停止过程中才提交进来的)
+    std::vector<TaskItem> rest = takePending();
+    std::move(rest.begin(), rest.end(), std::back_inserter(pending));
+    std::move(timed.begin(), timed.end(), std::back_inserter(pending));
+    return pending;
 }
 
-// 开启线程池
-void ThreadPool::start(int initThreadSize)
+TimerHandle ThreadPool::scheduleTimer(Deadline time, std::chrono::nanoseconds period, TaskFunc func)
 {
-    // 设置线程池的运行状态
-    isPoolRunning_ = true;
-
-    // 记录初始线程个数
-    initThreadSize_ = initThreadSize;
-    curThreadSize_ = initThreadSize;//当前有多少线程运行
+    uint64_t atNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(timerMtx_);
+    if(timers_ == nullptr)
+    {
+        timers_ = std::make_shared<TimerService>(timerTickNs_,
+            [this](TimerService& service, std::vector<std::shared_ptr<TimerNode>>& due) { dispatchTimers(service, due); });
+    }
+    std::shared_ptr<TimerNode> node = timers_->schedule(atNs, std::max<int64_t>(period.count(), 0), std::move(func));
+    return TimerHandle(timers_, std::move(node));
+}
 
-    // 创建线程对象
-    for(int i=0;i<initThreadSize_;i++)
+void ThreadPool::dispatchTimers(TimerService& service, std::vector<std::shared_ptr<TimerNode>>& due)
+{
+    uint64_t now = steadyNowNs();
+    std::vector<TaskItem> items;
+    items.reserve(due.size());
+    for(auto& node : due)
     {
-        // 创建thread线程对象的时候，把线程函数给到thread线程对象
-        //threads_.emplace_back(new Thread(std::bind(&ThreadPool::threadFunc,this)));
-        //std::bind函数的作用是将一个可调用对象（如函数、成员函数、函数对象等）与一组参数绑定在一起，
-        // 返回一个新的函数对象。这个新的函数对象可以延迟执行，直到后续调用时再进行实际执行。
-        // 对上面代码的替代
-        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this,std::placeholders::_1));
-        int threadId = ptr->getId();
-        threads_.emplace(threadId, std::move(ptr));
-        //threads_.emplace_back();//unique_ptr指针只能指一个该对象，这里通过move转移到形参上接着指
+        if(node->period_ == 0)
+        {
+            items.emplace_back(std::move(node->func_));
+        }
+        else
+        {
+            // 周期任务每次到期放一个小任务进队列，执行完再挂回时间轮；这一次被丢掉(队列满、shutdown)就跳过这一次
+            std::weak_ptr<TimerService> timers = service.weak_from_this();
+            items.emplace_back(TaskFunc([timers, node]()
+            {
+                if(!takeDiscard())
+                    node->func_();
+                if(std::shared_ptr<TimerService> service = timers.lock())
+                    service->rearm(node);
+            }));
+        }
+        items.back().enqueueNs_ = now;
+        TP_TRACE(ENQUEUE, now);
     }
-    //std::cout<<taskQue_.size()<<std::endl;
-    // 启动所有线程 std::vector<Thread*> threads_;
-    for(int i=0;i<initThreadSize_;i++)
+    // 定时线程不能等队列空位，等的这段时间后面到期的定时任务都会跟着晚；放不下的按取消处理
+    size_t accepted = enqueueBatch(items.data(), items.size(), TaskPriority::PRIORITY_NORMAL, OverflowPolicy::OVERFLOW_FAIL);
+    submittedCount_ += accepted;
+    rejectedCount_ += items.size() - accepted;
+    updatePeakTaskSize();
+    for(size_t i=accepted;i<items.size();i++)
     {
-        threads_[i]->start();
-        idleThreadSize_++; // 每开启一个线程，一开始都是空闲线程，空闲线程数+1
+        discardTask(std::move(items[i]));
     }
 }
 
-// 定义线程函数
-void ThreadPool::threadFunc(int threadid)
+std::vector<TaskItem> ThreadPool::stopTimers()
 {
-    auto lastTime = std::chrono::high_resolution_clock().now();//上一次本线程执行完的时间
+    std::shared_ptr<TimerService> timers;
+    {
+        std::lock_guard<std::mutex> lock(timerMtx_);
+        timers.swap(timers_);
+    }
+    std::vector<TaskItem> pending;
+    if(timers == nullptr)
+        return pending;
+    for(auto& node : timers->stop())// 在锁外等定时线程退出，它可能正在dispatchTimers里
+    {
+        pending.emplace_back(std::move(node->func_));
+    }
+    return pending;
+}
 
-    // 等所有任务必须执行完成，线程池才可以回收所有线程资源
-    //while(isPoolRunning_) // 每个线程函数都在不停的要任务来做
-    for(;;)
+std::vector<TaskItem> ThreadPool::takePending()
+{
+    std::vector<TaskItem> pending;
+    // 本地队列不限长度，放进去时没有算字节数，取出来也不减
+    auto takeAll = [&](WorkQueue& que, bool counted)
     {
-        std::shared_ptr<Task> task;//多态的父类
+        std::lock_guard<std::mutex> lock(que.mtx_);
+        while(!que.deque_.empty())
         {
-            //先获取锁
-            std::unique_lock<std::mutex> lock(taskQueMtx_);
-            std::cout<<"tid"<<std::this_thread::get_id()
-            <<"尝试获取任务..."<<std::endl;
-
-            // cached模式下，有可能已经创建了很多的线程，但是空闲时间超过60s,应该把多余的线程结束回收掉
-            // 超过initThreadSize_数量的线程要进行回收
-            // 当前时间 - 上一次线程执行的时间 > 60s
-            // 锁+双重判断
-            //while(isPoolRunning_ && taskQue_.size()==0) 为了让任务可以执行完，isPoolRunning_条件删除
-            while(taskQue_.size()==0)// 任务队列没任务，看看是否自己多余了
-            {
-                if(!isPoolRunning_)//执行完任务，没任务了，进到这里面析构线程
-                {
-                    threads_.erase(threadid); // 清空线程vector中的对象
-                    std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
-                             << std::endl;
-                    std::cout<<threads_.size()<<std::endl;
-                    exitCond_.notify_all();//唤醒主线程pool的析构wait,看是否全走
-                    return;
-                }
-
-                if(poolMode_ == PoolMode::MODE_CACHED)//cached情况
-                {// 每一秒钟返回一次， 怎么区分：超时返回？还是有任务待执行返回
-                        // 条件变量，超时返回了
-                        if(std::cv_status::timeout ==
-                           notEmpty_.wait_for(lock,std::chrono::seconds(1)))
-                        { // 超过1s没有拿到任务，被已经有的线程拿了，说明本线程可能多余了，看加上本线程是否超过起始线程，如果多说明本线程闲
-                            auto now = std::chrono::high_resolution_clock().now();
-                            auto dur = std::chrono::duration_cast<std::chrono::seconds>(now - lastTime);
-                            if(dur.count()>=THREAD_MAX_IDLE_TIME
-                               && curThreadSize_ > initThreadSize_)//闲了60s且不再起始线程数中
-                            {
-                                // 开始回收当前线程
-                                // 记录线程数量的相关变量的值修改
-                                // 把线程对象从线程列表容器中删除 没办法 threadFunc 中找到对应vector的哪一个线程位置-》改用map,创建线程号为key方便查找
-                                // threadid => thread对象 => 删除
-                                threads_.erase(threadid); // 清空线程vector中的对象
-                                curThreadSize_--;//现有线程-1
-                                idleThreadSize_--;//空闲线程-1
-
-                                std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
-                                         << std::endl;
-                                return;
-                            }
-                        }
-                }
-                else//fix情况
-                {
-                    //等待notEmpty条件
-                    notEmpty_.wait(lock);//线程队列等不到就一直等任务
-                }
-                // 线程池要结束，回收线程资源
-//                if(!isPoolRunning_)//看唤醒两种情况的是不是要结束主线程的析构
-//                {
-//                    // 回收当前线程
-//                    threads_.erase(threadid); // 清空线程vector中的对象
-//                    std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
-//                             << std::endl;
-//                    std::cout<<threads_.size()<<"*"<<std::endl;
-//                    exitCond_.notify_all();//唤醒主线程pool的析构wait,看是否全走完
-//                    return;
-//                }
-            }
-
-            // 有任务的情况下，跳到这里，为了要让任务执行完，跳过isPoolRunning_判断条件
-            /*
-            // 线程结束，回收资源
-            if(!isPoolRunning_)
-            {
-                break;
-            }*/
-
-            idleThreadSize_--;//任务队列有任务，则本线程会处理下面弄到的任务，本线程不再闲，闲数-1
-            std::cout<<"tid"<<std::this_thread::get_id()
-                     <<"获取任务成功..."<<std::endl;
-
-            // 从任务队列取一个任务出来
-            task = taskQue_.front();//子类给父类
-            taskQue_.pop();//拿走任务
+            pending.push_back(que.deque_.popFront());
             taskSize_--;
-
-            // 如果依然有剩余任务，继续通知其它的线程执行任务
-            if(taskQue_.size() > 0)
-            {
-                notEmpty_.notify_all();
-            }
-
-            // 取出一个任务，进行通知，通知submitTask可以继续提交生产任务
-            notFull_.notify_all();
-        }//把锁释放掉，自己执行拿到的任务即可，无需拿着任务队列的锁
-
-        // 当前线程负责执行这个任务
-        if(task != nullptr)
+            if(counted)
+                releaseBytes(pending.back());
+        }
+    };
+    for(auto& que : localQues_)
+    {
+        takeAll(*que, false);
+    }
+    for(auto& que : nodeQues_)
+    {
+        takeAll(*que, true);
+    }
+    if(taskRing_ != nullptr)
+    {
+        for(TaskItem task = popGlobalTask();task;task = popGlobalTask())
         {
-            //task->run(); 这只是执行任务，现在把任务结果返回
-            task->exec();
+            pending.push_back(std::move(task));
         }
-        idleThreadSize_++;//本线程处理完取的任务再次闲下来，闲+1
-        lastTime = std::chrono::high_resolution_clock().now();// 更新线程执行完任务的时间，本线程开始空闲
     }
-    /* 改了以后，为了让其执行完，没有跳出for循环的语句，把下面析构本线程的语句上移到发现任务为0的地方进行析构
-    // 析构结束时，在执行的本线程回到循环while发现要析构了，跳出循环到这，开始析构本线程
-    threads_.erase(threadid); // 清空线程vector中的对象
-    std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
-             << std::endl;
-    std::cout<<threads_.size()<<std::endl;
-    exitCond_.notify_all();//唤醒主线程pool的析构wait,看是否全走
-     */
+    std::lock_guard<std::mutex> lock(taskQueMtx_);
+    while(!taskQue_.empty())
+    {
+        pending.push_back(taskQue_.pop());
+        taskSize_--;
+        releaseBytes(pending.back());
+    }
+    notFull_.notify_all();
+    notFullEvent_.notifyAll();
+    return pending;
 }
 
-// 检查pool的运行状态
-bool ThreadPool::checkRunningState() const
+void ThreadPool::joinRetiredThreads()
 {
-    return isPoolRunning_;
+    std::vector<std::unique_ptr<Thread>> retired;
+    {
+        std::lock_guard<std::mutex> lock(taskQueMtx_);
+        retired.swap(retiredThreads_);
+    }
+    retired.clear();// 析构时join，线程已经退出或者马上退出
 }
 
-//////////////// 线程方法的实现
-// 线程类静态成员变量在类外初始化
-int Thread::generateId_=0;
-
-//线程构造
-Thread::Thread(ThreadFunc func)//接收一个函数
-    :func_(func)
-    , threadId_(generateId_++)//给线程对象赋个编号值以区分
+// 设置线程池的工作模式
+void ThreadPool::setMode(PoolMode mode)
 {
-
+    if(checkRunningState())
+        return;
+    poolMode_=mode;
 }
-//线程析构
-Thread::~Thread()
+
+
+// 设置task任务队列上线阈值
+void ThreadPool::setTaskQueMaxThreshHold(int threshhold)
 {
+    if(checkRunningState())
+        return;
+    taskQueMaxThreshHold_ = threshhold;
+}
 
+void ThreadPool::setTaskQueMaxThreshHold(TaskPriority priority, int threshhold)
+{
+    if(checkRunningState())
+        return;
+    taskQue_.setLimit(priority, threshhold);
 }
 
-// 启动线程
-void Thread::start()
+void ThreadPool::setTaskPriorityAging(int ms)
 {
-    // 创建一个线程来执行一个线程函数
-    std::thread t(func_, threadId_);// linux中的 pthread_detach 如下
-    t.detach();//c++11 中线程对象出了函数}就自动析构了，所以设置分离函数，让其自己归属内核管理不析构继续执行
+    if(checkRunningState())
+        return;
+    taskQue_.setAging((uint64_t)ms * 1000000);
 }
 
-int Thread::getId() const
+void ThreadPool::setQueueMode(QueueMode mode)
 {
-    return threadId_;
+    if(checkRunningState())
+        return;
+    queueMode_ = mode;
 }
 
-///////////// Task方法实现
-Task::Task()
-    : result_(nullptr)
+void ThreadPool::setInjectShards(int shards)
 {
+    if(checkRunningState())
+        return;
+    injectShards_ = std::max(shards, 0);
+}
 
+void ThreadPool::setIdlePolicy(IdlePolicy policy)
+{
+    if(checkRunningState())
+        return;
+    idlePolicy_ = policy;
 }
 
-Task::~Task()
+void ThreadPool::setTimerResolution(int us)
 {
+    if(checkRunningState())
+        return;
+    timerTickNs_ = (uint64_t)std::max(us, 1) * 1000;
+}
 
+void ThreadPool::setOverflowPolicy(OverflowPolicy policy)
+{
+    if(checkRunningState())
+        return;
+    overflowPolicy_ = policy;
 }
 
-void Task::exec() //要解决一个问题，即线程执行结果后，给result类对象，而且task对象析构还要保证result对象在
+void ThreadPool::setSubmitTimeout(int ms)
 {
-    if(result_!= nullptr)
-    {
-        result_->setVal(run());//调用那个接收对象指针，来接收run的结果
-    }
+    if(checkRunningState())
+        return;
+    submitTimeout_ = std::chrono::milliseconds(std::max(ms, 0));
 }
 
-void Task::setResult(Result* res)// 传外面存结果的指针
+void ThreadPool::setTaskQueMaxBytes(size_t bytes)
 {
-    result_=res;
+    if(checkRunningState())
+        return;
+    taskQueMaxBytes_ = bytes;
 }
 
-/////////////  Result方法的实现
-Result::Result(std::shared_ptr<Task> task, bool isValid)
-        :task_(task)
-        ,isValid_(isValid)
+void ThreadPool::setMemoryResource(std::pmr::memory_resource* resource)
 {
-    task_->setResult(this);// 把result对象自己穿进去接结果
+    if(checkRunningState())
+        return;
+    memoryResource_ = resource == nullptr ? SlabResource::instance() : resource;
 }
 
-Any Result::get()// task外的接收结果
+void ThreadPool::setThreadSizeThreshHold(int threshhold)
 {
-    if(!isValid_)//如果任务提交失败，线程函数返回值无效，直接返回空
+    if(checkRunningState())
+        return;
+    if(poolMode_ == PoolMode::MODE_CACHED)//该模式下才可设置
     {
-        return "";
+        threadSizeThreshHold_ = threshhold;
     }
+}
+
+void ThreadPool::setAffinity(AffinityMode mode)
+{
+    if(checkRunningState())
+        return;
+    affinityMode_ = mode;
+}
 
-    sem_.wait(); // task任务如果没有执行完，这里会阻塞用户的线程
-    return std::move(any_);
+void ThreadPool::setCpuSet(std::vector<int> cpus)
+{
+    if(checkRunningState())
+        return;
+    cpuSet_ = std::move(cpus);
 }
 
-void Result::setVal(Any any)//task结束中介result拿到结果，告知用户可通过本result接收了
+void ThreadPool::setTopology(Topology topology)
 {
-    // 存储task的返回值
-    this->any_ = std::move(any);
-    sem_.post(); // 已经获取了任务的返回值，增加信号量资源
-}
\ No newline at end of file
+    if(checkRunningState())
+        return;
+    topology_ = std::move(topology);
+}
+
+void ThreadPool::setWorkerHooks(std::function<void(const WorkerInfo&)> init, std::function<void(const WorkerInfo&)> exit)
+{
+    if(checkRunningState())
+        return;
+    workerInit_ = std::move(init);
+    workerExit_ = std::move(exit);
+}
+
+void ThreadPool::setContextFactory(const std::type_info& type, std::function<std::shared_ptr<void>(const WorkerInfo&)> factory)
+{
+    if(checkRunningState())
+        return;
+    contextFactory_ = std::move(factory);
+    contextType_ = &type;
+}
+
+const WorkerInfo* ThreadPool::currentWorker()
+{
+    return tlsWorker_ == nullptr ? nullptr : &tlsWorker_->info_;
+}
+
+// 外部给线程池提交任务  基类为Task的派生任务对象
+Result ThreadPool::submitTask(std::shared_ptr<Task> sp, TaskPriority priority)
+{
+    sp->done_.reset();// 同一个任务对象可以再次提交，清掉上一次的完成标志
+    bool isValid = pushTask(wrapTask(sp), priority);
+    return Result(sp, isValid); // 14 改 17 就行？c++17前，这里返回result应该是值赋值给result返回，
+}
+
+Result ThreadPool::trySubmitTask(std::shared_ptr<Task> sp, TaskPriority priority)
+{
+    sp->done_.reset();
+    bool isValid = pushTask(wrapTask(sp), priority, OverflowPolicy::OVERFLOW_FAIL);
+    return Result(sp, isValid);
+}
+
+// 把任务放进队列，失败（队列满）返回false；submitTask和submit共用
+bool ThreadPool::pushTask(TaskItem task, TaskPriority priority)
+{
+    return pushTask(std::move(task), priority, overflowPolicy_);
+}
+
+bool ThreadPool::pushTask(TaskItem task, TaskPriority priority, OverflowPolicy policy)
+{
+    task.enqueueNs_ = steadyNowNs();
+    TP_TRACE(ENQUEUE, task.enqueueNs_);
+    std::vector<TaskItem> dropped;
+    bool pushed = enqueueTask(std::move(task), priority, policy, dropped);// 放不进去时task还在
+    for(TaskItem& item : dropped)
+    {
+        droppedCount_++;
+        discardTask(std::move(item));
+    }
+    if(!pushed)
+    {
+        if(policy == OverflowPolicy::OVERFLOW_CALLER_RUNS)
+        {
+            callerRunsCount_++;
+            task.func_();
+            return true;
+        }
+        rejectedCount_++;
+        return false;
+    }
+    submittedCount_++;
+    updatePeakTaskSize();
+    return true;
+}
+
+TaskItem ThreadPool::wrapTask(std::shared_ptr<TaskBase> sp)
+{
+    // 只存一个共享指针，放得进内部缓冲区
+    return TaskItem([sp = std::move(sp)]()
+    {
+        if(takeDiscard())
+            sp->discard();
+        else
+            sp->exec();
+    });
+}
+
+void ThreadPool::discardTask(TaskItem task)
+{
+    tlsDiscard_ = true;
+    task.func_();
+    tlsDiscard_ = false;// 不认识这个标记的内部任务不会清掉它
+}
+
+bool ThreadPool::takeDiscard()
+{
+    bool discard = tlsDiscard_;
+    tlsDiscard_ = false;
+    return discard;
+}
+
+size_t ThreadPool::taskBytes(const TaskItem& task)
+{
+    return sizeof(TaskItem) + task.func_.heapBytes();
+}
+
+bool ThreadPool::bytesFit(size_t bytes) const
+{
+    if(taskQueMaxBytes_ == 0)
+        return true;
+    int64_t queued = queuedBytes_.load(std::memory_order_relaxed);
+    return queued <= 0 || (size_t)queued + bytes <= taskQueMaxBytes_;// 单个任务比限制还大时，队列空着也能放
+}
+
+void ThreadPool::reserveBytes(const TaskItem& task)
+{
+    if(taskQueMaxBytes_ != 0)
+        queuedBytes_.fetch_add(taskBytes(task), std::memory_order_relaxed);
+}
+
+void ThreadPool::releaseBytes(const TaskItem& task)
+{
+    if(taskQueMaxBytes_ != 0)
+        queuedBytes_.fetch_sub(taskBytes(task), std::memory_order_relaxed);
+}
+
+bool ThreadPool::reserveRingSlot()
+{
+    if(taskSize_.fetch_add(1) < taskQueMaxThreshHold_)
+        return true;
+    taskSize_--;
+    return false;
+}
+
+// 队列满了按policy处理：等(OVERFLOW_BLOCK最多等submitTimeout_)、挤掉最早的，还是放不进去返回false
+bool ThreadPool::enqueueTask(TaskItem&& task, TaskPriority priority, OverflowPolicy policy, std::vector<TaskItem>& dropped)
+{    // 工作窃取模式下，池内线程提交的任务（任务里再拆出来的子任务）直接放进自己的本地队列，不碰全局锁
+    if(poolMode_ == PoolMode::MODE_STEALING && tlsPool_ == this)
+    {
+        {
+            std::lock_guard<std::mutex> lock(tlsQue_->mtx_);
+            tlsQue_->deque_.pushBack(std::move(task));
+            taskSize_++;
+        }
+        idleEvent_.notifyOne();
+        return true;
+    }
+
+    size_t bytes = taskQueMaxBytes_ == 0 ? 0 : taskBytes(task);
+    std::chrono::milliseconds timeout = policy == OverflowPolicy::OVERFLOW_BLOCK ? submitTimeout_ : std::chrono::milliseconds(0);
+
+    // 按NUMA节点或提交线程拆了队列：放进提交方那个子队列，不碰全局锁；容量只看原子计数，满了在notFullEvent_上等
+    if(!nodeQues_.empty())
+    {
+        auto hasSpace = [&]()->bool{return taskSize_ < taskQueMaxThreshHold_ && bytesFit(bytes);};
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(!hasSpace())
+        {
+            if(policy == OverflowPolicy::OVERFLOW_DROP_OLDEST)
+            {
+                TaskItem old = popNodeTask();// 从提交方所在节点开始找排队最久的
+                if(old)
+                {
+                    dropped.push_back(std::move(old));
+                    continue;
+                }
+            }
+            if(std::chrono::steady_clock::now() >= deadline)
+            {
+                if(policy == OverflowPolicy::OVERFLOW_BLOCK)
+                    std::cerr<<"task queue is full, submit task fail."<<std::endl;
+                return false;
+            }
+            waitNotFull(hasSpace, deadline);
+        }
+        reserveBytes(task);
+        WorkQueue& que = *nodeQues_[submitNode()];
+        {
+            std::lock_guard<std::mutex> lock(que.mtx_);
+            que.deque_.pushBack(std::move(task));
+            taskSize_++;
+        }
+        idleEvent_.notifyOne();
+        return true;
+    }
+
+    // 无锁队列：满了在notFullEvent_上等，整个过程不加锁
+    if(taskRing_ != nullptr)
+    {
+        auto hasSpace = [&]()->bool{return taskSize_ < taskQueMaxThreshHold_ && bytesFit(bytes);};
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for(;;)
+        {
+            if(bytesFit(bytes) && reserveRingSlot())
+            {
+                if(taskRing_->push(std::move(task)))// 放不进去时不会移走task
+                    break;
+                taskSize_--;
+            }
+            if(policy == OverflowPolicy::OVERFLOW_DROP_OLDEST)
+            {
+                TaskItem old = popGlobalTask();
+                if(old)
+                {
+                    dropped.push_back(std::move(old));
+                    continue;
+                }
+            }
+            if(std::chrono::steady_clock::now() >= deadline)
+            {
+                if(policy == OverflowPolicy::OVERFLOW_BLOCK)
+                    std::cerr<<"task queue is full, submit task fail."<<std::endl;
+                return false;
+            }
+            waitNotFull(hasSpace, deadline);
+        }
+        if(bytes != 0)
+            queuedBytes_.fetch_add(bytes, std::memory_order_relaxed);// 可能已经被取走了，计数短暂为负
+        // 计数在放任务之前就加上了，放完再通知，和workThreadFunc里的 prepareWait -> 检查taskSize_ 配对
+        idleEvent_.notifyOne();
+        return true;
+    }
+
+    // 获取锁
+    std::unique_lock<std::mutex> lock(taskQueMtx_);
+    // 线程的通信 等待任务队列有空余
+    //    while(taskQue_.size() == taskQueMaxThreshHold_)
+    //    {
+    //        notFull_.wait(lock);
+    //    }
+    // 线程通信等待任务队列有空余   wait(等到条件满足为止)  wait_for(等到时间段完没满足告知结果错误)  wait_until(等到某个时间点告知结果错误)
+    // 用户提交任务，你不能用wait让客户老等着，最长不能阻塞超过1s, 否则判断提交任务失败，返回
+//    std::cout<<taskQue_.size()<<std::endl;
+    // 总数、这个优先级自己的上限和内存限制都要满足
+    auto hasSpace = [&]()->bool{return taskQue_.size() < (size_t)taskQueMaxThreshHold_
+                                    && taskQue_.size(priority) < taskQue_.limit(priority)
+                                    && bytesFit(bytes);};
+    if(policy == OverflowPolicy::OVERFLOW_DROP_OLDEST)
+    {
+        while(!hasSpace())
+        {
+            TaskItem old = taskQue_.dropOldest(priority);
+            if(!old)
+                break;
+            taskSize_--;
+            releaseBytes(old);
+            dropped.push_back(std::move(old));
+        }
+    }
+    if(!notFull_.wait_for(lock,timeout,hasSpace))//条件成功，继续执行，否则阻塞返锁)
+    {
+        //表示notFull_等待timeout，条件依然没有满足
+        if(policy == OverflowPolicy::OVERFLOW_BLOCK)
+            std::cerr<<"task queue is full, submit task fail."<<std::endl;
+        // return task->getResult(); // Task 里有Result，返回result，不行， 线程执行完task后，task对象被析构掉了
+        return false;
+    }
+
+    // 如果有空余，把任务放入任务队列中
+    reserveBytes(task);
+    taskQue_.push(std::move(task), priority);
+    taskSize_++;//记录任务数
+    // 因为新放了任务，任务队列肯定不空了，在notEmpty_上进行通知，让线程执行任务
+    if(poolMode_ == PoolMode::MODE_STEALING)
+    {
+        idleEvent_.notifyOne();// 只叫醒一个睡着的线程，其他醒着的线程会自己来偷
+    }
+    else
+    {
+        notEmpty_.notify_one();// 一个任务叫醒一个线程就够了，取走任务的线程发现还有剩下的会接着叫下一个
+    }
+
+    kickController();
+    return true;
+}
+
+size_t ThreadPool::pushBatch(const std::shared_ptr<Task>* tasks, size_t size, TaskPriority priority)
+{
+    uint64_t now = steadyNowNs();
+    std::vector<TaskItem> items(size);
+    for(size_t i=0;i<size;i++)
+    {
+        items[i] = wrapTask(tasks[i]);
+        items[i].enqueueNs_ = now;
+        TP_TRACE(ENQUEUE, now);
+    }
+    size_t accepted = enqueueBatch(items.data(), size, priority, overflowPolicy_);
+    if(overflowPolicy_ == OverflowPolicy::OVERFLOW_CALLER_RUNS)
+    {
+        // 放不下的在提交方执行，整批都算成功
+        callerRunsCount_ += size - accepted;
+        for(size_t i=accepted;i<size;i++)
+        {
+            items[i].func_();
+        }
+        accepted = size;
+    }
+    submittedCount_ += accepted;
+    rejectedCount_ += size - accepted;
+    updatePeakTaskSize();
+    return accepted;
+}
+
+// 一批任务只加一次锁：先等一次能放下整批的空位，再全部入队，最后按需唤醒线程
+// 只按个数限制(分片队列和单个提交一样也看内存限制)；只有OVERFLOW_BLOCK会等，其他策略放不下的部分马上算失败(OVERFLOW_DROP_OLDEST也不挤别的任务)
+size_t ThreadPool::enqueueBatch(TaskItem* tasks, size_t size, TaskPriority priority, OverflowPolicy policy)
+{
+    if(size == 0)
+        return 0;
+    bool block = policy == OverflowPolicy::OVERFLOW_BLOCK;
+    std::chrono::milliseconds timeout = block ? submitTimeout_ : std::chrono::milliseconds(0);
+
+    size_t accepted = 0;
+    size_t woken = 0; // 等空位之前已经叫醒过线程的任务数
+    if(poolMode_ == PoolMode::MODE_STEALING && tlsPool_ == this)
+    {
+        std::lock_guard<std::mutex> lock(tlsQue_->mtx_);
+        for(;accepted<size;accepted++)
+        {
+            tlsQue_->deque_.pushBack(std::move(tasks[accepted]));
+        }
+        taskSize_ += accepted;
+    }
+    else if(!nodeQues_.empty())
+    {
+        // 放进提交方所在节点的队列，个数和内存限制和单个提交一样；一次加锁放下尽量多的，满了在notFullEvent_上等到超时
+        WorkQueue& que = *nodeQues_[submitNode()];
+        auto nextFits = [&]()->bool{return taskSize_ < taskQueMaxThreshHold_
+                                        && bytesFit(taskQueMaxBytes_ == 0 ? 0 : taskBytes(tasks[accepted]));};
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        for(;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(que.mtx_);
+                for(;accepted<size && nextFits();accepted++)
+                {
+                    reserveBytes(tasks[accepted]);
+                    que.deque_.pushBack(std::move(tasks[accepted]));
+                    taskSize_++;
+                }
+            }
+            if(accepted == size)
+                break;
+            if(std::chrono::steady_clock::now() >= deadline)
+            {
+                if(block)
+                    std::cerr<<"task queue is full, submit task fail."<<std::endl;
+                break;
+            }
+            // 睡之前先叫醒线程来取已经放进去的，不然可能没人腾位置
+            idleEvent_.notify(std::min((int)(accepted - woken), (int)idleThreadSize_));
+            woken = accepted;
+            waitNotFull(nextFits, deadline);
+        }
+    }
+    else if(taskRing_ != nullptr)
+    {
+        // 环形队列没法一次预留多个槽位，逐个放，满了和单个提交一样等到超时
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while(accepted < size)
+        {
+            size_t bytes = taskQueMaxBytes_ == 0 ? 0 : taskBytes(tasks[accepted]);
+            if(reserveRingSlot())
+            {
+                if(taskRing_->push(std::move(tasks[accepted])))
+                {
+                    if(bytes != 0)
+                        queuedBytes_.fetch_add(bytes, std::memory_order_relaxed);
+                    accepted++;
+                    continue;
+                }
+                taskSize_--;
+            }
+            if(std::chrono::steady_clock::now() >= deadline)
+            {
+                if(block)
+                    std::cerr<<"task queue is full, submit task fail."<<std::endl;
+                break;
+            }
+            waitNotFull([this]()->bool{return taskSize_ < taskQueMaxThreshHold_;}, deadline);
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(taskQueMtx_);
+        // 整批超过阈值的话，等到队列空了为止，能放多少放多少；总数和这个优先级的上限取小的
+        size_t levelLimit = taskQue_.limit(priority);
+        size_t want = std::min({size, (size_t)taskQueMaxThreshHold_, levelLimit});
+        if(!notFull_.wait_for(lock,timeout,
+                              [&]()->bool{return taskQue_.size() + want <= (size_t)taskQueMaxThreshHold_
+                                              && taskQue_.size(priority) + want <= levelLimit;})
+           && block)
+        {
+            std::cerr<<"task queue is full, submit task fail."<<std::endl;
+        }
+        size_t space = std::min((size_t)taskQueMaxThreshHold_ - std::min(taskQue_.size(), (size_t)taskQueMaxThreshHold_),
+                                levelLimit - std::min(taskQue_.size(priority), levelLimit));
+        for(;accepted<size && accepted<space;accepted++)
+        {
+            reserveBytes(tasks[accepted]);
+            taskQue_.push(std::move(tasks[accepted]), priority);
+        }
+        taskSize_ += accepted;
+
+        if(poolMode_ != PoolMode::MODE_STEALING)
+        {
+            // 有几个任务就叫醒几个空闲线程，不再每个任务notify_all一次
+            int wake = std::min((int)accepted, (int)idleThreadSize_);
+            for(int i=0;i<wake;i++)
+            {
+                notEmpty_.notify_one();
+            }
+            kickController();
+            return accepted;
+        }
+    }
+
+    // workThreadFunc的线程睡在idleEvent_上，一次系统调用叫醒需要的个数
+    idleEvent_.notify(std::min((int)(accepted - woken), (int)idleThreadSize_));
+    return accepted;
+}
+
+void ThreadPool::updatePeakTaskSize()
+{
+    // 大部分时候只有一次读，超过历史最大值才需要CAS
+    int size = taskSize_;
+    int peak = peakTaskSize_.load(std::memory_order_relaxed);
+    while(size > peak && !peakTaskSize_.compare_exchange_weak(peak, size, std::memory_order_relaxed));
+}
+
+// cached模式下任务比空闲线程多了，叫醒控制线程马上看一次，而不是在提交方创建线程
+void ThreadPool::kickController()
+{
+    if(poolMode_ == PoolMode::MODE_CACHED // cached模式
+      && taskSize_ > idleThreadSize_      // 任务队列里任务数 > 线程空闲数，空闲线程不够
+      && curThreadSize_ < threadSizeThreshHold_ // 目前运行线程数 < 设置的线程阈值
+      && !controlKicked_.exchange(true)) // 控制线程处理之前只叫一次
+    {
+        controlCond_.notify_one();
+    }
+}
+
+// cached模式下新建线程，由控制线程调用
+void ThreadPool::addThread()
+{
+    Thread* thread = nullptr;
+    int threadId = 0;
+    int node = -1;
+    std::vector<int> cpus = placeWorker(curThreadSize_, node);
+    {
+        std::lock_guard<std::mutex> lock(taskQueMtx_);
+        // 创建新线程对象
+//        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::threadFunc,this));
+//        threads_.emplace_back(std::move(ptr));//unique_ptr指针只能指一个该对象，这里通过move转移到形参上接着指
+        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::workerMain,this,std::placeholders::_1,nextWorkerIndex_++,false));
+        threadId = ptr->getId();
+        thread = ptr.get();
+        thread->setAffinity(std::move(cpus));
+        threads_.emplace(threadId, std::move(ptr));
+        // 修改线程个数相关的变量
+        curThreadSize_++;
+        idleThreadSize_++;
+    }
+    // 启动线程 创建系统线程比较慢，放到锁外面；线程对象只有线程自己退出时才会删，这里的指针一直有效
+    TP_TRACE(SPAWN, threadId);
+    thread->start();
+}
+
+// 所有线程执行完的任务数
+uint64_t ThreadPool::completedTaskCount() const
+{
+    std::lock_guard<std::mutex> lock(statsMtx_);
+    uint64_t completed = retiredStats_.tasks;
+    for(auto& counters : workerStats_)
+    {
+        completed += counters->tasks_.load(std::memory_order_relaxed);
+    }
+    return completed;
+}
+
+// cached模式的控制线程：定期采样排队任务数、空闲线程数和吞吐量，用EWMA平滑后决定加线程还是回收线程
+// 加线程：排队的任务比空闲线程多，并且按现在的吞吐量一个周期内消化不完，每次最多翻一倍
+// 回收线程：平滑后一直有空闲线程、没有排队，持续THREAD_MAX_IDLE_TIME秒以后才开始回收(滞回，避免忽加忽减)
+void ThreadPool::controlThreadFunc()
+{
+    const auto interval = std::chrono::milliseconds(THREAD_CONTROL_INTERVAL_MS);
+    double depthAvg = 0; // 平滑后的排队任务数
+    double idleAvg = idleThreadSize_; // 平滑后的空闲线程数
+    double rateAvg = 0; // 平滑后的吞吐量 任务/秒
+    uint64_t lastCompleted = 0;
+    auto lastSample = std::chrono::steady_clock::now();
+    bool surplus = false; // 是否处在线程多余的状态
+    auto surplusSince = lastSample;
+
+    std::unique_lock<std::mutex> lock(controlMtx_);
+    while(isPoolRunning_)
+    {
+        controlCond_.wait_for(lock, interval);
+        controlKicked_ = false;
+        if(!isPoolRunning_)
+            break;
+        joinRetiredThreads();
+
+        auto now = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - lastSample).count();
+        if(seconds <= 0)
+            continue;
+        lastSample = now;
+        uint64_t completed = completedTaskCount();
+        double rate = (completed - lastCompleted) / seconds;
+        lastCompleted = completed;
+
+        int depth = std::max((int)taskSize_, 0);
+        int idle = idleThreadSize_;
+        depthAvg = THREAD_CONTROL_ALPHA * depth + (1 - THREAD_CONTROL_ALPHA) * depthAvg;
+        idleAvg = THREAD_CONTROL_ALPHA * idle + (1 - THREAD_CONTROL_ALPHA) * idleAvg;
+        rateAvg = THREAD_CONTROL_ALPHA * rate + (1 - THREAD_CONTROL_ALPHA) * rateAvg;
+
+        int cur = curThreadSize_;
+        int want = (int)std::ceil(std::max(depthAvg, (double)depth)) - idle;// 突发时瞬时值先上来，不等平滑
+        double drainSeconds = rateAvg > 0 ? depthAvg / rateAvg : INFINITY;
+        if(want > 0 && cur < threadSizeThreshHold_ && drainSeconds > seconds)
+        {
+            surplus = false;
+            {
+                std::lock_guard<std::mutex> queLock(taskQueMtx_);
+                retireThreadSize_ = 0;// 负载又上来了，取消还没执行的回收
+            }
+            int grow = std::min({want, std::max(cur, 1), threadSizeThreshHold_ - cur});
+            for(int i=0;i<grow;i++)
+            {
+                addThread();
+            }
+            continue;
+        }
+
+        if(depthAvg < 0.5 && idleAvg >= 1 && cur > (int)initThreadSize_)
+        {
+            if(!surplus)
+            {
+                surplus = true;
+                surplusSince = now;
+            }
+            else if(now - surplusSince >= std::chrono::seconds(THREAD_MAX_IDLE_TIME))
+            {
+                // 每个周期回收平滑后空闲线程的一半，不低于初始线程数
+                int retire = std::min(std::max((int)(idleAvg / 2), 1), cur - (int)initThreadSize_);
+                std::lock_guard<std::mutex> queLock(taskQueMtx_);
+                retireThreadSize_ = retire;
+                notEmpty_.notify_all();
+            }
+        }
+        else
+        {
+            surplus = false;
+        }
+    }
+}
+
+BatchResult ThreadPool::submitBatch(std::vector<std::shared_ptr<Task>> tasks, TaskPriority priority)
+{
+    // 任务入队前就要挂上计数器，入队后可能马上就被执行了
+    auto latch = std::make_shared<Latch>(tasks.size());
+    for(auto& task : tasks)
+    {
+        task->done_.reset();
+        task->latch_ = latch;
+    }
+    size_t accepted = pushBatch(tasks.data(), tasks.size(), priority);
+    for(size_t i=accepted;i<tasks.size();i++)
+    {
+        tasks[i]->latch_ = nullptr;
+    }
+    latch->countDown(tasks.size() - accepted);// 没放进去的任务不会执行，直接算完成
+    return BatchResult(std::move(tasks), latch, accepted);
+}
+
+// 开启线程池
+void ThreadPool::start(int initThreadSize)
+{
+    if(isPoolRunning_)
+        return;
+    // 设置线程池的运行状态
+    isPoolRunning_ = true;
+
+    // shutdown之后重新start：上一轮的线程都join过了，队列按这次的设置重新建
+    // shutdown之后才提交进来的任务还在上一轮的队列里，先挪到互斥锁队列
+    // 本地队列里的任务没有算过字节数，挪进互斥锁队列要补上，之后出队时会减掉
+    auto moveAll = [&](WorkQueue& que, bool counted)
+    {
+        while(!que.deque_.empty())
+        {
+            if(!counted)
+                reserveBytes(que.deque_.front());
+            taskQue_.push(que.deque_.popFront(), TaskPriority::PRIORITY_NORMAL);
+        }
+    };
+    for(auto& que : localQues_)
+    {
+        moveAll(*que, false);
+    }
+    for(auto& que : nodeQues_)
+    {
+        moveAll(*que, true);
+    }
+    if(taskRing_ != nullptr)
+    {
+        TaskItem task;
+        while(taskRing_->pop(task))
+        {
+            taskQue_.push(std::move(task), TaskPriority::PRIORITY_NORMAL);
+        }
+        taskRing_.reset();
+    }
+    nodeQues_.clear();
+    localQues_.clear();
+    localQueIndex_.clear();
+    workerNode_.clear();
+    retireThreadSize_ = 0;
+    idleThreadSize_ = 0;
+    controlKicked_ = false;
+
+    // 记录初始线程个数
+    initThreadSize_ = initThreadSize;
+    curThreadSize_ = initThreadSize;//当前有多少线程运行
+
+    // cached模式要在队列锁里判断是否加线程，仍然用互斥锁队列
+    if(queueMode_ == QueueMode::MODE_RING && poolMode_ != PoolMode::MODE_CACHED)
+    {
+        size_t capacity = 1;
+        while(capacity < (size_t)std::min(taskQueMaxThreshHold_, TASK_RING_MAX_SIZE))
+        {
+            capacity <<= 1;
+        }
+        taskRing_ = std::make_unique<RingQueue<TaskItem>>(capacity);
+        // start之前提交的任务挪进环形队列，放不下的留在互斥锁队列里，popGlobalTask取完环形队列再去取它们
+        for(size_t i=0;i<capacity && !taskQue_.empty();i++)
+        {
+            taskRing_->push(taskQue_.pop());
+        }
+        ringBacklog_ = !taskQue_.empty();
+    }
+    // 绑核用的CPU按NUMA节点排好，同一节点的CPU挨着，依次分给线程时先排满一个节点
+    if(topology_.nodes().empty())
+    {
+        topology_ = Topology::detect();
+    }
+    std::vector<int> allowed;
+    for(int cpu : topology_.cpus())
+    {
+        if(cpuSet_.empty() || std::find(cpuSet_.begin(), cpuSet_.end(), cpu) != cpuSet_.end())
+            allowed.push_back(cpu);
+    }
+    for(int cpu : cpuSet_)// 拓扑里没有的CPU放最后
+    {
+        if(std::find(allowed.begin(), allowed.end(), cpu) == allowed.end())
+            allowed.push_back(cpu);
+    }
+    cpuSet_ = std::move(allowed);
+
+    // MODE_SHARDED按个数拆注入队列；否则多个NUMA节点、每个线程知道自己在哪个节点时，全局队列按节点拆开
+    bool sharded = queueMode_ == QueueMode::MODE_SHARDED && poolMode_ != PoolMode::MODE_CACHED;
+    if(sharded)
+    {
+        int shards = injectShards_ > 0 ? injectShards_ : std::max(initThreadSize, 1);
+        for(int i=0;i<shards;i++)
+        {
+            nodeQues_.emplace_back(std::make_unique<WorkQueue>());
+        }
+    }
+    else if((affinityMode_ == AffinityMode::AFFINITY_CORE || affinityMode_ == AffinityMode::AFFINITY_NODE)
+       && topology_.nodes().size() > 1 && poolMode_ != PoolMode::MODE_CACHED && taskRing_ == nullptr)
+    {
+        for(size_t i=0;i<topology_.nodes().size();i++)
+        {
+            nodeQues_.emplace_back(std::make_unique<WorkQueue>());
+        }
+    }
+
+    // 这几种情况用workThreadFunc，空闲时在idleEvent_上睡眠
+    bool useWorkFunc = poolMode_ == PoolMode::MODE_STEALING || taskRing_ != nullptr || !nodeQues_.empty();
+    nextWorkerIndex_ = 0;
+
+    // 创建线程对象
+    for(int i=0;i<initThreadSize_;i++)
+    {
+        // 创建thread线程对象的时候，把线程函数给到thread线程对象
+        //threads_.emplace_back(new Thread(std::bind(&ThreadPool::threadFunc,this)));
+        //std::bind函数的作用是将一个可调用对象（如函数、成员函数、函数对象等）与一组参数绑定在一起，
+        // 返回一个新的函数对象。这个新的函数对象可以延迟执行，直到后续调用时再进行实际执行。
+        // 对上面代码的替代
+        auto ptr=std::make_unique<Thread>(std::bind(&ThreadPool::workerMain,this,std::placeholders::_1,nextWorkerIndex_++,useWorkFunc));
+        int threadId = ptr->getId();
+        int node = -1;
+        ptr->setAffinity(placeWorker(i, node));
+        threads_.emplace(threadId, std::move(ptr));
+        if(!nodeQues_.empty())
+        {
+            workerNode_.emplace(threadId, sharded ? i % (int)nodeQues_.size() : std::max(node, 0));// 线程平均分到各个分片
+        }
+        //threads_.emplace_back();//unique_ptr指针只能指一个该对象，这里通过move转移到形参上接着指
+
+        if(poolMode_ == PoolMode::MODE_STEALING)
+        {
+            // 线程启动前把本地队列都建好，之后只读，线程函数里不需要加锁查找
+            localQueIndex_.emplace(threadId, i);
+            localQues_.emplace_back(std::make_unique<WorkQueue>());
+        }
+    }
+    //std::cout<<taskQue_.size()<<std::endl;
+    // 启动所有线程 线程id是全局递增的，不一定从0开始，所以遍历map而不是按下标取
+    for(auto& item : threads_)
+    {
+        idleThreadSize_++; // 每开启一个线程，一开始都是空闲线程，空闲线程数+1
+        TP_TRACE(SPAWN, item.first);
+        item.second->start();
+    }
+
+    // cached模式下线程的增减都交给控制线程
+    if(poolMode_ == PoolMode::MODE_CACHED)
+    {
+        controlThread_ = std::thread(&ThreadPool::controlThreadFunc, this);
+    }
+}
+
+// 线程入口，线程函数里的退出路径都拿着队列锁，钩子和上下文的析构放在这里，不在锁里执行用户代码
+void ThreadPool::workerMain(int threadid, int index, bool useWorkFunc)
+{
+    WorkerSlot slot;
+    slot.info_.pool = this;
+    slot.info_.threadId = threadid;
+    slot.info_.index = index;
+    tlsWorker_ = &slot;
+    if(contextFactory_)
+    {
+        slot.context_ = contextFactory_(slot.info_);
+        slot.contextType_ = contextType_;
+    }
+    if(workerInit_)
+        workerInit_(slot.info_);
+
+    if(useWorkFunc)
+        workThreadFunc(threadid);
+    else
+        threadFunc(threadid);
+    if(tlsOrphaned_)
+    {
+        // 线程池已经在这个线程执行的任务里析构了，它的成员都不能再碰
+        tlsOrphaned_ = false;
+        slot.context_.reset();
+        tlsWorker_ = nullptr;
+        return;
+    }
+    unregisterWorker(tlsStats_);
+
+    // 线程已经不算在线程池里了，但shutdown和控制线程都要join它，exit执行完之前线程池不会析构
+    if(workerExit_)
+        workerExit_(slot.info_);
+    slot.context_.reset();
+    tlsWorker_ = nullptr;
+}
+
+// 定义线程函数
+void ThreadPool::threadFunc(int threadid)
+{
+    tlsPool_ = this;
+    WorkerCounters* counters = registerWorker(threadid);
+    uint64_t lastEnd = steadyNowNs();
+    int spinLimit = IDLE_SPIN_MAX;
+
+    // 等所有任务必须执行完成，线程池才可以回收所有线程资源
+    //while(isPoolRunning_) // 每个线程函数都在不停的要任务来做
+    for(;;)
+    {
+        TaskItem task;
+        {
+            //先获取锁
+            std::unique_lock<std::mutex> lock(taskQueMtx_);
+            // 不要在持有队列锁的时候打印，cout自己也有锁，所有线程都会排队，要看调度情况用TP_TRACE
+
+            // cached模式下，有可能已经创建了很多的线程，但是空闲时间超过60s,应该把多余的线程结束回收掉
+            // 超过initThreadSize_数量的线程要进行回收
+            // 当前时间 - 上一次线程执行的时间 > 60s
+            // 锁+双重判断
+            //while(isPoolRunning_ && taskQue_.size()==0) 为了让任务可以执行完，isPoolRunning_条件删除
+            bool spun = false; // 这次等任务已经自旋过了
+            while(taskQue_.empty())// 任务队列没任务，看看是否自己多余了
+            {
+                if(!isPoolRunning_)//执行完任务，没任务了，线程退出，线程对象由shutdown来join
+                {
+                    curThreadSize_--;
+                    idleThreadSize_--;
+                    TP_TRACE(RETIRE, threadid);
+                    counters->alive_ = false;
+                    tlsPool_ = nullptr;
+                    exitCond_.notify_all();//告诉shutdown又走了一个
+                    return;
+                }
+
+                // cached模式下控制线程判断线程多余了，空闲的线程领一个回收名额退出
+                if(retireThreadSize_ > 0 && curThreadSize_ > (int)initThreadSize_)
+                {
+                    // 开始回收当前线程
+                    // 记录线程数量的相关变量的值修改
+                    // 把线程对象从线程列表容器中删除 没办法 threadFunc 中找到对应vector的哪一个线程位置-》改用map,创建线程号为key方便查找
+                    // threadid => thread对象 => 删除
+                    retireThreadSize_--;
+                    // 线程对象交给控制线程join，自己不能join自己
+                    auto it = threads_.find(threadid);
+                    retiredThreads_.push_back(std::move(it->second));
+                    threads_.erase(it);
+                    curThreadSize_--;//现有线程-1
+                    idleThreadSize_--;//空闲线程-1
+
+                    TP_TRACE(RETIRE, threadid);
+                    counters->alive_ = false;
+                    tlsPool_ = nullptr;
+                    exitCond_.notify_all();
+                    return;
+                }
+
+                // IDLE_SPIN：先放开锁自旋等一会儿，回到循环开头重新检查一遍(自旋时错过的shutdown/回收通知也能看到)，还是空的才睡
+                if(idlePolicy_ == IdlePolicy::IDLE_SPIN && !spun)
+                {
+                    lock.unlock();
+                    spinForTask(spinLimit);
+                    lock.lock();
+                    spun = true;
+                    continue;
+                }
+
+                //等待notEmpty条件 没有超时，cached模式下空闲线程也不用每秒醒一次看自己是否多余
+                TP_TRACE(PARK, 0);
+                notEmpty_.wait(lock);//线程队列等不到就一直等任务
+                TP_TRACE(UNPARK, 0);
+                // 线程池要结束，回收线程资源
+//                if(!isPoolRunning_)//看唤醒两种情况的是不是要结束主线程的析构
+//                {
+//                    // 回收当前线程
+//                    threads_.erase(threadid); // 清空线程vector中的对象
+//                    std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
+//                             << std::endl;
+//                    std::cout<<threads_.size()<<"*"<<std::endl;
+//                    exitCond_.notify_all();//唤醒主线程pool的析构wait,看是否全走完
+//                    return;
+//                }
+            }
+
+            // 有任务的情况下，跳到这里，为了要让任务执行完，跳过isPoolRunning_判断条件
+            /*
+            // 线程结束，回收资源
+            if(!isPoolRunning_)
+            {
+                break;
+            }*/
+
+            idleThreadSize_--;//任务队列有任务，则本线程会处理下面弄到的任务，本线程不再闲，闲数-1
+
+            // 从任务队列取一个任务出来 优先级高的先出，老化的低优先级任务穿插着出
+            task = taskQue_.pop();//子类给父类 拿走任务
+            taskSize_--;
+            releaseBytes(task);
+            TP_TRACE(DEQUEUE, task.enqueueNs_);
+
+            // 如果依然有剩余任务，继续叫醒下一个线程执行任务(接力，不一次全叫醒)
+            if(taskQue_.size() > 0)
+            {
+                notEmpty_.notify_one();
+            }
+
+            // 取出一个任务，进行通知，通知submitTask可以继续提交生产任务
+            notFull_.notify_all();
+        }//把锁释放掉，自己执行拿到的任务即可，无需拿着任务队列的锁
+
+        // 当前线程负责执行这个任务
+        if(task)
+        {
+            //task->run(); 这只是执行任务，现在把任务结果返回
+            runTask(*counters, std::move(task), lastEnd);
+            if(tlsOrphaned_)
+                return;
+        }
+        idleThreadSize_++;//本线程处理完取的任务再次闲下来，闲+1
+    }
+    /* 改了以后，为了让其执行完，没有跳出for循环的语句，把下面析构本线程的语句上移到发现任务为0的地方进行析构
+    // 析构结束时，在执行的本线程回到循环while发现要析构了，跳出循环到这，开始析构本线程
+    threads_.erase(threadid); // 清空线程vector中的对象
+    std::cout<<"threadid:"<<std::this_thread::get_id()<<" exit!"
+             << std::endl;
+    std::cout<<threads_.size()<<std::endl;
+    exitCond_.notify_all();//唤醒主线程pool的析构wait,看是否全走
+     */
+}
+
+// 工作窃取模式/无锁队列模式的线程函数
+void ThreadPool::workThreadFunc(int threadid)
+{
+    int index = -1;
+    if(poolMode_ == PoolMode::MODE_STEALING)
+    {
+        index = localQueIndex_.at(threadid);
+        tlsQue_ = localQues_[index].get();
+        tlsIndex_ = index;
+    }
+    tlsPool_ = this;
+    auto nodeIt = workerNode_.find(threadid);
+    tlsNode_ = nodeIt == workerNode_.end() ? -1 : nodeIt->second;
+    WorkerCounters* counters = registerWorker(threadid);
+    uint64_t lastEnd = steadyNowNs();
+    int spinLimit = IDLE_SPIN_MAX;
+
+    for(;;)
+    {
+        TaskItem task = takeTask(index);
+        if(!task)
+        {
+            if(spinForTask(spinLimit))
+                continue;
+            // 先登记要睡了，再检查一次有没有任务：提交方是先加taskSize_再看有没有人要睡，两边总有一方能看到对方
+            uint32_t key = idleEvent_.prepareWait();
+            if(taskSize_ > 0)// 别的线程刚放了任务，再去取一次
+            {
+                idleEvent_.cancelWait();
+                continue;
+            }
+            if(!isPoolRunning_)// 任务全部执行完了，线程池要结束，回收本线程
+            {
+                idleEvent_.cancelWait();
+                std::lock_guard<std::mutex> lock(taskQueMtx_);
+                curThreadSize_--;
+                idleThreadSize_--;
+                TP_TRACE(RETIRE, threadid);
+                counters->alive_ = false;
+                tlsPool_ = nullptr;
+                tlsQue_ = nullptr;
+                tlsIndex_ = -1;
+                tlsNode_ = -1;
+                exitCond_.notify_all();
+                return;
+            }
+            TP_TRACE(PARK, 0);
+            idleEvent_.commitWait(key);
+            TP_TRACE(UNPARK, 0);
+            continue;
+        }
+
+        TP_TRACE(DEQUEUE, task.enqueueNs_);
+        idleThreadSize_--;
+        runTask(*counters, std::move(task), lastEnd);
+        if(tlsOrphaned_)
+            return;
+        idleThreadSize_++;
+    }
+}
+
+// 等一小会儿(一条pause指令)，让出流水线给同一个核上的另一个超线程
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+bool ThreadPool::spinForTask(int& spinLimit)
+{
+    if(idlePolicy_ != IdlePolicy::IDLE_SPIN)
+        return false;
+    // 已经有一半线程在自旋了，再多也只是和它们抢同一个任务，直接去睡
+    if(spinningThreads_.fetch_add(1, std::memory_order_relaxed) >= std::max(curThreadSize_.load() / 2, 1))
+    {
+        spinningThreads_.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    bool found = false;
+    for(int i=0;i<spinLimit && !found;i++)
+    {
+        cpuRelax();
+        found = taskSize_.load(std::memory_order_relaxed) > 0;
+    }
+    for(int i=0;i<IDLE_YIELD_COUNT && !found;i++)
+    {
+        std::this_thread::yield();
+        found = taskSize_.load(std::memory_order_relaxed) > 0;
+    }
+    spinningThreads_.fetch_sub(1, std::memory_order_relaxed);
+    // 自旋等到了说明任务来得密，下次多等一会儿；没等到说明空闲，下次早点睡
+    spinLimit = found ? std::min(spinLimit * 2, IDLE_SPIN_MAX) : std::max(spinLimit / 2, IDLE_SPIN_MIN);
+    return found;
+}
+
+TaskItem ThreadPool::takeTask(int index)
+{
+    // 先做自己的（最近放进去的子任务，缓存还热），再去本节点/别的节点的队列、全局队列拿，最后去偷别人最早放进去的
+    TaskItem task;
+    if(index >= 0)
+        task = popLocalTask(index);
+    if(!task)
+        task = popNodeTask();
+    if(!task)
+        task = popGlobalTask();
+    if(!task && index >= 0)
+        task = stealTask(index);
+    return task;
+}
+
+TaskItem ThreadPool::popLocalTask(int index)
+{
+    WorkQueue& que = *localQues_[index];
+    std::lock_guard<std::mutex> lock(que.mtx_);
+    if(que.deque_.empty())
+        return TaskItem();
+    TaskItem task = que.deque_.popBack();
+    taskSize_--;
+    return task;
+}
+
+TaskItem ThreadPool::popNodeTask()
+{
+    // 从本节点(分片)的队列开始轮一圈，本节点没任务了才去做别的节点的
+    int size = nodeQues_.size();
+    int start = std::max(tlsNode_, 0);
+    for(int i=0;i<size;i++)
+    {
+        WorkQueue& que = *nodeQues_[(start + i) % size];
+        std::lock_guard<std::mutex> lock(que.mtx_);
+        if(que.deque_.empty())
+            continue;
+        TaskItem task = que.deque_.popFront();
+        taskSize_--;
+        releaseBytes(task);
+        notFullEvent_.notifyAll();
+        return task;
+    }
+    return TaskItem();
+}
+
+TaskItem ThreadPool::popGlobalTask()
+{
+    if(taskRing_ != nullptr)
+    {
+        TaskItem task;
+        if(taskRing_->pop(task))
+        {
+            taskSize_--;
+            releaseBytes(task);
+            notFullEvent_.notifyAll();
+            return task;
+        }
+        // 环形队列模式下只有start之前剩下的任务在互斥锁队列里，取完以后不用再加锁看
+        if(!ringBacklog_.load(std::memory_order_acquire))
+            return task;
+    }
+
+    std::lock_guard<std::mutex> lock(taskQueMtx_);
+    if(taskQue_.empty())
+    {
+        ringBacklog_ = false;
+        return TaskItem();
+    }
+    TaskItem task = taskQue_.pop();
+    taskSize_--;
+    releaseBytes(task);
+    notFull_.notify_all();// 通知submitTask可以继续提交
+    notFullEvent_.notifyAll();// 环形队列模式下start之前剩下的任务也占着名额
+    return task;
+}
+
+TaskItem ThreadPool::stealTask(int index)
+{
+    // 从自己的下一个开始轮一圈，避免所有线程都挤着去偷同一个队列
+    int size = localQues_.size();
+    for(int i=1;i<size;i++)
+    {
+        WorkQueue& que = *localQues_[(index + i) % size];
+        std::lock_guard<std::mutex> lock(que.mtx_);
+        if(que.deque_.empty())
+            continue;
+        TaskItem task = que.deque_.popFront();
+        taskSize_--;
+        WorkerCounters::add(tlsStats_->steals_, 1);
+        return task;
+    }
+    return TaskItem();
+}
+
+TaskItem ThreadPool::takeHelpTask()
+{
+    TaskItem task;
+    if(tlsIndex_ >= 0)
+        task = popLocalTask(tlsIndex_);
+    if(!task && tlsNode_ >= 0 && tlsNode_ < (int)nodeQues_.size())
+    {
+        WorkQueue& que = *nodeQues_[tlsNode_];
+        std::lock_guard<std::mutex> lock(que.mtx_);
+        if(!que.deque_.empty())
+        {
+            task = que.deque_.popBack();
+            taskSize_--;
+            releaseBytes(task);
+            notFullEvent_.notifyAll();
+        }
+    }
+    if(!task && taskRing_ == nullptr)// 无锁环形队列只能按顺序取
+    {
+        std::lock_guard<std::mutex> lock(taskQueMtx_);
+        if(!taskQue_.empty())
+        {
+            task = taskQue_.popNewest();
+            taskSize_--;
+            releaseBytes(task);
+            notFull_.notify_all();
+        }
+    }
+    if(!task)
+        task = takeTask(tlsIndex_);
+    return task;
+}
+
+std::vector<int> ThreadPool::placeWorker(int index, int& node) const
+{
+    node = -1;
+    if(cpuSet_.empty())
+        return {};
+    switch(affinityMode_)
+    {
+    case AffinityMode::AFFINITY_CPUSET:
+        return cpuSet_;
+    case AffinityMode::AFFINITY_CORE:
+    {
+        int cpu = cpuSet_[index % cpuSet_.size()];
+        node = topology_.nodeOf(cpu);
+        return {cpu};
+    }
+    case AffinityMode::AFFINITY_NODE:
+    {
+        // 有可用CPU的节点之间轮流分
+        std::vector<std::vector<int>> nodeCpus(topology_.nodes().size());
+        for(int cpu : cpuSet_)
+        {
+            int n = topology_.nodeOf(cpu);
+            if(n >= 0)
+                nodeCpus[n].push_back(cpu);
+        }
+        std::vector<int> usable;
+        for(size_t n=0;n<nodeCpus.size();n++)
+        {
+            if(!nodeCpus[n].empty())
+                usable.push_back(n);
+        }
+        if(usable.empty())
+            return cpuSet_;
+        node = usable[index % usable.size()];
+        return nodeCpus[node];
+    }
+    default:
+        return {};
+    }
+}
+
+int ThreadPool::submitNode() const
+{
+    // 池内线程直接用自己的节点，外部线程看当前跑在哪个CPU上
+    if(tlsPool_ == this && tlsNode_ >= 0)
+        return tlsNode_;
+    // 拆分片时每个提交线程固定用一个，提交线程多了就错开，不会都挤在同一把锁上
+    if(queueMode_ == QueueMode::MODE_SHARDED)
+    {
+        if(tlsShard_ < 0)
+            tlsShard_ = nextShard_.fetch_add(1, std::memory_order_relaxed) & INT_MAX;
+        return tlsShard_ % (int)nodeQues_.size();
+    }
+    int node = -1;
+#ifdef __linux__
+    node = topology_.nodeOf(sched_getcpu());
+#endif
+    return node < 0 || node >= (int)nodeQues_.size() ? 0 : node;
+}
+
+int ThreadPool::getThreadSize() const
+{
+    return curThreadSize_;
+}
+
+WorkerCounters* ThreadPool::registerWorker(int threadid)
+{
+    std::lock_guard<std::mutex> lock(statsMtx_);
+    workerStats_.emplace_back(std::make_unique<WorkerCounters>(threadid));
+    tlsStats_ = workerStats_.back().get();
+    return tlsStats_;
+}
+
+void ThreadPool::unregisterWorker(WorkerCounters* counters)
+{
+    std::lock_guard<std::mutex> lock(statsMtx_);
+    retiredStats_.tasks += counters->tasks_.load(std::memory_order_relaxed);
+    retiredStats_.busyNs += counters->busyNs_.load(std::memory_order_relaxed);
+    retiredStats_.idleNs += counters->idleNs_.load(std::memory_order_relaxed);
+    retiredStats_.steals += counters->steals_.load(std::memory_order_relaxed);
+    retiredStats_.helps += counters->helps_.load(std::memory_order_relaxed);
+    counters->waitHist_.snapshotInto(retiredWait_);
+    counters->execHist_.snapshotInto(retiredExec_);
+    exitedThreads_++;
+    auto it = std::find_if(workerStats_.begin(), workerStats_.end(),
+        [counters](const std::unique_ptr<WorkerCounters>& entry) { return entry.get() == counters; });
+    workerStats_.erase(it);
+    tlsStats_ = nullptr;
+}
+
+void ThreadPool::runTask(WorkerCounters& counters, TaskItem task, uint64_t& lastEnd)
+{
+    while(task)
+    {
+        uint64_t begin = steadyNowNs();
+        counters.waitHist_.record(begin > task.enqueueNs_ ? begin - task.enqueueNs_ : 0);
+        WorkerCounters::add(counters.idleNs_, begin - lastEnd);
+
+        TP_TRACE(EXEC_BEGIN, task.enqueueNs_);
+        task.func_();
+        TP_TRACE(EXEC_END, task.enqueueNs_);
+        if(tlsOrphaned_)
+            return;// 线程池在这个任务里析构了
+
+        lastEnd = steadyNowNs();
+        counters.execHist_.record(lastEnd - begin);
+        WorkerCounters::add(counters.busyNs_, lastEnd - begin);
+        WorkerCounters::add(counters.tasks_, 1);
+
+        task = std::move(tlsNextTask_);// 执行中就绪的后继任务，缓存还热，直接接着做
+    }
+}
+
+bool ThreadPool::dispatchTask(TaskItem task, bool inTask)
+{
+    if(inTask && tlsPool_ == this && !tlsNextTask_)
+    {
+        task.enqueueNs_ = steadyNowNs();
+        TP_TRACE(ENQUEUE, task.enqueueNs_);
+        submittedCount_++;
+        tlsNextTask_ = std::move(task);
+        return true;
+    }
+    return pushTask(std::move(task));
+}
+
+bool ThreadPool::helpWait(const std::function<bool()>& done, const std::function<bool(Deadline)>& waitUntil)
+{
+    ThreadPool* pool = tlsPool_;
+    if(pool == nullptr || tlsHelpDepth_ >= TASK_HELP_MAX_DEPTH)
+        return false;
+    tlsHelpDepth_++;
+    // 外层任务的后继先收起来，被执行的任务自己的后继在里面的runTask里就做完了
+    TaskItem next = std::move(tlsNextTask_);
+    auto sleep = std::chrono::microseconds(TASK_HELP_WAIT_MIN_US);
+    while(!done())
+    {
+        TaskItem task = pool->takeHelpTask();
+        if(!task)
+            task = std::move(next);// 队列里没有了，收起来的后继也已经就绪，不在睡之前执行掉的话要等的结果可能就卡在它后面
+        if(task)
+        {
+            TP_TRACE(DEQUEUE, task.enqueueNs_);
+            WorkerCounters::add(tlsStats_->helps_, 1);
+            uint64_t lastEnd = steadyNowNs();// 等结果的这段时间算外层任务的，不算空闲
+            pool->runTask(*tlsStats_, std::move(task), lastEnd);
+            if(tlsOrphaned_)
+            {
+                tlsHelpDepth_--;
+                return false;// 线程池析构了，调用方自己等
+            }
+            sleep = std::chrono::microseconds(TASK_HELP_WAIT_MIN_US);
+            continue;
+        }
+        if(waitUntil(std::chrono::steady_clock::now() + sleep))
+            break;
+        sleep = std::min(sleep * 2, std::chrono::microseconds(TASK_HELP_WAIT_MAX_US));
+    }
+    tlsNextTask_ = std::move(next);
+    tlsHelpDepth_--;
+    return true;
+}
+
+PoolStats ThreadPool::stats() const
+{
+    PoolStats st;
+    st.submitted = submittedCount_;
+    st.rejected = rejectedCount_;
+    st.dropped = droppedCount_;
+    st.callerRuns = callerRunsCount_;
+    st.queueDepth = std::max((int)taskSize_, 0);
+    st.peakQueueDepth = peakTaskSize_;
+    st.threadSize = curThreadSize_;
+    st.idleThreadSize = idleThreadSize_;
+
+    std::lock_guard<std::mutex> lock(statsMtx_);
+    for(auto& counters : workerStats_)
+    {
+        WorkerStats worker;
+        worker.threadId = counters->threadId_;
+        worker.alive = counters->alive_;
+        worker.tasks = counters->tasks_.load(std::memory_order_relaxed);
+        worker.busyNs = counters->busyNs_.load(std::memory_order_relaxed);
+        worker.idleNs = counters->idleNs_.load(std::memory_order_relaxed);
+        worker.steals = counters->steals_.load(std::memory_order_relaxed);
+        worker.helps = counters->helps_.load(std::memory_order_relaxed);
+        st.completed += worker.tasks;
+        st.threadsSpawned++;
+        st.threadsRetired += worker.alive ? 0 : 1;
+        st.workers.push_back(worker);
+        counters->waitHist_.snapshotInto(st.queueWait);
+        counters->execHist_.snapshotInto(st.execTime);
+    }
+    // 退出的线程合成一项放在最后，threadId为-1
+    if(exitedThreads_ > 0)
+    {
+        WorkerStats retired = retiredStats_;
+        retired.threadId = -1;
+        retired.alive = false;
+        st.completed += retired.tasks;
+        st.threadsSpawned += exitedThreads_;
+        st.threadsRetired += exitedThreads_;
+        st.workers.push_back(retired);
+        st.queueWait.merge(retiredWait_);
+        st.execTime.merge(retiredExec_);
+    }
+    return st;
+}
+
+bool ThreadPool::exportStats(const std::string& path) const
+{
+    // 先写临时文件再改名，抓取方不会读到写了一半的文件
+    std::string tmp = path + ".tmp";
+    FILE* file = std::fopen(tmp.c_str(), "w");
+    if(file == nullptr)
+        return false;
+    std::string text = stats().toPrometheus();
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok && std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+void ThreadPool::exportStats(const std::function<void(const std::string&)>& callback) const
+{
+    callback(stats().toPrometheus());
+}
+
+#ifdef THREADPOOL_COROUTINES
+ScheduleAwaiter ThreadPool::schedule()
+{
+    return ScheduleAwaiter(this);
+}
+
+bool ScheduleAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    // 恢复协程的任务只存一个句柄，直接放在队列里，没有堆分配
+    return pool_->pushTask(TaskItem([handle]() { handle.resume(); }));
+}
+#endif
+
+// 检查pool的运行状态
+bool ThreadPool::checkRunningState() const
+{
+    return isPoolRunning_;
+}
+
+thread_local ThreadPool* ThreadPool::tlsPool_ = nullptr;
+thread_local ThreadPool::WorkQueue* ThreadPool::tlsQue_ = nullptr;
+thread_local int ThreadPool::tlsIndex_ = -1;
+thread_local int ThreadPool::tlsHelpDepth_ = 0;
+thread_local int ThreadPool::tlsNode_ = -1;
+thread_local int ThreadPool::tlsShard_ = -1;
+std::atomic_int ThreadPool::nextShard_(0);
+thread_local ThreadPool::WorkerSlot* ThreadPool::tlsWorker_ = nullptr;
+thread_local TaskItem ThreadPool::tlsNextTask_;
+thread_local bool ThreadPool::tlsOrphaned_ = false;
+thread_local bool ThreadPool::tlsDiscard_ = false;
+thread_local WorkerCounters* ThreadPool::tlsStats_ = nullptr;
+
+//////////////// 多级任务队列的实现
+MultiLevelQueue::MultiLevelQueue()
+    : size_(0)
+    , agingNs_((uint64_t)TASK_PRIORITY_AGING_MS * 1000000)
+    , skipped_(0)
+{
+    for(size_t& limit : limits_)
+    {
+        limit = SIZE_MAX;
+    }
+}
+
+void MultiLevelQueue::setAging(uint64_t agingNs)
+{
+    agingNs_ = agingNs;
+}
+
+void MultiLevelQueue::setLimit(TaskPriority priority, size_t limit)
+{
+    limits_[(int)priority] = limit;
+}
+
+size_t MultiLevelQueue::limit(TaskPriority priority) const
+{
+    return limits_[(int)priority];
+}
+
+bool MultiLevelQueue::empty() const
+{
+    return size_ == 0;
+}
+
+size_t MultiLevelQueue::size() const
+{
+    return size_;
+}
+
+size_t MultiLevelQueue::size(TaskPriority priority) const
+{
+    return levels_[(int)priority].size();
+}
+
+void MultiLevelQueue::push(TaskItem task, TaskPriority priority)
+{
+    levels_[(int)priority].pushBack(std::move(task));
+    size_++;
+}
+
+TaskItem MultiLevelQueue::dropOldest(TaskPriority priority)
+{
+    int level = (int)priority;
+    if(levels_[level].size() < limits_[level])
+    {
+        // 这个优先级没满，是总数满了：从最低优先级往上找，不越过新任务的优先级
+        level = TASK_PRIORITY_LEVELS - 1;
+        while(level > (int)priority && levels_[level].empty())
+        {
+            level--;
+        }
+    }
+    if(levels_[level].empty())
+        return TaskItem();
+    TaskItem task = levels_[level].popFront();
+    size_--;
+    return task;
+}
+
+TaskItem MultiLevelQueue::pop()
+{
+    if(size_ == 0)
+        return TaskItem();
+
+    int top = 0;// 最高的非空级别
+    while(levels_[top].empty())
+    {
+        top++;
+    }
+
+    // 找比top低的级别里排队最久的老化队头，只有低级别有任务时才需要取时间
+    int aged = -1;
+    uint64_t agedSince = UINT64_MAX;
+    uint64_t now = 0;
+    for(int level=top+1;level<TASK_PRIORITY_LEVELS;level++)
+    {
+        if(levels_[level].empty())
+            continue;
+        if(now == 0)
+            now = steadyNowNs();
+        uint64_t since = levels_[level].front().enqueueNs_;
+        if(now - since >= agingNs_ * (level - top) && since < agedSince)
+        {
+            aged = level;
+            agedSince = since;
+        }
+    }
+
+    int level = top;
+    if(aged < 0)
+    {
+        skipped_ = 0;
+    }
+    else if(skipped_ >= TASK_AGING_RATIO)
+    {
+        level = aged;
+        skipped_ = 0;
+    }
+    else
+    {
+        skipped_++;
+    }
+
+    TaskItem task = levels_[level].popFront();
+    size_--;
+    return task;
+}
+
+TaskItem MultiLevelQueue::popNewest()
+{
+    for(int level=0;level<TASK_PRIORITY_LEVELS;level++)
+    {
+        if(levels_[level].empty())
+            continue;
+        size_--;
+        return levels_[level].popBack();
+    }
+    return TaskItem();
+}
+
+//////////////// 事件计数器的实现
+EventCount::EventCount()
+    : epoch_(0)
+    , waiters_(0)
+{
+}
+
+uint32_t EventCount::prepareWait()
+{
+    waiters_.fetch_add(1);// seq_cst，先登记再读epoch_
+    return epoch_.load();
+}
+
+void EventCount::cancelWait()
+{
+    waiters_.fetch_sub(1);
+}
+
+void EventCount::commitWait(uint32_t key)
+{
+#ifdef __linux__
+    // epoch_没变才睡，futex在内核里会再比较一次，notify在这之间改了epoch_就不会睡死
+    while(epoch_.load() == key)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+    }
+#else
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait(lock,[&]()->bool{return epoch_.load() != key;});
+#endif
+    waiters_.fetch_sub(1);
+}
+
+void EventCount::commitWaitUntil(uint32_t key, std::chrono::steady_clock::time_point deadline)
+{
+#ifdef __linux__
+    while(epoch_.load() == key)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if(now >= deadline)
+            break;
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+        struct timespec timeout;
+        timeout.tv_sec = ns / 1000000000;
+        timeout.tv_nsec = ns % 1000000000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key, &timeout, nullptr, 0);
+    }
+#else
+    std::unique_lock<std::mutex> lock(mtx_);
+    cond_.wait_until(lock,deadline,[&]()->bool{return epoch_.load() != key;});
+#endif
+    waiters_.fetch_sub(1);
+}
+
+void EventCount::notifyOne()
+{
+    wake(1);
+}
+
+void EventCount::notify(int count)
+{
+    if(count > 0)
+        wake(count);
+}
+
+void EventCount::notifyAll()
+{
+    wake(INT_MAX);
+}
+
+void EventCount::wake(int count)
+{
+    // 调用方之前修改的条件(任务入队、taskSize_++)要先于这里读waiters_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiters_.load(std::memory_order_relaxed) == 0)
+        return;// 没有线程在睡，什么都不用做
+    epoch_.fetch_add(1);
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(count == 1)
+        cond_.notify_one();
+    else
+        cond_.notify_all();
+#endif
+}
+
+//////////////// 线程方法的实现
+// 线程类静态成员变量在类外初始化
+std::atomic_int Thread::generateId_(0);
+
+//线程构造
+Thread::Thread(ThreadFunc func)//接收一个函数
+    :func_(std::move(func))
+    , threadId_(generateId_++)//给线程对象赋个编号值以区分
+{
+
+}
+//线程析构
+Thread::~Thread()
+{
+    join();
+}
+
+void Thread::join()
+{
+    if(thread_.joinable())
+    {
+        // 线程池在自己线程执行的任务里析构时，shutdown会走到这里join自己，改成detach
+        if(thread_.get_id() == std::this_thread::get_id())
+            thread_.detach();
+        else
+            thread_.join();
+    }
+}
+
+void Thread::setAffinity(std::vector<int> cpus)
+{
+    cpus_ = std::move(cpus);
+}
+
+// 启动线程
+void Thread::start()
+{
+    // 创建一个线程来执行一个线程函数，线程里先绑核再干活，之后分配的内存都落在绑定的节点上
+    // 每个Thread对象只start一次，线程函数直接移交给新线程
+    thread_ = std::thread([func = std::move(func_), threadId = threadId_, cpus = cpus_]() mutable
+    {
+#ifdef __linux__
+        if(!cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(int cpu : cpus)
+            {
+                if(cpu >= 0 && cpu < CPU_SETSIZE)
+                    CPU_SET(cpu, &set);
+            }
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#endif
+        func(threadId);
+    });// 不再detach，线程对象析构/shutdown时join，退出时间有保证
+}
+
+int Thread::getId() const
+{
+    return threadId_;
+}
+
+///////////// Task方法实现
+TaskBase::~TaskBase()
+{
+
+}
+
+void TaskBase::setCancelToken(CancelToken token)
+{
+    token_ = std::move(token);
+}
+
+void TaskBase::setDeadline(Deadline deadline)
+{
+    deadline_ = deadline;
+}
+
+void TaskBase::discard()
+{
+    exec();
+}
+
+bool TaskBase::isCancelled() const
+{
+    if(token_.isCancelled())
+        return true;
+    return deadline_ != Deadline::max() && std::chrono::steady_clock::now() >= deadline_;
+}
+
+/////////////  CancelToken方法的实现
+CancelToken::CancelToken()
+    : cancelled_(std::make_shared<std::atomic_bool>(false))
+{
+}
+
+CancelToken::CancelToken(std::nullptr_t)
+{
+}
+
+void CancelToken::cancel()
+{
+    if(cancelled_ != nullptr)
+        cancelled_->store(true, std::memory_order_relaxed);
+}
+
+Task::Task()
+{
+
+}
+
+Task::~Task()
+{
+
+}
+
+void Task::exec() //要解决一个问题，即线程执行结果后，给result类对象，而且task对象析构还要保证result对象在
+{
+    if(isCancelled())// 排队期间被取消或者过了截止时间，不执行，直接通知Result
+    {
+        cancelled_ = true;
+    }
+    else
+    {
+        any_ = run();// 返回值存在任务自己身上，Result持有任务的共享指针，随时可以来取
+    }
+    finish();
+}
+
+void Task::discard()
+{
+    cancelled_ = true;
+    finish();
+}
+
+void Task::finish()
+{
+    done_.set(); // 返回值已经存好了，设置完成标志，有人在等才会去唤醒
+    if(latch_ != nullptr)
+    {
+        std::shared_ptr<Latch> latch = std::move(latch_);// 一个批次只算一次，任务再次提交时不会重复计数
+        latch->countDown();
+    }
+}
+
+/////////////  BatchResult方法的实现
+BatchResult::BatchResult(std::vector<std::shared_ptr<Task>> tasks, std::shared_ptr<Latch> latch, size_t accepted)
+    : tasks_(std::move(tasks))
+    , latch_(std::move(latch))
+    , accepted_(accepted)
+{
+}
+
+size_t BatchResult::size() const
+{
+    return accepted_;
+}
+
+void BatchResult::wait()
+{
+    latch_->wait();
+}
+
+Result BatchResult::result(size_t i) const
+{
+    return Result(tasks_.at(i), i < accepted_);
+}
+
+/////////////  Latch方法的实现
+Latch::Latch(int count)
+    : count_(count)
+{
+    if(count <= 0)
+        done_.set();
+}
+
+void Latch::countDown(int n)
+{
+    if(n <= 0)
+        return;
+    if(count_.fetch_sub(n) == n)// 最后一个完成的负责唤醒
+    {
+        done_.set();
+    }
+}
+
+void Latch::wait()
+{
+    if(done_.isSet())
+        return;
+    if(ThreadPool::helpWait([this]() { return done_.isSet(); },
+                            [this](Deadline deadline) { return done_.waitUntil(deadline); }))
+        return;
+    done_.wait();
+}
+
+bool Latch::ready() const
+{
+    return count_ <= 0;
+}
+
+/////////////  Result方法的实现
+Result::Result(std::shared_ptr<Task> task, bool isValid)
+        :task_(task)
+        ,isValid_(isValid)
+{
+}
+
+Any Result::get()// task外的接收结果
+{
+    if(!isValid_)//如果任务提交失败，线程函数返回值无效，直接返回空
+    {
+        return "";
+    }
+
+    // 在线程池的线程上等：先帮着执行排队的任务，执行完了下面的wait不会阻塞
+    const CompletionFlag& done = task_->done_;
+    ThreadPool::helpWait([&]() { return done.isSet(); },
+                         [&](Deadline deadline) { return done.waitUntil(deadline); });
+    done.wait(); // task任务如果没有执行完，这里会阻塞用户的线程
+    return std::move(task_->any_);
+}
+
+const CompletionFlag* Result::flag() const
+{
+    return isValid_ ? &task_->done_ : nullptr;
+}
+
+WaitStatus Result::waitUntil(Deadline deadline)
+{
+    if(!isValid_)
+        return WaitStatus::CANCELLED;
+    if(!task_->done_.waitUntil(deadline))
+        return WaitStatus::TIMEOUT;
+    return task_->cancelled_ ? WaitStatus::CANCELLED : WaitStatus::READY;
+}
+
+/////////////  waitAll/waitAny的实现
+size_t waitCompletions(const std::vector<const CompletionFlag*>& flags, bool any)
+{
+    size_t size = flags.size();
+    auto done = [&]()->bool
+    {
+        for(const CompletionFlag* flag : flags)
+        {
+            bool set = flag == nullptr || flag->isSet();
+            if(set == any)
+                return any;
+        }
+        return !any || size == 0;
+    };
+    auto waitUntil = [&](Deadline deadline)->bool
+    {
+        return any ? CompletionFlag::waitAny(flags.data(), size, deadline) < size
+                   : CompletionFlag::waitAll(flags.data(), size, deadline);
+    };
+    // 池内线程同get一样边等边执行排队的任务
+    ThreadPool::helpWait(done, waitUntil);
+    if(any)
+        return CompletionFlag::waitAny(flags.data(), size);
+    CompletionFlag::waitAll(flags.data(), size);
+    return 0;
+}
+
+void waitAll(const std::vector<Result>& results)
+{
+    std::vector<const CompletionFlag*> flags;
+    flags.reserve(results.size());
+    for(const Result& result : results)
+    {
+        flags.push_back(result.flag());
+    }
+    waitCompletions(flags, false);
+}
+
+size_t waitAny(const std::vector<Result>& results)
+{
+    std::vector<const CompletionFlag*> flags;
+    flags.reserve(results.size());
+    for(const Result& result : results)
+    {
+        flags.push_back(result.flag());
+    }
+    return waitCompletions(flags, true);
+}
+
+/////////////  Completion方法的实现
+Completion::Completion()
+    : cancelled_(false)
+    , continuations_(nullptr)
+{
+}
+
+Completion::~Completion()
+{
+    // 没有完成就被释放了(任务被丢掉、没交给discardTask)，挂着的后续动作不会再执行
+    Continuation* node = continuations_.load(std::memory_order_acquire);
+    while(node != nullptr && node != closed())
+    {
+        Continuation* next = node->next_;
+        delete node;
+        node = next;
+    }
+}
+
+Completion::Continuation* Completion::closed()
+{
+    static Continuation sentinel;
+    return &sentinel;
+}
+
+bool Completion::ready() const
+{
+    return done_.isSet();
+}
+
+void Completion::wait()
+{
+    if(done_.isSet())
+        return;
+    if(ThreadPool::helpWait([this]() { return done_.isSet(); },
+                            [this](Deadline deadline) { return done_.waitUntil(deadline); }))
+        return;
+    done_.wait();
+}
+
+bool Completion::waitUntil(Deadline deadline)
+{
+    return done_.waitUntil(deadline);
+}
+
+bool Completion::wasCancelled() const
+{
+    return done_.isSet() && cancelled_;
+}
+
+void Completion::completeCancelled(bool inTask)
+{
+    cancelled_ = true;
+    setError(std::make_exception_ptr(TaskCancelled()));
+    complete(inTask);
+}
+
+void Completion::setError(std::exception_ptr error)
+{
+    error_ = error;
+}
+
+void Completion::rethrowIfError()
+{
+    if(error_)
+    {
+        std::rethrow_exception(error_);
+    }
+}
+
+void Completion::complete(bool inTask)
+{
+    done_.set();
+    // 没挂后续动作时只是一次原子交换；挂上来的是倒序的，按挂上来的顺序执行
+    Continuation* node = continuations_.exchange(closed(), std::memory_order_acq_rel);
+    Continuation* ordered = nullptr;
+    while(node != nullptr)
+    {
+        Continuation* next = node->next_;
+        node->next_ = ordered;
+        ordered = node;
+        node = next;
+    }
+    while(ordered != nullptr)
+    {
+        std::unique_ptr<Continuation> current(ordered);
+        ordered = ordered->next_;
+        current->func_(inTask);
+    }
+}
+
+void Completion::onComplete(std::function<void(bool)> func)
+{
+    if(!addContinuation(func))
+    {
+        func(false);
+    }
+}
+
+bool Completion::addContinuation(std::function<void(bool)> func)
+{
+    Continuation* head = continuations_.load(std::memory_order_acquire);
+    if(head == closed())
+        return false;
+    auto node = std::make_unique<Continuation>();
+    node->func_ = std::move(func);
+    node->next_ = head;
+    while(!continuations_.compare_exchange_weak(node->next_, node.get(), std::memory_order_acq_rel))
+    {
+        if(node->next_ == closed())
+            return false;
+    }
+    node.release();
+    return true;
+}
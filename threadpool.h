@@ -10,7 +10,29 @@
 #include <condition_variable> //条件变量头文件
 #include <functional>
 #include <unordered_map>
+#include <deque>
 #include <thread>
+#include <tuple>
+#include <optional>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <typeinfo>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <chrono>
+#include <memory_resource>
+#ifdef THREADPOOL_COROUTINES
+#include <coroutine>
+#endif
+
+#include "callable.h"
+#include "stats.h"
+#include "topology.h"
+#include "slab.h"
+#include "timer.h"
+#include "parking.h"
 
 // Any类型：可以接收任意数据的类型
 class Any
@@ -24,8 +46,13 @@ public:
     Any& operator=(Any&&)=default;
 
     template<typename T>//Any(T data):base_(new Derive<T>(data)){}
-    Any(T data):base_(std::make_unique<Derive<T>>(data))
-    {}
+    // 结果对象从slab分配，线程池线程里分配、提交方释放也不用加锁
+    Any(T data)
+    {
+        void* memory = SlabResource::instance()->allocate(sizeof(Derive<T>), alignof(Derive<T>));
+        base_ = std::unique_ptr<Base, Deleter>(new (memory) Derive<T>(std::move(data)),
+                                               Deleter{sizeof(Derive<T>), alignof(Derive<T>)});
+    }
 
     template<typename T>
     T cast_()
@@ -57,54 +84,59 @@ private:
         T data_;
     };
 
+    // 析构后还给slab
+    struct Deleter
+    {
+        size_t size_;
+        size_t align_;
+        void operator()(Base* p) const
+        {
+            p->~Base();
+            SlabResource::instance()->deallocate(p, size_, align_);
+        }
+    };
+
     // 定义一个基(父)类的指针
-    std::unique_ptr<Base> base_;
+    std::unique_ptr<Base, Deleter> base_;
 };
 
-// 实现一个信号量类
-class Semaphore
-{
-public:
-    Semaphore(int limit=0)
-        :resLimit_(limit)
-        ,isExit_(false)
-    {}
+// Task类的提前声明
+class Task;
 
-    //~Semaphore()=default;
-    ~Semaphore()
-    {
-        isExit_=true;
-    }
+using Deadline = std::chrono::steady_clock::time_point;
 
-    //获取一个信号量资源
-    void wait()
-    {
-        if(isExit_)
-            return;
-        // 用条件变量实现信号量
-        std::unique_lock<std::mutex> lock(mtx_);
-        // 等待信号量有资源，没有资源的话，会阻塞当前线程
-        cond_.wait(lock,[&]()->bool{return resLimit_>0;});
-        resLimit_--;
-    }
-    // 增加一个信号量资源
-    void post()
+// 取消令牌：拷贝之间共享同一个标志，cancel()之后所有拷贝都能看到
+// 还在排队的任务出队时发现已取消就直接丢掉，不执行；正在执行的任务可以自己轮询isCancelled()提前结束
+class CancelToken
+{
+public:
+    CancelToken(); // 新建一个令牌
+    CancelToken(std::nullptr_t); // 空令牌，永远不会被取消
+    void cancel();
+    bool isCancelled() const
     {
-        if(isExit_)
-            return;
-        std::unique_lock<std::mutex> lock(mtx_);
-        resLimit_++;
-        cond_.notify_all();//通知其他线程
+        return cancelled_ != nullptr && cancelled_->load(std::memory_order_relaxed);
     }
 private:
-    std::atomic_bool isExit_;// linux和windows下的不同，在linux下的析构函数
-    int resLimit_;// 信号量多少个为满
-    std::mutex mtx_;
-    std::condition_variable cond_;
+    std::shared_ptr<std::atomic_bool> cancelled_;
 };
 
-// Task类的提前声明
-class Task;
+// 任务被取消或者过了截止时间没有执行时，Future::get抛出的异常
+class TaskCancelled : public std::runtime_error
+{
+public:
+    TaskCancelled()
+        : std::runtime_error("task cancelled before it ran.")
+    {}
+};
+
+// 限时等待的结果
+enum class WaitStatus
+{
+    READY, // 任务执行完了
+    TIMEOUT, // 到时间了任务还没执行完
+    CANCELLED, // 任务被取消或者过了截止时间，不会执行了
+};
 
 // 实现接收提交到线程池的task任务执行完成后的返回值类型Result
 class Result
@@ -113,31 +145,604 @@ public:
     Result(std::shared_ptr<Task> task, bool isValid=true);
     ~Result()=default;
 
-    // 问题一：setVal方法，如何获取任务执行完的返回值
-    void setVal(Any any);
     // 问题二：get方法，用户调用这个方法获取task的返回值
+    // 任务被取消没有执行的话返回空的Any
+    // 在线程池自己的线程上调用时不干等，先帮着执行排队的任务(见ThreadPool::helpWait)
     Any get();
+    // 最多等timeout/等到deadline，不取走返回值，READY之后再get()不会阻塞；提交失败的也返回CANCELLED
+    template<typename Rep, typename Period>
+    WaitStatus waitFor(const std::chrono::duration<Rep, Period>& timeout)
+    {
+        return waitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+    WaitStatus waitUntil(Deadline deadline);
 private:
-    Any any_; // 存储任务的返回值
-    Semaphore sem_; //线程通信信号量
-    std::shared_ptr<Task> task_;// 用该只能指针指着的Task对象，不会提前析构掉，因为还有这里指着
-    std::atomic_bool isValid_;//如果任务提交失败，后面结果需要知道该情况以确定是否阻塞等待线程结果
+    friend void waitAll(const std::vector<Result>& results);
+    friend size_t waitAny(const std::vector<Result>& results);
+    // 提交失败的返回空指针
+    const CompletionFlag* flag() const;
+
+    std::shared_ptr<Task> task_;// 返回值和完成标志都存在Task对象里，Result被丢弃（临时对象析构）也不会让线程写到悬空的地址
+    bool isValid_;//如果任务提交失败，后面结果需要知道该情况以确定是否阻塞等待线程结果
+};
+
+// 倒计数器：一批任务共用一个，每完成一个减1，减到0才唤醒等待方
+class Latch
+{
+public:
+    Latch(int count);
+    Latch(const Latch&)=delete;
+    Latch& operator=(const Latch&)=delete;
+
+    void countDown(int n=1);
+    void wait();
+    bool ready() const;
+private:
+    std::atomic_int count_;
+    CompletionFlag done_; // 减到0时设置
+};
+
+// 任务优先级，高优先级的任务先出队；排队太久的低优先级任务会被提升，不会被饿死
+enum class TaskPriority
+{
+    PRIORITY_HIGH,
+    PRIORITY_NORMAL,
+    PRIORITY_LOW,
+};
+const int TASK_PRIORITY_LEVELS = 3;
+
+// submit的可选参数 pool.submit(TaskOptions{TaskPriority::PRIORITY_HIGH, token, deadline}, func, args...)
+struct TaskOptions
+{
+    TaskPriority priority_ = TaskPriority::PRIORITY_NORMAL;
+    CancelToken token_ = nullptr;
+    Deadline deadline_ = Deadline::max(); // 到这个时间还没开始执行就不执行了
+};
+
+// 继承方式的任务的最底层基类，线程只管调exec
+class TaskBase
+{
+public:
+    virtual ~TaskBase();
+    virtual void exec()=0;
+
+    // 取消令牌和截止时间，要在提交之前设置
+    void setCancelToken(CancelToken token);
+    void setDeadline(Deadline deadline);
+    // 令牌已经取消或者已经过了截止时间；出队时检查一次，任务执行中也可以自己轮询
+    bool isCancelled() const;
+    // 线程池按OVERFLOW_DROP_OLDEST把它挤出队列时代替exec调用，在提交方线程上：
+    // Task/Future按取消完成，不执行用户代码；默认照常执行
+    virtual void discard();
+private:
+    CancelToken token_ = nullptr;
+    Deadline deadline_ = Deadline::max();
+};
+
+using TaskFunc = InlineFunction<void()>;
+
+// 队列里存放的一个任务：可调用对象按值存放，不超过TASK_INLINE_SIZE字节的不用堆分配
+// 继承TaskBase的任务也是包一层放进来(只存一个共享指针)
+struct TaskItem
+{
+    TaskItem() = default;
+    TaskItem(TaskFunc func)
+        : func_(std::move(func))
+    {}
+    explicit operator bool() const { return (bool)func_; }
+
+    TaskFunc func_;
+    uint64_t enqueueNs_ = 0; // 入队的时间，统计排队耗时、优先级老化用
 };
 
 // 任务抽象基类
-class Task
+class Task : public TaskBase
 {
 public:
     Task();
     ~Task();
 
-    void exec();// 通过对run进行封装，来
-    void setResult(Result* res);// 通过传入一个Result类对象指针，来接收run的结果
+    void exec() override;// 通过对run进行封装，执行完把返回值存下来并通知Result
+    void discard() override;
     // y用户可以自定义任务类型，从Task继承，重写run方法，实现各种任务处理（多态）
     //virtual void run()=0;
     virtual Any run()=0;
 private:
-    Result* result_;// 用于线程执行完存该线程任务的结果
+    // 通知Result和所在批次的计数器
+    void finish();
+
+    friend class Result;
+    friend class ThreadPool;
+    // 问题一：如何获取任务执行完的返回值 -> 存在任务自己身上，Result通过共享指针来取，两者生命周期绑在一起
+    Any any_; // 存储任务的返回值
+    CompletionFlag done_; // 执行完(或者被取消)时设置，没人等的时候只是一次原子交换
+    std::atomic_bool cancelled_{false}; // 出队时已经取消，没有执行
+    std::shared_ptr<Latch> latch_; // 通过submitBatch提交时，所在批次的计数器
+};
+
+// submitBatch返回的批量结果，整批任务共用一个Latch，wait()等全部完成只需要被唤醒一次
+class BatchResult
+{
+public:
+    BatchResult(std::vector<std::shared_ptr<Task>> tasks, std::shared_ptr<Latch> latch, size_t accepted);
+
+    // 成功提交的任务个数，队列放不下的那部分排在最后，它们的result无效
+    size_t size() const;
+    // 等待成功提交的任务全部执行完
+    void wait();
+    // 第i个任务的返回值
+    Result result(size_t i) const;
+private:
+    std::vector<std::shared_ptr<Task>> tasks_;
+    std::shared_ptr<Latch> latch_;
+    size_t accepted_;
+};
+
+// 类型化任务的完成状态：是否完成、异常，等待和通知
+// 完成只设置一个原子标志，没人等、没挂后续动作的时候不加锁也不唤醒
+class Completion
+{
+public:
+    Completion();
+    ~Completion();
+    Completion(const Completion&)=delete;
+    Completion& operator=(const Completion&)=delete;
+
+    bool ready() const;
+    // 阻塞到任务完成；在线程池自己的线程上调用时边等边执行排队的任务
+    void wait();
+    // 等到任务完成或者到deadline，返回是否完成；不帮着执行任务(执行一个任务可能就超过deadline了)
+    bool waitUntil(Deadline deadline);
+    // 任务没有执行就被取消了
+    bool wasCancelled() const;
+    // 任务完成后在完成它的线程上调用func，已经完成了就在当前线程马上调用
+    // func的参数为true表示是在线程执行完任务的时候调用的，之后这个线程不会再执行用户代码
+    void onComplete(std::function<void(bool)> func);
+    // 同上，但已经完成的话不调用func，返回false
+    bool addContinuation(std::function<void(bool)> func);
+    // waitAll/waitAny用
+    const CompletionFlag& flag() const { return done_; }
+protected:
+    void setError(std::exception_ptr error);
+    void rethrowIfError();
+    // 返回值/异常存好以后调用，唤醒等待的线程；inTask表示是在执行任务的最后调用的
+    void complete(bool inTask = false);
+    // 任务出队时发现已取消，不执行，等待方拿到TaskCancelled异常
+    void completeCancelled(bool inTask);
+private:
+    // 挂上来的后续动作，无锁栈
+    struct Continuation
+    {
+        std::function<void(bool)> func_;
+        Continuation* next_;
+    };
+    // continuations_等于它表示已经完成，不能再挂了
+    static Continuation* closed();
+
+    CompletionFlag done_;
+    bool cancelled_;
+    std::exception_ptr error_;
+    std::atomic<Continuation*> continuations_;
+};
+
+// 保存返回值类型为R的任务结果，不经过Any，没有额外的堆分配和dynamic_cast
+template<typename R>
+class FutureState : public Completion
+{
+    static_assert(!std::is_reference<R>::value, "task can not return a reference");
+public:
+    R get()
+    {
+        wait();
+        rethrowIfError();
+        return std::move(*value_);
+    }
+protected:
+    template<typename Func>
+    void invoke(Func& func, bool inTask = true)
+    {
+        try
+        {
+            value_.emplace(func());
+        }
+        catch(...)
+        {
+            setError(std::current_exception());
+        }
+        complete(inTask);
+    }
+private:
+    std::optional<R> value_;
+};
+
+template<>
+class FutureState<void> : public Completion
+{
+public:
+    void get()
+    {
+        wait();
+        rethrowIfError();
+    }
+protected:
+    template<typename Func>
+    void invoke(Func& func, bool inTask = true)
+    {
+        try
+        {
+            func();
+        }
+        catch(...)
+        {
+            setError(std::current_exception());
+        }
+        complete(inTask);
+    }
+};
+
+// 可调用对象和它的结果放在同一个对象里，make_shared一次分配就够了
+template<typename R, typename Func>
+class FutureTask : public TaskBase, public FutureState<R>
+{
+public:
+    FutureTask(Func func)
+        : func_(std::move(func))
+    {}
+    void exec() override
+    {
+        if(this->isCancelled())
+        {
+            this->completeCancelled(true);
+            return;
+        }
+        this->invoke(func_);
+    }
+    void discard() override
+    {
+        this->completeCancelled(false);// 提交方线程正在提交任务，后继任务不能交给它接着执行
+    }
+    // 任务没能进队列时，直接让等待结果的一方拿到异常
+    void reject(std::exception_ptr error)
+    {
+        this->setError(error);
+        this->complete();
+    }
+private:
+    Func func_;
+};
+
+class ThreadPool;
+template<typename R> class Future;
+
+// then的参数是前一个任务的返回值，void任务的then不带参数
+template<typename R, typename Func>
+struct ContinuationResult
+{
+    using type = std::invoke_result_t<Func, R>;
+};
+template<typename Func>
+struct ContinuationResult<void, Func>
+{
+    using type = std::invoke_result_t<Func>;
+};
+
+// submit返回的句柄，用法同std::future：get()取值（任务抛的异常会在这里重新抛出），wait()只等待
+template<typename R>
+class Future
+{
+public:
+    Future()=default;
+    Future(std::shared_ptr<FutureState<R>> state)
+        : state_(std::move(state))
+    {}
+
+    bool valid() const { return state_ != nullptr; }
+    bool ready() const { return state_->ready(); }
+    void wait() const { state_->wait(); }
+    // 最多等timeout/等到deadline，任务被取消(没有执行)返回CANCELLED，之后get()会抛出TaskCancelled
+    template<typename Rep, typename Period>
+    WaitStatus waitFor(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        return waitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+    WaitStatus waitUntil(Deadline deadline) const
+    {
+        if(!state_->waitUntil(deadline))
+            return WaitStatus::TIMEOUT;
+        return state_->wasCancelled() ? WaitStatus::CANCELLED : WaitStatus::READY;
+    }
+    R get() { return state_->get(); }
+
+    // 本任务完成后在pool上执行func(本任务的返回值)，返回func结果的Future，中间不占用任何线程等待
+    // 完成本任务的线程执行完当前任务直接接着执行func，不经过队列；本任务抛了异常的话func不执行，异常传给返回的Future
+    // 返回值会被移动给func，之后不要再对这个Future调get()
+    template<typename Func>
+    auto then(ThreadPool& pool, Func func) -> Future<typename ContinuationResult<R, Func>::type>;
+
+#ifdef THREADPOOL_COROUTINES
+    // 在协程里 co_await future：任务完成前挂起协程，不占用线程，完成任务的线程接着恢复协程
+    struct Awaiter
+    {
+        std::shared_ptr<FutureState<R>> state_;
+        bool await_ready() const { return state_->ready(); }
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            // 挂上去之前任务已经完成了就不挂起，直接往下执行
+            return state_->addContinuation([handle](bool){ handle.resume(); });
+        }
+        R await_resume() { return state_->get(); }
+    };
+    Awaiter operator co_await() const { return Awaiter{state_}; }
+#endif
+private:
+    template<typename T> friend void waitAll(const std::vector<Future<T>>& futures);
+    template<typename T> friend size_t waitAny(const std::vector<Future<T>>& futures);
+
+    std::shared_ptr<FutureState<R>> state_;
+};
+
+// waitAll/waitAny共用：any为false时等全部完成，否则等任意一个完成并返回它的下标；空指针算已经完成
+size_t waitCompletions(const std::vector<const CompletionFlag*>& flags, bool any);
+
+// 等一组任务全部完成：不管多少个，等待方只睡一次、被唤醒一次(最后一个完成的任务叫醒它)
+// 在线程池自己的线程上调用时和get一样边等边执行排队的任务
+template<typename R>
+void waitAll(const std::vector<Future<R>>& futures)
+{
+    std::vector<const CompletionFlag*> flags;
+    flags.reserve(futures.size());
+    for(const Future<R>& future : futures)
+    {
+        flags.push_back(&future.state_->flag());
+    }
+    waitCompletions(flags, false);
+}
+// 等任意一个完成，返回它的下标；futures为空时返回0
+template<typename R>
+size_t waitAny(const std::vector<Future<R>>& futures)
+{
+    std::vector<const CompletionFlag*> flags;
+    flags.reserve(futures.size());
+    for(const Future<R>& future : futures)
+    {
+        flags.push_back(&future.state_->flag());
+    }
+    return waitCompletions(flags, true);
+}
+// 同上，提交失败的Result算已经完成
+void waitAll(const std::vector<Result>& results);
+size_t waitAny(const std::vector<Result>& results);
+
+// submitAt/submitAfter返回的Future，多一个cancel：还没到期时从时间轮上摘掉，get()抛出TaskCancelled
+template<typename R>
+class TimerFuture : public Future<R>
+{
+public:
+    TimerFuture()=default;
+    TimerFuture(std::shared_ptr<FutureState<R>> state, TimerHandle handle)
+        : Future<R>(std::move(state))
+        , handle_(std::move(handle))
+    {}
+    // 已经到期(开始排队或者执行)的取消不了，返回false
+    bool cancel()
+    {
+        return handle_.cancel();
+    }
+private:
+    TimerHandle handle_;
+};
+
+// 事件计数器：线程空闲时在这里睡眠(linux下直接用futex)，没有线程睡眠时notify只是一次原子读，不加锁不进内核
+// 用法（等待方）：key=prepareWait(); 再检查一次条件; 条件满足cancelWait()，否则commitWait(key)
+class EventCount
+{
+public:
+    EventCount();
+    EventCount(const EventCount&)=delete;
+    EventCount& operator=(const EventCount&)=delete;
+
+    uint32_t prepareWait();
+    void cancelWait();
+    void commitWait(uint32_t key);
+    // 和commitWait一样，但最多睡到deadline
+    void commitWaitUntil(uint32_t key, std::chrono::steady_clock::time_point deadline);
+    // 唤醒一个/count个/全部睡眠的线程
+    void notifyOne();
+    void notify(int count);
+    void notifyAll();
+private:
+    void wake(int count);
+
+    std::atomic<uint32_t> epoch_; // 每次通知加1，等待方睡眠前发现它变了就不睡了
+    std::atomic_int waiters_; // 准备睡和已经睡着的线程数
+#ifndef __linux__
+    std::mutex mtx_;
+    std::condition_variable cond_;
+#endif
+};
+
+// 定长无锁多生产者多消费者环形队列(Dmitry Vyukov的bounded MPMC queue)
+// 每个槽位带一个序号，生产者/消费者各自CAS抢位置，槽位序号告诉对方数据是否已经放好/取走
+template<typename T>
+class RingQueue
+{
+public:
+    // capacity必须是2的幂
+    explicit RingQueue(size_t capacity)
+        : cells_(new Cell[capacity])
+        , mask_(capacity - 1)
+        , enqueuePos_(0)
+        , dequeuePos_(0)
+    {
+        for(size_t i=0;i<capacity;i++)
+        {
+            cells_[i].seq_.store(i, std::memory_order_relaxed);
+        }
+    }
+    RingQueue(const RingQueue&)=delete;
+    RingQueue& operator=(const RingQueue&)=delete;
+
+    // 队列满返回false
+    template<typename U>
+    bool push(U&& value)
+    {
+        Cell* cell;
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq_.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if(dif == 0)
+            {
+                if(enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data_ = std::forward<U>(value);
+        cell->seq_.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 队列空返回false
+    bool pop(T& value)
+    {
+        Cell* cell;
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq_.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(dif == 0)
+            {
+                if(dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data_);
+        cell->seq_.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+private:
+    // 每个槽位(序号+数据)单独占缓存行，相邻槽位上的生产者和消费者不会伪共享
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> seq_;
+        T data_;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    // 生产者和消费者的位置各占一个缓存行，互相写的时候不会伪共享
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+};
+
+// 可增长的环形双端队列：容量按2的幂翻倍，只增不减，稳定以后入队出队都不再分配内存
+// (std::deque每512字节要分配/释放一块)；不是线程安全的
+template<typename T>
+class CircularDeque
+{
+public:
+    CircularDeque()
+        : head_(0)
+        , size_(0)
+    {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    T& front() { return slots_[head_]; }
+
+    void pushBack(T value)
+    {
+        if(size_ == slots_.size())
+            grow();
+        slots_[(head_ + size_) & (slots_.size() - 1)] = std::move(value);
+        size_++;
+    }
+    T popFront()
+    {
+        T value = std::move(slots_[head_]);
+        head_ = (head_ + 1) & (slots_.size() - 1);
+        size_--;
+        return value;
+    }
+    T popBack()
+    {
+        size_--;
+        return std::move(slots_[(head_ + size_) & (slots_.size() - 1)]);
+    }
+private:
+    void grow()
+    {
+        std::vector<T> slots(std::max<size_t>(16, slots_.size() * 2));
+        for(size_t i=0;i<size_;i++)
+        {
+            slots[i] = std::move(slots_[(head_ + i) & (slots_.size() - 1)]);
+        }
+        slots_.swap(slots);
+        head_ = 0;
+    }
+
+    std::vector<T> slots_;
+    size_t head_;
+    size_t size_;
+};
+
+// 多级任务队列：每个优先级一个FIFO，入队出队都是O(1)（只比较几个队头）
+// 老化：低优先级的队头每多等agingNs_就算高一级，比当前最高非空级别高(或平级)了就算"老化"了，
+// 正常情况下仍先出最高级别的任务，但连续跳过老化任务TASK_AGING_RATIO次后必须让它出一次，
+// 这样低优先级至少能分到一部分出队机会，而高优先级任务的排队时间最多多出几个任务的执行时间
+// 不是线程安全的，由ThreadPool在taskQueMtx_下使用
+class MultiLevelQueue
+{
+public:
+    MultiLevelQueue();
+
+    // 每多等多久提升一级
+    void setAging(uint64_t agingNs);
+    // 某个优先级最多排队的任务数
+    void setLimit(TaskPriority priority, size_t limit);
+    size_t limit(TaskPriority priority) const;
+
+    bool empty() const;
+    size_t size() const;
+    size_t size(TaskPriority priority) const;
+
+    // 放进priority对应的队列
+    void push(TaskItem task, TaskPriority priority);
+    // 取一个任务，队列空时返回空任务
+    TaskItem pop();
+    // 取最高的非空级别里最新放进去的任务，不管老化；helpWait用
+    TaskItem popNewest();
+    // 给priority的新任务腾一个位置：这个优先级自己满了就挤掉它排队最久的，
+    // 否则从最低优先级开始挤，不会挤掉比新任务优先级高的；没有可挤的返回空任务
+    TaskItem dropOldest(TaskPriority priority);
+private:
+    CircularDeque<TaskItem> levels_[TASK_PRIORITY_LEVELS];
+    size_t limits_[TASK_PRIORITY_LEVELS];
+    size_t size_;
+    uint64_t agingNs_;
+    int skipped_; // 已经连续跳过老化任务的次数
 };
 
 // 线程池支持模式
@@ -145,6 +750,49 @@ enum class PoolMode
 {
     MODE_FIXED, // 线程固定数量模式
     MODE_CACHED, // 线程数量可动态增长模式
+    MODE_STEALING, // 工作窃取模式：线程数量固定，每个线程有自己的本地队列，空闲时去别的线程队列里偷任务
+};
+
+// 外部提交任务用的全局队列的实现方式
+enum class QueueMode
+{
+    MODE_MUTEX, // std::queue + 互斥锁 + 条件变量
+    MODE_RING, // 定长无锁环形队列，容量由setTaskQueMaxThreshHold决定，线程只在队列空时睡眠（cached模式不支持，仍用互斥锁队列）
+    MODE_SHARDED, // 拆成多个注入队列，每个提交线程固定用其中一个，线程从自己那个开始轮流取；
+                  // 容量按总任务数近似判断，不区分优先级（cached模式不支持，仍用互斥锁队列）
+};
+
+// 线程没任务时怎么等
+enum class IdlePolicy
+{
+    IDLE_PARK, // 直接睡眠，等提交方唤醒
+    IDLE_SPIN, // 先自旋(pause)一段时间，再让出CPU几次，还没任务才睡眠；自旋窗口按最近有没有等到任务自适应，
+               // 同时自旋的线程不超过线程数的一半，池子真的空闲时窗口很快缩到最小，不会一直占着CPU
+};
+
+// 线程绑核方式(linux下用pthread_setaffinity_np，其他平台忽略)
+enum class AffinityMode
+{
+    AFFINITY_NONE, // 不绑核，由系统调度
+    AFFINITY_CPUSET, // 所有线程都绑在同一个CPU集合上(setCpuSet，不设就是全部CPU)
+    AFFINITY_CORE, // 每个线程绑一个核，按NUMA节点依次排满
+    AFFINITY_NODE, // 每个线程绑在一个NUMA节点的所有核上，线程在节点之间轮流分配
+};
+
+// 队列满了时提交方怎么办
+enum class OverflowPolicy
+{
+    OVERFLOW_BLOCK, // 等队列有空位，最多等setSubmitTimeout设置的时间(默认1s)，还放不进去就失败
+    OVERFLOW_FAIL, // 不等，马上失败
+    OVERFLOW_CALLER_RUNS, // 在提交方线程上直接执行，提交方自然就慢下来了
+    OVERFLOW_DROP_OLDEST, // 挤掉排队最久的任务(不执行，Result/Future按取消完成)，放进新任务；工作窃取的本地队列不限长度不受影响
+};
+
+// shutdown时排队的任务怎么处理
+enum class ShutdownMode
+{
+    SHUTDOWN_DRAIN, // 排队的任务全部执行完再退出(析构时就是这样)
+    SHUTDOWN_DISCARD, // 排队的任务不执行，线程做完手上的任务就退出
 };
 
 //enum PoolMode2 如果枚举名不同，枚举值名相同，直接使用下面两个值不知道用的是PoolMode1还是2
@@ -153,22 +801,45 @@ enum class PoolMode
 //    MODE_CACHED, // 线程数量可动态增长模式
 //};
 
+#ifdef THREADPOOL_COROUTINES
+// co_await pool.schedule() 返回的等待对象：把协程放进线程池的队列，由线程池的线程恢复执行
+class ScheduleAwaiter
+{
+public:
+    ScheduleAwaiter(ThreadPool* pool)
+        : pool_(pool)
+    {}
+    bool await_ready() const { return false; }
+    // 队列满了放不进去就不挂起，在当前线程接着执行
+    bool await_suspend(std::coroutine_handle<> handle);
+    void await_resume() const {}
+private:
+    ThreadPool* pool_;
+};
+#endif
+
 // 线程类型
 class Thread
 {
 public:
-    using ThreadFunc=std::function<void(int)>;//定义一个返回void的函数对象
+    using ThreadFunc=InlineFunction<void(int)>;//定义一个返回void的函数对象 只能移动，不用堆分配
     //线程构造
     Thread(ThreadFunc func);//接收一个函数
-    //线程析构
+    //线程析构 线程还没结束的话等它结束
     ~Thread();
+    // 线程启动后先绑到这些CPU上再执行线程函数，空表示不绑
+    void setAffinity(std::vector<int> cpus);
     //启动线程
     void start();
+    // 等线程结束，不能在这个线程自己里面调用
+    void join();
     // 获取线程id
     int getId() const;
 private:
     ThreadFunc func_;
-    static int generateId_;
+    std::thread thread_;
+    std::vector<int> cpus_;
+    static std::atomic_int generateId_; // 所有线程池共用，多个线程池同时建线程也不会重号
     int threadId_; // 保存线程id,用于在线程函数回收自己时，搞清自己在线程vector容器的位置
 };
 
@@ -184,14 +855,28 @@ class MyTask : public Task
  };
                        # 把指针和分配的内存放一起，防止不能释放
  pool.submitTask(std::make_shared<MyTask>());
+ // 或者 pool.submitTask(pool.makeTask<MyTask>()); 任务对象从每线程slab分配
+
+ // 或者不用继承Task，直接提交函数，拿带类型的返回值
+ Future<int> res = pool.submit([](int a, int b){ return a + b; }, 1, 2);
+ int sum = res.get();
 */
 
+// 线程池线程的身份，任务里用ThreadPool::currentWorker()取
+struct WorkerInfo
+{
+    ThreadPool* pool = nullptr;
+    int threadId = -1; // Thread的编号，和WorkerStats::threadId一样
+    int index = -1; // 本轮start以来按创建顺序的序号，从0开始；cached模式后来加的线程接着往后编，回收了不重用
+};
+
 // 线程池类型
 class ThreadPool
 {
 public:
     // 线程池 构造和析构
     ThreadPool();
+    // 可以在线程池自己线程执行的任务里析构：这个线程不join，任务返回后自己退出
     ~ThreadPool();
 
     // 设置线程池的工作模式
@@ -199,36 +884,384 @@ public:
 
     // 设置task任务队列上线阈值
     void setTaskQueMaxThreshHold(int threshhold);
+    // 设置某个优先级的排队任务上限，和总的阈值同时生效
+    void setTaskQueMaxThreshHold(TaskPriority priority, int threshhold);
+    // 设置低优先级任务每等多久提升一级，默认100ms
+    void setTaskPriorityAging(int ms);
+
+    // 设置全局任务队列的实现方式
+    void setQueueMode(QueueMode mode);
+    // MODE_SHARDED的注入队列个数，默认0表示和初始线程数一样
+    void setInjectShards(int shards);
+    // 线程没任务时怎么等，默认IDLE_PARK
+    void setIdlePolicy(IdlePolicy policy);
+
+    // 队列满了时的处理方式，默认OVERFLOW_BLOCK
+    void setOverflowPolicy(OverflowPolicy policy);
+    // OVERFLOW_BLOCK最多等多久，默认1000ms
+    void setSubmitTimeout(int ms);
+    // 按内存限制排队的任务：队列自己占的字节数(每个任务sizeof(TaskItem)，加上放不进内部缓冲区的可调用对象)
+    // 超过bytes就算满，和任务个数的阈值同时生效；Task/Future的共享对象由提交方持有，不算在内；0表示不限
+    void setTaskQueMaxBytes(size_t bytes);
+
+    // 设置任务对象(makeTask、submit、then)的内存来源，默认是每线程slab(SlabResource)，
+    // 传std::pmr::new_delete_resource()就是普通的new/delete；resource要比线程池活得久
+    void setMemoryResource(std::pmr::memory_resource* resource);
+
+    // 创建一个任务对象，对象和引用计数一起从setMemoryResource指定的内存里分配
+    // pool.submitTask(pool.makeTask<MyTask>(args...));
+    template<typename T, typename... Args>
+    std::shared_ptr<T> makeTask(Args&&... args)
+    {
+        return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(memoryResource_), std::forward<Args>(args)...);
+    }
 
     // 设置线程池cached模式下线程阈值
     void setThreadSizeThreshHold(int threshhold);
 
+    // 设置线程绑核方式；AFFINITY_CORE/AFFINITY_NODE并且机器有多个NUMA节点时，
+    // 全局队列按节点拆成子队列，提交方放进自己所在节点的队列，线程先取本节点的再取别的节点的
+    // (cached模式和无锁环形队列只绑核，不拆队列)
+    void setAffinity(AffinityMode mode);
+    // 只用这些CPU(编号同/sys/devices/system/cpu)，不设就是全部CPU
+    void setCpuSet(std::vector<int> cpus);
+    // 指定NUMA拓扑，不设的话start时从/sys/devices/system/node读
+    void setTopology(Topology topology);
+
+    // 每个线程启动时(包括cached模式后来加的线程)在这个线程上调用init，退出时(shutdown、cached模式空闲回收)调用exit
+    // 都在线程池的锁外面，init执行完线程才开始取任务；两个函数都不能抛异常
+    void setWorkerHooks(std::function<void(const WorkerInfo&)> init, std::function<void(const WorkerInfo&)> exit = nullptr);
+    // 每个线程一个T类型的上下文对象(临时缓冲区、压缩上下文、数据库连接之类每个任务都重新建太贵的东西)：
+    // 线程启动时用factory在这个线程上创建(在init之前)，线程退出时析构(在exit之后)，线程上执行的任务用workerContext<T>()取
+    // 同一时刻只有这个线程在用它，不需要加锁；factory不能抛异常
+    template<typename T>
+    void setWorkerContext(std::function<std::unique_ptr<T>(const WorkerInfo&)> factory)
+    {
+        setContextFactory(typeid(T), [factory = std::move(factory)](const WorkerInfo& worker) -> std::shared_ptr<void>
+        {
+            return std::shared_ptr<T>(factory(worker));
+        });
+    }
+    // 同上，T默认构造
+    template<typename T>
+    void setWorkerContext()
+    {
+        setWorkerContext<T>([](const WorkerInfo&) { return std::make_unique<T>(); });
+    }
+    // 当前线程是线程池的线程时返回它的身份，否则返回nullptr；任务、init/exit、上下文的构造和析构里都可以用
+    static const WorkerInfo* currentWorker();
+    // 当前线程的上下文对象，不是线程池的线程、线程池没有设置上下文或者类型不是T都返回nullptr
+    template<typename T>
+    static T* workerContext()
+    {
+        WorkerSlot* slot = tlsWorker_;
+        if(slot == nullptr || slot->contextType_ == nullptr || *slot->contextType_ != typeid(T))
+            return nullptr;
+        return static_cast<T*>(slot->context_.get());
+    }
+
     // 给线程池提交任务
-    Result submitTask(std::shared_ptr<Task> sp);
+    // 优先级只在互斥锁队列(MODE_MUTEX)上生效；无锁环形队列和工作窃取的本地队列仍按提交顺序执行
+    Result submitTask(std::shared_ptr<Task> sp, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+
+    // 一次提交一批任务：只加一次锁、只等一次队列空位，最多唤醒min(任务数, 空闲线程数)个线程
+    BatchResult submitBatch(std::vector<std::shared_ptr<Task>> tasks,
+                            TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    // 队列满了马上返回无效的Result，不管setOverflowPolicy设的是什么
+    Result trySubmitTask(std::shared_ptr<Task> sp, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+
+    template<typename Iter>
+    BatchResult submitBatch(Iter first, Iter last, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return submitBatch(std::vector<std::shared_ptr<Task>>(first, last), priority);
+    }
+
+    // 提交任意可调用对象和参数，返回带类型的Future：不用继承Task，不用Any，整个任务只有一次堆分配
+    // 队列满了提交失败时，Future::get会抛出std::runtime_error
+    template<typename Func, typename... Args>
+    auto submit(Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submit(TaskOptions(), std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+    // 带优先级提交 pool.submit(TaskPriority::PRIORITY_HIGH, func, args...)
+    template<typename Func, typename... Args>
+    auto submit(TaskPriority priority, Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submit(TaskOptions{priority}, std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+    // 带取消令牌/截止时间提交：出队时已经取消或者过了截止时间就不执行，Future::get抛出TaskCancelled
+    // func要在执行中途响应取消的话，自己捕获一份令牌去轮询
+    template<typename Func, typename... Args>
+    auto submit(TaskOptions options, Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submitWith(overflowPolicy_, std::move(options), std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+    // 队列满了马上失败(Future::get抛出std::runtime_error)，不管setOverflowPolicy设的是什么
+    template<typename Func, typename... Args>
+    auto trySubmit(Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submitWith(OverflowPolicy::OVERFLOW_FAIL, TaskOptions(), std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+    template<typename Func, typename... Args>
+    auto trySubmit(TaskOptions options, Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submitWith(OverflowPolicy::OVERFLOW_FAIL, std::move(options), std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    // 定时任务：线程池自己的定时线程(分层时间轮)到期后把它们成批放进任务队列，和普通任务一样排队执行
+    // 不会提前执行，晚多少取决于setTimerResolution(默认1ms)和队列里排着的任务；队列放不下时按取消处理
+    // shutdown时还没到期的不再执行，只执行一次的和没执行的任务一起返回
+    template<typename Func, typename... Args>
+    auto submitAfter(std::chrono::steady_clock::duration delay, Func&& func, Args&&... args)
+        -> TimerFuture<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        return submitAt(std::chrono::steady_clock::now() + delay, std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+    template<typename Func, typename... Args>
+    auto submitAt(Deadline time, Func&& func, Args&&... args)
+        -> TimerFuture<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        using R = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+        auto call = [func = std::forward<Func>(func),
+                     params = std::make_tuple(std::forward<Args>(args)...)]() mutable -> R
+        {
+            return std::apply(func, std::move(params));
+        };
+        auto task = makeTask<FutureTask<R, decltype(call)>>(std::move(call));
+        TimerHandle handle = scheduleTimer(time, std::chrono::nanoseconds(0), std::move(wrapTask(task).func_));
+        return TimerFuture<R>(task, std::move(handle));
+    }
+    // 每隔period执行一次func，第一次在一个period以后；上一次执行完才会排下一次，不会重叠，
+    // 下一次按上一次的计划时间加period算，不会越来越晚；落后超过一个周期的话错过的几次不补
+    template<typename Func>
+    TimerHandle submitEvery(std::chrono::steady_clock::duration period, Func&& func)
+    {
+        return scheduleTimer(std::chrono::steady_clock::now() + period, period, TaskFunc(std::forward<Func>(func)));
+    }
+    // 定时任务的精度(时间轮一个tick)，默认1000us
+    void setTimerResolution(int us);
 
-    // 开启线程池
+#ifdef THREADPOOL_COROUTINES
+    // 在协程里 co_await pool.schedule()，之后的代码在线程池的线程上执行
+    ScheduleAwaiter schedule();
+#endif
+
+    // 提交一个不需要返回值的可调用对象：按值放进队列，对象不超过TASK_INLINE_SIZE字节时整个过程没有堆分配
+    // 队列满了提交失败返回false；func抛出的异常不会被捕获
+    template<typename Func>
+    bool post(Func&& func, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return pushTask(wrapPost(std::forward<Func>(func)), priority);
+    }
+    // 队列满了马上返回false，不管setOverflowPolicy设的是什么
+    template<typename Func>
+    bool tryPost(Func&& func, TaskPriority priority = TaskPriority::PRIORITY_NORMAL)
+    {
+        return pushTask(wrapPost(std::forward<Func>(func)), priority, OverflowPolicy::OVERFLOW_FAIL);
+    }
+
+    // 开启线程池 shutdown之后可以再次start，已经在运行的话不做任何事
     void start(int initThreadSize = std::thread::hardware_concurrency());//默认构造同核心数量的线程数
 
+    // 停止线程池，等所有线程退出(join)后返回没有执行的任务，之后可以重新start
+    // 返回的任务可以自己执行(task.func_())，或者交给discardTask让等待的Result/Future按取消完成，直接丢掉的话等待方会一直等
+    // 线程手上正在执行的任务总会执行完；不能在线程池自己的线程里调用(抛出std::logic_error)
+    std::vector<TaskItem> shutdown(ShutdownMode mode = ShutdownMode::SHUTDOWN_DRAIN);
+    // 排队的任务执行到deadline为止，剩下的不执行
+    std::vector<TaskItem> shutdown(Deadline deadline);
+
+    // 丢掉一个没执行的任务：Task/Future按取消完成，post的不执行；then、任务图、协程这些内部任务不能丢，照常执行
+    static void discardTask(TaskItem task);
+
+    // 当前线程池里线程的总数量
+    int getThreadSize() const;
+
+    // 统计快照：提交/完成/拒绝的任务数，队列深度，排队和执行耗时直方图，每个线程的忙/闲/窃取计数
+    // 执行相关的计数每个线程各记各的，这里只是把它们读出来合并，不影响线程干活
+    PoolStats stats() const;
+    // 把统计快照按Prometheus文本格式写到文件，或者交给回调（比如挂到自己的http接口上）
+    bool exportStats(const std::string& path) const;
+    void exportStats(const std::function<void(const std::string&)>& callback) const;
+
     // 禁止拷贝构造和赋值构造
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&)=delete;
 private:
+    // 线程入口：创建上下文、调init，执行线程函数，线程函数返回(线程池结束或者被回收)后调exit、析构上下文
+    void workerMain(int threadid, int index, bool useWorkFunc);
     // 定义线程函数
     void threadFunc(int threadid);//传入线程号参数
 
+    // 任务放进队列，失败（队列满）返回false；记录入队时间和提交计数后调用enqueueTask
+    // 队列满了按policy处理，不带policy的用setOverflowPolicy设的
+    bool pushTask(TaskItem task, TaskPriority priority = TaskPriority::PRIORITY_NORMAL);
+    bool pushTask(TaskItem task, TaskPriority priority, OverflowPolicy policy);
+    // 放不进去返回false，task不会被移走；OVERFLOW_DROP_OLDEST挤出来的任务放在dropped里，由调用方在锁外丢弃
+    bool enqueueTask(TaskItem&& task, TaskPriority priority, OverflowPolicy policy, std::vector<TaskItem>& dropped);
+    // submit/trySubmit共用，policy是队列满了时的处理方式
+    template<typename Func, typename... Args>
+    auto submitWith(OverflowPolicy policy, TaskOptions options, Func&& func, Args&&... args)
+        -> Future<std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>>
+    {
+        using R = std::invoke_result_t<std::decay_t<Func>, std::decay_t<Args>...>;
+        auto call = [func = std::forward<Func>(func),
+                     params = std::make_tuple(std::forward<Args>(args)...)]() mutable -> R
+        {
+            return std::apply(func, std::move(params));
+        };
+        auto task = std::allocate_shared<FutureTask<R, decltype(call)>>(
+            std::pmr::polymorphic_allocator<FutureTask<R, decltype(call)>>(memoryResource_), std::move(call));
+        task->setCancelToken(std::move(options.token_));
+        task->setDeadline(options.deadline_);
+        if(!pushTask(wrapTask(task), options.priority_, policy))
+        {
+            task->reject(std::make_exception_ptr(std::runtime_error("task queue is full, submit task fail.")));
+        }
+        return Future<R>(task);
+    }
+
+    // 继承TaskBase的任务包成队列里的任务
+    static TaskItem wrapTask(std::shared_ptr<TaskBase> sp);
+    // 定时器挂到时间轮上，第一次用的时候才启动定时线程；period为0表示只执行一次
+    TimerHandle scheduleTimer(Deadline time, std::chrono::nanoseconds period, TaskFunc func);
+    // 定时线程上调用：到期的一批放进任务队列
+    void dispatchTimers(TimerService& service, std::vector<std::shared_ptr<TimerNode>>& due);
+    // 停掉定时线程，返回还没到期的只执行一次的定时任务
+    std::vector<TaskItem> stopTimers();
+    // post的可调用对象包成队列里的任务，被OVERFLOW_DROP_OLDEST挤掉时不执行
+    template<typename Func>
+    static TaskItem wrapPost(Func&& func)
+    {
+        return TaskItem(TaskFunc([func = std::forward<Func>(func)]() mutable
+        {
+            if(!takeDiscard())
+                func();
+        }));
+    }
+    // 当前是不是在discardTask里，读完就清掉
+    static bool takeDiscard();
+    // 任务在队列里占的字节数，按内存限制队列时用
+    static size_t taskBytes(const TaskItem& task);
+    // 再放bytes字节还在内存限制以内
+    bool bytesFit(size_t bytes) const;
+    // 任务入队前/出队后调用：加上/减掉它占的字节数
+    void reserveBytes(const TaskItem& task);
+    void releaseBytes(const TaskItem& task);
+    // 环形队列的容量向上取到2的幂，排队任务数按阈值另外限制：先在taskSize_上占一个名额再放，占不到返回false
+    bool reserveRingSlot();
+    // 分片/环形队列满了：在notFullEvent_上睡到有任务被取走或者到deadline，登记以后hasSpace已经成立就不睡
+    template<typename Pred>
+    void waitNotFull(Pred hasSpace, std::chrono::steady_clock::time_point deadline)
+    {
+        uint32_t key = notFullEvent_.prepareWait();
+        if(hasSpace())
+        {
+            notFullEvent_.cancelWait();
+            return;
+        }
+        notFullEvent_.commitWaitUntil(key, deadline);
+    }
+    // 一批任务放进队列，返回放进去的个数(从头开始数)
+    size_t pushBatch(const std::shared_ptr<Task>* tasks, size_t size, TaskPriority priority);
+    // 只有policy为OVERFLOW_BLOCK时才等队列空位，其他都是能放多少放多少
+    size_t enqueueBatch(TaskItem* tasks, size_t size, TaskPriority priority, OverflowPolicy policy);
+    // 更新排队任务数的历史最大值
+    void updatePeakTaskSize();
+    // setWorkerContext的类型擦除部分
+    void setContextFactory(const std::type_info& type, std::function<std::shared_ptr<void>(const WorkerInfo&)> factory);
+    // 线程启动时登记自己的计数器
+    WorkerCounters* registerWorker(int threadid);
+    // 线程退出时把它的计数并进retiredStats_，再删掉它的计数器
+    void unregisterWorker(WorkerCounters* counters);
+    // 执行一个取到的任务，顺带记录排队/执行/空闲时间，lastEnd是本线程上一个任务结束的时间
+    // 任务执行中交给本线程的后继任务(tlsNextTask_)接着在这里执行
+    void runTask(WorkerCounters& counters, TaskItem task, uint64_t& lastEnd);
+    // cached模式：提交方只叫醒控制线程，由控制线程决定加线程还是回收线程
+    void kickController();
+    void controlThreadFunc();
+    void addThread();
+    uint64_t completedTaskCount() const;
+
+    // 工作窃取模式/无锁队列模式的线程函数，空闲时在idleEvent_上睡眠
+    void workThreadFunc(int threadid);
+    // IDLE_SPIN时睡眠前先自旋等任务，等到了返回true；spinLimit是这个线程当前的自旋次数，按结果调整
+    bool spinForTask(int& spinLimit);
+    // 取任务：本地队列尾部(LIFO) -> 全局队列 -> 其他线程本地队列头部(FIFO)，index为-1表示没有本地队列
+    TaskItem takeTask(int index);
+    TaskItem popLocalTask(int index);
+    TaskItem popNodeTask();
+    TaskItem popGlobalTask();
+    TaskItem stealTask(int index);
+    // helpWait取任务：先从本地队列、本节点(分片)队列、全局队列里取最新放进去的(多半是自己刚提交的子任务)，
+    // 嵌套执行的层数跟着递归深度走，不会因为先执行了排在前面的大任务而越嵌越深；都没有再按takeTask的顺序取
+    TaskItem takeHelpTask();
+
+    // 第index个线程绑哪些CPU，node返回它所在的NUMA节点下标(不确定为-1)
+    std::vector<int> placeWorker(int index, int& node) const;
+    // 提交方所在的NUMA节点下标
+    int submitNode() const;
+
     // 检查pool的运行状态
     bool checkRunningState() const;
 
+    std::vector<TaskItem> shutdown(ShutdownMode mode, Deadline deadline);
+    // 取出所有队列里还在排队的任务
+    std::vector<TaskItem> takePending();
+    // join已经回收(cached模式空闲退出)的线程
+    void joinRetiredThreads();
+
+    // 后继任务(then、任务图)就绪时调用：inTask表示调用方正在结束一个任务，当前线程又是本池的线程并且还没有接手别的后继，
+    // 就不进队列，当前任务执行完直接执行它；否则和普通任务一样入队，入队失败返回false
+    // (任务执行到一半时不能放进去，任务接着阻塞等它的话就死锁了)
+    bool dispatchTask(TaskItem task, bool inTask);
+    // 池内线程在任务里等另一个任务的结果时(Result::get、Future::get/wait、BatchResult::wait)，不阻塞着占住线程：
+    // done()不成立就从队列取任务在当前线程执行，先取本地队列尾部(多半是自己刚拆出来的子任务)；
+    // 取不到说明要等的任务正在别的线程上执行，用waitUntil睡一会儿，醒来再看有没有新的任务(比如它拆出来的子任务)
+    // 递归拆分的任务(fork-join)在固定线程数的池里不会因为所有线程都在等而死锁
+    // (MODE_RING的无锁队列只能按顺序取，先执行的是排在前面的大任务，嵌套会深得多，递归拆分的任务用别的队列)
+    // 返回false表示当前线程不是线程池的线程(或者嵌套太深)，调用方自己阻塞等
+    // 注意被执行的任务和等待方在同一个线程上：等待方拿着的锁，被执行的任务再去拿(不可重入的锁)会死锁
+    static bool helpWait(const std::function<bool()>& done, const std::function<bool(Deadline)>& waitUntil);
+    template<typename R> friend class Future;
+    friend class TaskGraph;
+    friend class Result;
+    friend class Completion;
+    friend class Latch;
+    friend size_t waitCompletions(const std::vector<const CompletionFlag*>& flags, bool any);
+#ifdef THREADPOOL_COROUTINES
+    friend class ScheduleAwaiter;
+#endif
+
 private:
+    // 工作窃取模式下每个线程拥有的本地双端队列
+    struct WorkQueue
+    {
+        std::mutex mtx_;
+        CircularDeque<TaskItem> deque_;
+    };
+    // 线程自己的身份和上下文，在workerMain的栈上，线程活多久它就活多久
+    struct WorkerSlot
+    {
+        WorkerInfo info_;
+        std::shared_ptr<void> context_;
+        const std::type_info* contextType_ = nullptr;
+    };
+
     //std::vector<Thread*> threads_; //线程列表 使用智能指针析构如下
     //std::vector<std::unique_ptr<Thread>> threads_; //线程列表 改成map如下 线程号+线程
     std::unordered_map<int, std::unique_ptr<Thread>> threads_;
+    std::vector<std::unique_ptr<Thread>> retiredThreads_; // 自己退出了、还没join的线程(cached模式回收的)
     size_t initThreadSize_; //初始的线程数量
     int threadSizeThreshHold_; // 线程数量上限阈值
     std::atomic_int curThreadSize_; // 记录当前线程池里面线程的总数量
     std::atomic_int idleThreadSize_; // 记录空闲线程的数量 用以判断：任务多线程固定不够，加；任务少线程多了，减
 
-    std::queue<std::shared_ptr<Task>> taskQue_;//任务队列 用智能指针的共享拉长其生命周期//run()完再自动释放
+    MultiLevelQueue taskQue_;//任务队列 每个优先级一个FIFO 用智能指针的共享拉长其生命周期//run()完再自动释放
     std::atomic_int taskSize_; // 由于多线程接任务-1，用户加任务+1,要确保线程任务数字安全
     int taskQueMaxThreshHold_; // 任务队列数量上限阈值
 
@@ -236,11 +1269,109 @@ private:
     // 条件变量
     std::condition_variable notFull_;//用户条件变量 不满可加任务
     std::condition_variable notEmpty_;//线程列表条件变量 不空可执行线程
-    std::condition_variable exitCond_;// 等到线程资源全部回收 用以沟通多线程和主线程 多线程全结束主线程再结束
+    std::condition_variable exitCond_;// 线程退出时通知，shutdown(deadline)等排队任务执行完用
 
     PoolMode poolMode_;// 当前线程池的工作模式
     std::atomic_bool isPoolRunning_; // 表示当前线程池的启动状态 保证set各种池属性在启动前
 
+    // cached模式的控制线程，线程的创建和回收都由它来做，不占用提交方的时间
+    std::thread controlThread_;
+    std::mutex controlMtx_;
+    std::condition_variable controlCond_;
+    std::atomic_bool controlKicked_; // 提交方已经叫过控制线程了
+    int retireThreadSize_; // 控制线程要求回收的线程数，空闲线程领走名额后退出，受taskQueMtx_保护
+
+    // 工作窃取模式：taskQue_作为外部线程提交任务的注入队列，池内线程提交的任务放进自己的本地队列
+    std::vector<std::unique_ptr<WorkQueue>> localQues_; // 下标即线程在池内的序号
+    std::unordered_map<int, int> localQueIndex_; // 线程id => 本地队列下标，start时建好之后只读
+
+    QueueMode queueMode_; // 全局任务队列的实现方式
+    int injectShards_; // MODE_SHARDED的注入队列个数
+    IdlePolicy idlePolicy_;
+    uint64_t timerTickNs_; // 时间轮一个tick的长度
+    std::mutex timerMtx_; // 保护timers_这个指针
+    std::shared_ptr<TimerService> timers_; // 第一次提交定时任务时创建，shutdown时停掉
+    std::atomic_int spinningThreads_; // 正在自旋等任务的线程数
+    std::unique_ptr<RingQueue<TaskItem>> taskRing_; // MODE_RING时代替taskQue_，start时按阈值创建
+    std::atomic_bool ringBacklog_; // MODE_RING：start之前提交的任务环形队列放不下，还有剩在taskQue_里的
+    std::pmr::memory_resource* memoryResource_; // 任务对象的内存来源
+
+    // 队列满了时的处理
+    OverflowPolicy overflowPolicy_;
+    std::chrono::milliseconds submitTimeout_; // OVERFLOW_BLOCK最多等多久
+    size_t taskQueMaxBytes_; // 0表示不按内存限制
+    std::atomic<int64_t> queuedBytes_; // 排队任务占的字节数，taskQueMaxBytes_不为0时才统计(出队可能先于入队计数，所以有符号)
+    std::atomic<uint64_t> droppedCount_;
+    std::atomic<uint64_t> callerRunsCount_;
+    EventCount idleEvent_; // workThreadFunc的线程空闲时在这里睡眠
+    EventCount notFullEvent_; // 分片队列/环形队列满了，OVERFLOW_BLOCK的提交方在这里睡眠，取走任务时通知
+
+    // 绑核和NUMA
+    AffinityMode affinityMode_;
+    std::vector<int> cpuSet_; // 允许使用的CPU，start时按节点排好序
+    Topology topology_;
+    std::vector<std::unique_ptr<WorkQueue>> nodeQues_; // 每个NUMA节点(MODE_SHARDED时每个分片)一个子队列，不拆队列时为空
+    std::unordered_map<int, int> workerNode_; // 线程id => 节点(分片)下标，start时建好之后只读
+
+    // 线程的初始化/退出钩子和上下文，start之前设置，之后只读
+    std::function<void(const WorkerInfo&)> workerInit_;
+    std::function<void(const WorkerInfo&)> workerExit_;
+    std::function<std::shared_ptr<void>(const WorkerInfo&)> contextFactory_;
+    const std::type_info* contextType_;
+    int nextWorkerIndex_; // 下一个线程的WorkerInfo::index，受taskQueMtx_保护(start里只有一个线程)
+
+    // 统计：提交方的计数放在这里，执行方的计数每个线程一份
+    std::atomic<uint64_t> submittedCount_;
+    std::atomic<uint64_t> rejectedCount_;
+    std::atomic_int peakTaskSize_;
+    mutable std::mutex statsMtx_; // 保护workerStats_这个列表本身和下面退出线程的汇总，计数器的读写不需要它
+    std::vector<std::unique_ptr<WorkerCounters>> workerStats_; // 按线程创建顺序，只有还没退出的线程
+    WorkerStats retiredStats_; // 已经退出的线程的计数合在一起，不然cached模式反复回收/创建时列表会一直变长
+    Histogram retiredWait_;
+    Histogram retiredExec_;
+    uint64_t exitedThreads_; // 已经退出的线程数
+    static thread_local WorkerCounters* tlsStats_; // 当前线程的计数器
+    static thread_local ThreadPool* tlsPool_; // 当前线程所属的线程池(非池内线程为nullptr)
+    static thread_local WorkQueue* tlsQue_; // 当前线程的本地队列
+    static thread_local int tlsIndex_; // 当前线程的本地队列下标，没有本地队列为-1
+    static thread_local int tlsHelpDepth_; // 当前线程嵌套在几层helpWait里
+    static thread_local int tlsNode_; // 当前线程所在的NUMA节点(分片)下标
+    static thread_local int tlsShard_; // 外部线程提交时用的分片，第一次提交时分配
+    static std::atomic_int nextShard_; // 给提交线程轮流分配分片
+    static thread_local WorkerSlot* tlsWorker_; // 当前线程的身份和上下文(非池内线程为nullptr)
+    static thread_local TaskItem tlsNextTask_; // 当前任务执行完接着执行的后继任务
+    static thread_local bool tlsOrphaned_; // 线程池在当前线程执行的任务里析构了，任务返回后线程函数直接退出
+    static thread_local bool tlsDiscard_; // discardTask正在丢弃的任务，包装它的函数读到后不执行用户代码
+
 };
 
+template<typename R>
+template<typename Func>
+auto Future<R>::then(ThreadPool& pool, Func func) -> Future<typename ContinuationResult<R, Func>::type>
+{
+    using U = typename ContinuationResult<R, Func>::type;
+    auto call = [state = state_, func = std::move(func)]() mutable -> U
+    {
+        if constexpr(std::is_void_v<R>)
+        {
+            state->get();// 前一个任务的异常在这里抛出，由FutureTask存到新的Future里
+            return func();
+        }
+        else
+        {
+            return func(state->get());
+        }
+    };
+    auto task = std::allocate_shared<FutureTask<U, decltype(call)>>(
+        std::pmr::polymorphic_allocator<FutureTask<U, decltype(call)>>(pool.memoryResource_), std::move(call));
+    state_->onComplete([&pool, task](bool inTask)
+    {
+        if(!pool.dispatchTask(ThreadPool::wrapTask(task), inTask))
+        {
+            task->reject(std::make_exception_ptr(std::runtime_error("task queue is full, submit task fail.")));
+        }
+    });
+    return Future<U>(task);
+}
+
 #endif //THREADPOOL_THREADPOOL_H
@@ -0,0 +1,269 @@
+#include "timer.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "threadpool.h"
+
+/////////////  TimerService方法的实现
+TimerService::TimerService(uint64_t tickNs, Dispatch dispatch)
+    : tickNs_(std::max(tickNs, (uint64_t)1))
+    , baseNs_(steadyNowNs())
+    , dispatch_(std::move(dispatch))
+    , running_(true)
+    , current_(0)
+    , wakeTick_(0)
+    , size_(0)
+    , slots_{}
+{
+    thread_ = std::thread(&TimerService::run, this);
+}
+
+TimerService::~TimerService()
+{
+    stop();
+}
+
+std::shared_ptr<TimerNode> TimerService::schedule(uint64_t atNs, uint64_t periodNs, InlineFunction<void()> func)
+{
+    auto node = std::make_shared<TimerNode>();
+    node->func_ = std::move(func);
+    // 向上取整到tick，宁可晚一点也不提前
+    node->expire_ = atNs > baseNs_ ? (atNs - baseNs_ + tickNs_ - 1) / tickNs_ : 0;
+    node->period_ = periodNs == 0 ? 0 : std::max((periodNs + tickNs_ - 1) / tickNs_, (uint64_t)1);
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(!running_)
+        return node;
+    if(size_ == 0)// 空了一段时间，直接跳到现在，不用一个tick一个tick地走过去
+        current_ = std::max(current_, (steadyNowNs() - baseNs_) / tickNs_);
+    node->self_ = node;
+    link(node.get());
+    size_++;
+    if(node->expire_ < wakeTick_)// 比定时线程打算醒来的时间早
+        cond_.notify_one();
+    return node;
+}
+
+bool TimerService::cancel(const std::shared_ptr<TimerNode>& node, InlineFunction<void()>& func)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(node->cancelled_)
+        return false;
+    node->cancelled_ = true;
+    if(node->level_ < 0)// 已经到期了：只执行一次的来不及了，周期任务这次执行完不再挂回去
+        return node->period_ != 0;
+    unlink(node.get());
+    size_--;
+    if(node->period_ == 0)
+        func = std::move(node->func_);
+    node->self_.reset();
+    return true;
+}
+
+void TimerService::rearm(const std::shared_ptr<TimerNode>& node)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if(!running_ || node->cancelled_)
+        return;
+    uint64_t now = (steadyNowNs() - baseNs_) / tickNs_;
+    if(size_ == 0)
+        current_ = std::max(current_, now);
+    node->expire_ = std::max(node->expire_ + node->period_, now + 1);// 落后超过一个周期的话错过的几次不补
+    node->self_ = node;
+    link(node.get());
+    size_++;
+    if(node->expire_ < wakeTick_)
+        cond_.notify_one();
+}
+
+std::vector<std::shared_ptr<TimerNode>> TimerService::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if(!running_)
+            return {};
+        running_ = false;
+        cond_.notify_all();
+    }
+    thread_.join();
+
+    std::vector<std::shared_ptr<TimerNode>> pending;
+    std::lock_guard<std::mutex> lock(mtx_);
+    for(int level=0;level<LEVELS;level++)
+    {
+        for(int slot=0;slot<SLOTS;slot++)
+        {
+            while(slots_[level][slot] != nullptr)
+            {
+                TimerNode* node = slots_[level][slot];
+                unlink(node);
+                std::shared_ptr<TimerNode> self = std::move(node->self_);
+                if(self->period_ == 0)
+                    pending.push_back(std::move(self));
+            }
+        }
+    }
+    size_ = 0;
+    return pending;
+}
+
+size_t TimerService::size() const
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    return size_;
+}
+
+void TimerService::run()
+{
+    std::vector<std::shared_ptr<TimerNode>> due;
+    std::unique_lock<std::mutex> lock(mtx_);
+    while(running_)
+    {
+        advance((steadyNowNs() - baseNs_) / tickNs_, due);
+        if(!due.empty())
+        {
+            // 到期的一批在锁外交给线程池，放任务队列可能要等
+            lock.unlock();
+            dispatch_(*this, due);
+            due.clear();
+            lock.lock();
+            continue;
+        }
+
+        uint64_t next = nextTick();
+        wakeTick_ = next;
+        if(next == UINT64_MAX)
+        {
+            cond_.wait(lock);
+        }
+        else
+        {
+            auto wakeAt = std::chrono::steady_clock::time_point(
+                std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(baseNs_ + next * tickNs_)));
+            cond_.wait_until(lock, wakeAt);
+        }
+        wakeTick_ = 0;
+    }
+}
+
+void TimerService::link(TimerNode* node)
+{
+    uint64_t expire = std::max(node->expire_, current_ + 1);// 已经过了的放到下一个tick
+    uint64_t delta = expire - current_;
+    int level = 0;
+    while(level < LEVELS - 1 && delta >= ((uint64_t)1 << (SLOT_BITS * (level + 1))))
+    {
+        level++;
+    }
+    // 超出整个时间轮范围的先挂在最高层最远的槽上，转到时再按剩下的时间重新放
+    uint64_t range = (uint64_t)1 << (SLOT_BITS * LEVELS);
+    if(delta >= range)
+        expire = current_ + range - ((uint64_t)1 << (SLOT_BITS * (LEVELS - 1)));
+
+    int slot = (int)((expire >> (SLOT_BITS * level)) & (SLOTS - 1));
+    node->level_ = level;
+    node->slot_ = slot;
+    node->prev_ = nullptr;
+    node->next_ = slots_[level][slot];
+    if(node->next_ != nullptr)
+        node->next_->prev_ = node;
+    slots_[level][slot] = node;
+}
+
+void TimerService::unlink(TimerNode* node)
+{
+    if(node->prev_ != nullptr)
+        node->prev_->next_ = node->next_;
+    else
+        slots_[node->level_][node->slot_] = node->next_;
+    if(node->next_ != nullptr)
+        node->next_->prev_ = node->prev_;
+    node->prev_ = nullptr;
+    node->next_ = nullptr;
+    node->level_ = -1;
+    node->slot_ = -1;
+}
+
+void TimerService::advance(uint64_t now, std::vector<std::shared_ptr<TimerNode>>& due)
+{
+    if(size_ == 0)
+    {
+        current_ = std::max(current_, now);
+        return;
+    }
+    // 把一个槽里的定时器都摘下来：到期的放进due，没到期的按剩下的时间重新放到低层
+    auto takeSlot = [&](int level, int slot)
+    {
+        TimerNode* node = slots_[level][slot];
+        slots_[level][slot] = nullptr;
+        while(node != nullptr)
+        {
+            TimerNode* next = node->next_;
+            node->prev_ = nullptr;
+            node->next_ = nullptr;
+            node->level_ = -1;
+            node->slot_ = -1;
+            if(node->expire_ <= current_)
+            {
+                due.push_back(std::move(node->self_));
+                size_--;
+            }
+            else
+            {
+                link(node);
+            }
+            node = next;
+        }
+    };
+    while(current_ < now && size_ > 0)
+    {
+        current_++;
+        // 低层转完一圈，把上一层当前槽里的定时器挪下来
+        for(int level=1;level<LEVELS;level++)
+        {
+            if((current_ & (((uint64_t)1 << (SLOT_BITS * level)) - 1)) != 0)
+                break;
+            takeSlot(level, (int)((current_ >> (SLOT_BITS * level)) & (SLOTS - 1)));
+        }
+        takeSlot(0, (int)(current_ & (SLOTS - 1)));
+    }
+    current_ = std::max(current_, now);
+}
+
+uint64_t TimerService::nextTick() const
+{
+    if(size_ == 0)
+        return UINT64_MAX;
+    // 第0层里最近的非空槽；这一圈里没有的话，到下一圈开头要往下挪上层的定时器，那时醒来
+    for(uint64_t tick=current_+1;;tick++)
+    {
+        if(slots_[0][tick & (SLOTS - 1)] != nullptr || (tick & (SLOTS - 1)) == 0)
+            return tick;
+    }
+}
+
+/////////////  TimerHandle方法的实现
+TimerHandle::TimerHandle(std::weak_ptr<TimerService> service, std::shared_ptr<TimerNode> node)
+    : service_(std::move(service))
+    , node_(std::move(node))
+{
+}
+
+bool TimerHandle::cancel()
+{
+    std::shared_ptr<TimerService> service = service_.lock();
+    if(service == nullptr || node_ == nullptr)
+        return false;
+    InlineFunction<void()> func;
+    if(!service->cancel(node_, func))
+        return false;
+    if(func)
+        ThreadPool::discardTask(TaskItem(std::move(func)));// 等结果的一方拿到TaskCancelled
+    return true;
+}
+
+bool TimerHandle::valid() const
+{
+    return node_ != nullptr;
+}
@@ -0,0 +1,95 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "callable.h"
+
+// 时间轮上的一个定时器，字段都由TimerService的锁保护
+struct TimerNode
+{
+    InlineFunction<void()> func_; // 只执行一次的是包好的任务，周期任务是用户的可调用对象(每次到期调用一次)
+    uint64_t expire_ = 0; // 到期的tick
+    uint64_t period_ = 0; // 周期(tick数)，0表示只执行一次
+    bool cancelled_ = false;
+    int level_ = -1; // 挂在哪一层哪个槽上，-1表示不在时间轮上(已经到期、取消或者周期任务正在执行)
+    int slot_ = -1;
+    TimerNode* prev_ = nullptr; // 同一个槽里的双向链表，摘掉是O(1)
+    TimerNode* next_ = nullptr;
+    std::shared_ptr<TimerNode> self_; // 挂在时间轮上时由时间轮持有
+};
+
+// 分层时间轮 + 一个定时线程：每层64个槽，第0层一个槽一个tick，往上每层一个槽是下一层的一整圈，
+// 4层能表示64^4个tick(1ms一个tick时大约4.6小时)，更远的先挂在最高层，转到时再重新放
+// 插入和取消都是O(1)；线程只在最近的到期时间(或者下一次第0层转完一圈要往下挪定时器时)醒来，没有定时器就一直睡
+// 到期的定时器攒成一批交给dispatch，由线程池放进任务队列
+// 由shared_ptr持有，周期任务的包装里放weak_ptr，执行完通过它挂回时间轮
+class TimerService : public std::enable_shared_from_this<TimerService>
+{
+public:
+    using Dispatch = std::function<void(TimerService&, std::vector<std::shared_ptr<TimerNode>>&)>;
+
+    static const int LEVELS = 4;
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+
+    TimerService(uint64_t tickNs, Dispatch dispatch);
+    ~TimerService();
+    TimerService(const TimerService&)=delete;
+    TimerService& operator=(const TimerService&)=delete;
+
+    // 加一个定时器：atNs是steadyNowNs()的时间，不会提前执行；periodNs为0表示只执行一次
+    std::shared_ptr<TimerNode> schedule(uint64_t atNs, uint64_t periodNs, InlineFunction<void()> func);
+    // 从时间轮上摘掉，摘掉了返回true；只执行一次的定时器的func_交给调用方处理
+    bool cancel(const std::shared_ptr<TimerNode>& node, InlineFunction<void()>& func);
+    // 周期任务执行完一次后调用，按上次的到期时间加一个周期重新挂上(落后了就从现在算)，保证不重叠也不漂移
+    void rearm(const std::shared_ptr<TimerNode>& node);
+    // 停掉定时线程，返回还没到期的只执行一次的定时器；之后schedule的定时器不会再执行
+    std::vector<std::shared_ptr<TimerNode>> stop();
+    // 时间轮上的定时器个数
+    size_t size() const;
+private:
+    void run();
+    void link(TimerNode* node);
+    void unlink(TimerNode* node);
+    // 走到tick now，到期的放进due
+    void advance(uint64_t now, std::vector<std::shared_ptr<TimerNode>>& due);
+    // 下一次需要醒来的tick，没有定时器时返回UINT64_MAX
+    uint64_t nextTick() const;
+
+    uint64_t tickNs_;
+    uint64_t baseNs_; // tick 0对应的时间
+    Dispatch dispatch_;
+    mutable std::mutex mtx_;
+    std::condition_variable cond_;
+    std::thread thread_;
+    bool running_;
+    uint64_t current_; // 已经处理到的tick
+    uint64_t wakeTick_; // 定时线程睡到哪个tick，更早的定时器加进来要叫醒它；线程醒着时为0
+    size_t size_;
+    TimerNode* slots_[LEVELS][SLOTS];
+};
+
+// submitEvery/submitAfter返回的句柄，用来取消还没执行的定时任务
+class TimerHandle
+{
+public:
+    TimerHandle() = default;
+    TimerHandle(std::weak_ptr<TimerService> service, std::shared_ptr<TimerNode> node);
+
+    // 只执行一次的任务还没到期：从时间轮上摘掉，等待结果的一方拿到TaskCancelled，返回true
+    // 周期任务：以后不再执行(正在执行的这一次会执行完)，第一次取消返回true
+    bool cancel();
+    bool valid() const;
+private:
+    std::weak_ptr<TimerService> service_;
+    std::shared_ptr<TimerNode> node_;
+};
+
+#endif //TIMER_H
@@ -0,0 +1,119 @@
+#include "topology.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <dirent.h>
+#endif
+
+/////////////  Topology方法的实现
+Topology Topology::detect(const std::string& root)
+{
+    Topology topo;
+#ifdef __linux__
+    DIR* dir = opendir(root.c_str());
+    if(dir != nullptr)
+    {
+        std::vector<int> ids;
+        while(dirent* entry = readdir(dir))
+        {
+            // 只要node0、node1...这样的目录
+            std::string name = entry->d_name;
+            if(name.size() > 4 && name.compare(0, 4, "node") == 0
+               && std::all_of(name.begin() + 4, name.end(), [](char c){ return c >= '0' && c <= '9'; }))
+            {
+                ids.push_back(std::atoi(name.c_str() + 4));
+            }
+        }
+        closedir(dir);
+        std::sort(ids.begin(), ids.end());
+
+        for(int id : ids)
+        {
+            std::ifstream file(root + "/node" + std::to_string(id) + "/cpulist");
+            std::string text;
+            if(!std::getline(file, text))
+                continue;
+            NumaNode node;
+            node.id = id;
+            node.cpus = parseCpuList(text);
+            if(!node.cpus.empty())// 只有内存没有CPU的节点放不了线程，跳过
+                topo.addNode(std::move(node));
+        }
+    }
+#endif
+    if(topo.nodes_.empty())
+    {
+        return uniform(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    return topo;
+}
+
+Topology Topology::uniform(int cpus)
+{
+    Topology topo;
+    NumaNode node;
+    for(int i=0;i<cpus;i++)
+    {
+        node.cpus.push_back(i);
+    }
+    topo.addNode(std::move(node));
+    return topo;
+}
+
+std::vector<int> Topology::parseCpuList(const std::string& text)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(text);
+    std::string range;
+    while(std::getline(stream, range, ','))
+    {
+        if(range.empty() || range[0] < '0' || range[0] > '9')
+            continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for(int cpu=first;cpu<=last;cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+const std::vector<NumaNode>& Topology::nodes() const
+{
+    return nodes_;
+}
+
+int Topology::nodeOf(int cpu) const
+{
+    if(cpu < 0 || cpu >= (int)cpuNode_.size())
+        return -1;
+    return cpuNode_[cpu];
+}
+
+std::vector<int> Topology::cpus() const
+{
+    std::vector<int> cpus;
+    for(auto& node : nodes_)
+    {
+        cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+    }
+    return cpus;
+}
+
+void Topology::addNode(NumaNode node)
+{
+    int index = nodes_.size();
+    for(int cpu : node.cpus)
+    {
+        if(cpu >= (int)cpuNode_.size())
+            cpuNode_.resize(cpu + 1, -1);
+        cpuNode_[cpu] = index;
+    }
+    nodes_.push_back(std::move(node));
+}
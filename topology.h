@@ -0,0 +1,40 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <string>
+#include <vector>
+
+// 一个NUMA节点和它上面的CPU编号
+struct NumaNode
+{
+    int id = 0;
+    std::vector<int> cpus;
+};
+
+// 机器的NUMA拓扑：从/sys/devices/system/node读，不依赖libnuma
+// 读不到(非linux、容器里没挂sysfs)时当成一个节点，包含所有CPU
+class Topology
+{
+public:
+    Topology() = default;
+
+    // root可以指向别的目录，测试或者容器里用
+    static Topology detect(const std::string& root = "/sys/devices/system/node");
+    // 一个节点，CPU为0~cpus-1
+    static Topology uniform(int cpus);
+    // 解析cpulist格式："0-3,8,10-11"
+    static std::vector<int> parseCpuList(const std::string& text);
+
+    const std::vector<NumaNode>& nodes() const;
+    // cpu所在节点在nodes()里的下标，未知返回-1
+    int nodeOf(int cpu) const;
+    // 所有CPU，按节点依次排
+    std::vector<int> cpus() const;
+private:
+    void addNode(NumaNode node);
+
+    std::vector<NumaNode> nodes_;
+    std::vector<int> cpuNode_; // cpu编号 => 节点下标
+};
+
+#endif //TOPOLOGY_H
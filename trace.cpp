@@ -0,0 +1,253 @@
+#include "trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifndef THREADPOOL_TRACE_BUFFER_SIZE
+#define THREADPOOL_TRACE_BUFFER_SIZE 16384 // 每个线程缓冲区能存的事件数，必须是2的幂
+#endif
+#ifndef THREADPOOL_TRACE_RETAINED_SIZE
+#define THREADPOOL_TRACE_RETAINED_SIZE 65536 // 已经退出的线程一共最多留多少个事件，超出时丢掉最早退出的线程的
+#endif
+
+namespace trace
+{
+namespace
+{
+struct Event
+{
+    uint64_t time_; // 纳秒，steady_clock
+    uint64_t arg_;
+    EventType type_;
+};
+
+// 单个线程的环形缓冲区，只有所属线程写
+struct Buffer
+{
+    int tid_; // 导出时用的线程编号
+    std::atomic<uint64_t> head_; // 一共写过多少个事件
+    Event events_[THREADPOOL_TRACE_BUFFER_SIZE];
+};
+
+// 已经退出的线程留下的事件，按时间顺序，只有实际记录的那些
+struct Retained
+{
+    int tid_;
+    std::vector<Event> events_;
+};
+
+// 活着的线程的缓冲区，退出线程的事件，以及还回来等着复用的缓冲区
+struct Registry
+{
+    std::mutex mtx_;
+    int nextTid_ = 1;
+    std::vector<Buffer*> buffers_;
+    std::deque<Retained> retained_;
+    size_t retainedEvents_ = 0;
+    std::vector<std::unique_ptr<Buffer>> free_;
+};
+
+Registry& registry()
+{
+    // 故意不析构：进程退出时还没结束的线程退出时还要用它
+    static Registry* reg = new Registry;
+    return *reg;
+}
+
+// 线程退出时把缓冲区里的事件拷出来留在registry里等导出，缓冲区本身还给free_，之后的新线程直接拿去用
+// cached模式反复回收/创建线程时，缓冲区的个数不超过同时活着的线程数
+void releaseBuffer(std::unique_ptr<Buffer> buffer)
+{
+    Retained retained;
+    retained.tid_ = buffer->tid_;
+    uint64_t head = buffer->head_.load(std::memory_order_relaxed);
+    uint64_t begin = head > THREADPOOL_TRACE_BUFFER_SIZE ? head - THREADPOOL_TRACE_BUFFER_SIZE : 0;
+    retained.events_.reserve(head - begin);
+    for(uint64_t i=begin;i<head;i++)
+    {
+        retained.events_.push_back(buffer->events_[i & (THREADPOOL_TRACE_BUFFER_SIZE - 1)]);
+    }
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx_);
+    for(size_t i=0;i<reg.buffers_.size();i++)
+    {
+        if(reg.buffers_[i] == buffer.get())
+        {
+            reg.buffers_.erase(reg.buffers_.begin() + i);
+            break;
+        }
+    }
+    if(!retained.events_.empty())
+    {
+        reg.retainedEvents_ += retained.events_.size();
+        reg.retained_.push_back(std::move(retained));
+        while(reg.retainedEvents_ > THREADPOOL_TRACE_RETAINED_SIZE)
+        {
+            reg.retainedEvents_ -= reg.retained_.front().events_.size();
+            reg.retained_.pop_front();
+        }
+    }
+    reg.free_.push_back(std::move(buffer));
+}
+
+// 当前线程的缓冲区，线程退出时析构
+struct LocalBuffer
+{
+    ~LocalBuffer()
+    {
+        if(buffer_ != nullptr)
+            releaseBuffer(std::move(buffer_));
+    }
+    std::unique_ptr<Buffer> buffer_;
+};
+
+// 线程第一次记录事件时才拿缓冲区并登记，只有这时候加锁；有退出线程还回来的就复用，不用再分配
+Buffer& localBuffer()
+{
+    thread_local LocalBuffer local;
+    if(local.buffer_ == nullptr)
+    {
+        Registry& reg = registry();
+        std::unique_ptr<Buffer> buffer;
+        {
+            std::lock_guard<std::mutex> lock(reg.mtx_);
+            if(!reg.free_.empty())
+            {
+                buffer = std::move(reg.free_.back());
+                reg.free_.pop_back();
+            }
+        }
+        if(buffer == nullptr)
+            buffer = std::make_unique<Buffer>();// 几百KB，不在锁里分配
+        buffer->head_ = 0;
+        std::lock_guard<std::mutex> lock(reg.mtx_);
+        buffer->tid_ = reg.nextTid_++;
+        reg.buffers_.push_back(buffer.get());
+        local.buffer_ = std::move(buffer);
+    }
+    return *local.buffer_;
+}
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char* eventName(EventType type)
+{
+    switch(type)
+    {
+    case EventType::ENQUEUE: return "enqueue";
+    case EventType::DEQUEUE: return "dequeue";
+    case EventType::EXEC_BEGIN:
+    case EventType::EXEC_END: return "exec";
+    case EventType::PARK: return "park";
+    case EventType::UNPARK: return "unpark";
+    case EventType::SPAWN: return "spawn";
+    case EventType::RETIRE: return "retire";
+    }
+    return "unknown";
+}
+
+// 导出时arg的名字，PARK/UNPARK没有参数返回nullptr
+const char* argName(EventType type)
+{
+    switch(type)
+    {
+    case EventType::ENQUEUE:
+    case EventType::DEQUEUE:
+    case EventType::EXEC_BEGIN:
+    case EventType::EXEC_END: return "enqueue_ns";
+    case EventType::SPAWN:
+    case EventType::RETIRE: return "thread";
+    default: return nullptr;
+    }
+}
+
+void writeThreadName(FILE* file, int tid, bool first)
+{
+    std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+                 first ? "" : ",\n", tid, tid);
+}
+
+void writeEvent(FILE* file, int tid, const Event& event)
+{
+    // 执行任务用B/E画成一段，其他都是瞬时事件
+    const char* phase = event.type_ == EventType::EXEC_BEGIN ? "B"
+                      : event.type_ == EventType::EXEC_END ? "E" : "i";
+    std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f%s,\"args\":{",
+                 eventName(event.type_), phase, tid, event.time_ / 1000.0,
+                 phase[0] == 'i' ? ",\"s\":\"t\"" : "");
+    if(const char* name = argName(event.type_))
+        std::fprintf(file, "\"%s\":%llu", name, (unsigned long long)event.arg_);
+    std::fprintf(file, "}}");
+}
+} // namespace
+
+void record(EventType type, uint64_t arg)
+{
+    Buffer& buffer = localBuffer();
+    uint64_t head = buffer.head_.load(std::memory_order_relaxed);
+    Event& event = buffer.events_[head & (THREADPOOL_TRACE_BUFFER_SIZE - 1)];
+    event.time_ = nowNs();
+    event.arg_ = arg;
+    event.type_ = type;
+    buffer.head_.store(head + 1, std::memory_order_release);
+}
+
+bool dumpChromeJson(const std::string& path)
+{
+    FILE* file = std::fopen(path.c_str(), "w");
+    if(file == nullptr)
+        return false;
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx_);
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    // 先是已经退出的线程
+    for(const Retained& retained : reg.retained_)
+    {
+        writeThreadName(file, retained.tid_, first);
+        first = false;
+        for(const Event& event : retained.events_)
+        {
+            writeEvent(file, retained.tid_, event);
+        }
+    }
+    for(Buffer* buffer : reg.buffers_)
+    {
+        writeThreadName(file, buffer->tid_, first);
+        first = false;
+
+        // 只剩最近的THREADPOOL_TRACE_BUFFER_SIZE个事件，更早的已经被覆盖
+        uint64_t head = buffer->head_.load(std::memory_order_acquire);
+        uint64_t begin = head > THREADPOOL_TRACE_BUFFER_SIZE ? head - THREADPOOL_TRACE_BUFFER_SIZE : 0;
+        for(uint64_t i=begin;i<head;i++)
+        {
+            writeEvent(file, buffer->tid_, buffer->events_[i & (THREADPOOL_TRACE_BUFFER_SIZE - 1)]);
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+void clear()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mtx_);
+    for(Buffer* buffer : reg.buffers_)
+    {
+        buffer->head_.store(0, std::memory_order_relaxed);
+    }
+    reg.retained_.clear();
+    reg.retainedEvents_ = 0;
+}
+} // namespace trace
@@ -0,0 +1,49 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ 线程池调度事件追踪：每个线程一个定长环形缓冲区，只记录二进制事件(时间戳+类型+参数)，
+ 写的时候不加锁也不格式化，满了覆盖最早的事件；线程退出时事件拷出来留着等导出(所有退出的线程一共最多留
+ THREADPOOL_TRACE_RETAINED_SIZE个)，缓冲区给之后的线程复用；需要时用dumpChromeJson导出成Chrome trace-event格式，
+ 拖进 chrome://tracing 或 ui.perfetto.dev 看每个线程的调度情况
+
+ 编译时定义THREADPOOL_TRACE才会记录（cmake -DTHREADPOOL_TRACE=ON），否则TP_TRACE展开为空，没有任何开销
+ dumpChromeJson读缓冲区时不和记录线程同步，在线程池空闲或者析构以后调用
+*/
+
+namespace trace
+{
+enum class EventType : uint8_t
+{
+    // 任务按值放在队列里，没有固定的地址，任务相关的事件arg都是任务的入队时间(steadyNowNs，纳秒)，
+    // 同一个任务的这几个事件arg相同，靠它对上；同一批提交(submitBatch、一批到期的定时任务)的任务入队时间一样
+    ENQUEUE, // 任务放进队列
+    DEQUEUE, // 线程取到任务
+    EXEC_BEGIN, // 开始执行任务
+    EXEC_END, // 任务执行完
+    PARK, // 线程没任务可做，开始睡眠
+    UNPARK, // 线程被唤醒
+    SPAWN, // 创建线程，arg为线程id
+    RETIRE, // 线程退出，arg为线程id
+};
+
+// 记录一个事件到当前线程的缓冲区
+void record(EventType type, uint64_t arg = 0);
+
+// 把所有线程缓冲区里的事件按Chrome trace-event JSON格式写到文件，失败返回false
+bool dumpChromeJson(const std::string& path);
+
+// 清空所有缓冲区里的事件
+void clear();
+} // namespace trace
+
+#ifdef THREADPOOL_TRACE
+#define TP_TRACE(type, arg) trace::record(trace::EventType::type, (uint64_t)(arg))
+#else
+#define TP_TRACE(type, arg) ((void)0)
+#endif
+
+#endif //TRACE_H